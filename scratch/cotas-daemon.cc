@@ -0,0 +1,56 @@
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+
+#include <csignal>
+
+using namespace ns3;
+
+// ----------------- CoTaS fora da simulação, numa porta UDP real ------------------
+// Exemplo: ./ns3 run "cotas-daemon --port=5683 --workers=4 --ns3::CoTaS::StoreThreads=8"
+// Os workers só recebem; os handlers rodam na thread do simulador e o que corre em
+// paralelo são as consultas ao banco, tantas quantas StoreThreads
+NS_LOG_COMPONENT_DEFINE("cotasDaemon");
+
+static CotasUdpDaemon* daemonAtivo = nullptr;
+
+static void
+Encerra(int)
+{
+    if (daemonAtivo)
+    {
+        daemonAtivo->Stop();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t porta = 5683;
+    uint32_t workers = 0;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("port", "Porta UDP onde o CoTaS recebe as requisições", porta);
+    cmd.AddValue("workers", "Threads que recebem da porta, 0 para uma por núcleo", workers);
+    cmd.Parse(argc, argv);
+
+    LogComponentEnable("cotasDaemon", LOG_LEVEL_INFO);
+    LogComponentEnable("CoTaSApplication", LOG_LEVEL_INFO);
+    LogComponentEnable("CotasUdpDaemon", LOG_LEVEL_INFO);
+
+    // os eventos periódicos do CoTaS passam a seguir o relógio de parede
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::RealtimeSimulatorImpl"));
+    Config::SetDefault("ns3::RealtimeSimulatorImpl::SynchronizationMode",
+                       StringValue("BestEffort"));
+
+    Ptr<CoTaS> cotas = CreateObject<CoTaS>();
+    CotasUdpDaemon daemon(cotas, porta, workers);
+    daemonAtivo = &daemon;
+    std::signal(SIGINT, Encerra);
+    std::signal(SIGTERM, Encerra);
+
+    bool ok = daemon.Run();
+    daemonAtivo = nullptr;
+    Simulator::Destroy();
+
+    NS_LOG_INFO("CoTaS encerrado");
+    return ok ? 0 : 1;
+}
@@ -6,17 +6,20 @@
 #include "context-consumer.h"
 
 #include "ns3/address-utils.h"
+#include "ns3/boolean.h"
 #include "ns3/log.h"
 #include "ns3/nstime.h"
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
 #include "ns3/socket.h"
+#include "ns3/string.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
 #include "ns3/timestamp-tag.h"
 
 #include <random>
+#include <sstream>
 
 namespace ns3
 {
@@ -70,6 +73,36 @@ ContextConsumer::GetTypeId()
                           UintegerValue(1),
                           MakeUintegerAccessor(&ContextConsumer::m_applicationType),
                           MakeUintegerChecker<uint32_t>())
+            .AddAttribute("StructuredQuery",
+                          "Send the structured json search (requestQueries) "
+                          "instead of the raw SPARQL fragment (requestMessages)",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&ContextConsumer::m_structuredQuery),
+                          MakeBooleanChecker())
+            .AddAttribute("StandingQuery",
+                          "Register the search at subscription and poll it by queryId",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&ContextConsumer::m_standingQuery),
+                          MakeBooleanChecker())
+            .AddAttribute("Project",
+                          "Comma separated update keys to read from the search response "
+                          "(ex: turnedOn,temperature); needs StructuredQuery",
+                          StringValue(""),
+                          MakeStringAccessor(&ContextConsumer::m_project),
+                          MakeStringChecker())
+            .AddAttribute("Tenant",
+                          "Home sent in the Tenant CoAP option; empty lets CoTaS "
+                          "use the node subnet",
+                          StringValue(""),
+                          MakeStringAccessor(&ContextConsumer::m_tenant),
+                          MakeStringChecker())
+            .AddAttribute("Deadline",
+                          "How long the client waits for a response, sent in the "
+                          "Deadline CoAP option so CoTaS drops the request after it; "
+                          "zero sends no option",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&ContextConsumer::m_deadline),
+                          MakeTimeChecker())
             .AddTraceSource("Tx",
                             "A new packet is created and is sent",
                             MakeTraceSourceAccessor(&ContextConsumer::m_txTrace),
@@ -97,6 +130,7 @@ ContextConsumer::ContextConsumer()
       m_state{Searching},
       m_objectAdress{},
       m_objectId{0},
+      m_queryId{0},
       m_recived_messages{0},
       m_send_messages{0}
 {
@@ -296,10 +330,18 @@ ContextConsumer::Send()
     switch (m_objectId)
     {
     case 0: // inscrição
-        data = m_firstData.dump();
-        data.erase(0, 1);
-        data.erase(data.find_last_of("\""));
-        data.erase(std::remove(data.begin(), data.end(), '\\'), data.end());
+        if (m_standingQuery)
+        {
+            // a busca vai junto e só é enviada essa vez
+            data = nlohmann::json{{"profile", m_firstData}, {"query", m_reqData}}.dump();
+        }
+        else
+        {
+            data = m_firstData.dump();
+            data.erase(0, 1);
+            data.erase(data.find_last_of("\""));
+            data.erase(std::remove(data.begin(), data.end(), '\\'), data.end());
+        }
         uri_path = "/subscribe/application";
         request_code = COAP_REQUEST_CODE_POST;
 
@@ -307,17 +349,36 @@ ContextConsumer::Send()
         break;
     
     default:
-        data = m_reqData.dump();
-        data.erase(0, 1);
-        data.erase(data.find_last_of("\""));
-        data.erase(std::remove(data.begin(), data.end(), '\\'), data.end());
+        data = m_queryId ? nlohmann::json{{"queryId", m_queryId}}.dump() : m_reqData.dump();
+        if (!m_queryId && !m_structuredQuery)
+        {
+            data.erase(0, 1);
+            data.erase(data.find_last_of("\""));
+            data.erase(std::remove(data.begin(), data.end(), '\\'), data.end());
+        }
         uri_path = "/search";
         request_code = COAP_REQUEST_CODE_GET;
 
         // NS_LOG_INFO("[App.Cli] Selecionou dados de requisição consumidor");
     }
 
-    data_pdu = EncodePduRequest(uri_path, request_code, data);
+    std::vector<std::pair<uint16_t, std::string>> opcoes;
+    if (!m_tenant.empty())
+    {
+        opcoes.emplace_back(COAP_OPTION_TENANT, m_tenant);
+    }
+    if (!m_deadline.IsZero())
+    {
+        opcoes.emplace_back(COAP_OPTION_DEADLINE, EncodeUintOption(m_deadline.GetMilliSeconds()));
+    }
+    data_pdu = EncodePduRequest(uri_path, request_code, data, opcoes);
+    if (data_pdu.size == 0)
+    {
+        // não coube na pdu: fica para o próximo envio
+        NS_LOG_WARN("[App.Cli] Falha ao codificar a pdu");
+        ScheduleTransmit(m_interval);
+        return;
+    }
 
     p = Create<Packet>(data_pdu.buffer, data_pdu.size);
     
@@ -390,14 +451,23 @@ ContextConsumer::HandleRead(Ptr<Socket> socket)
 
         pdu_code = coap_pdu_get_code(pdu);
         
-        data_json = GetPduPayloadJson(pdu);
+        // resposta sem corpo json fica com data_json nulo
+        GetPduPayloadJson(pdu, data_json);
 
         // NS_LOG_INFO("[App.Cli] json que chegou no cliente aplicação " << data_json.dump());
 
         switch (pdu_code)
         {
         case COAP_RESPONSE_CODE_CONTENT:
-            HandleOK(data_json["response"]);
+            // busca com limit maior que 1 traz só a lista
+            if (data_json.contains("results") && !data_json["results"].empty())
+            {
+                HandleOK(data_json["results"][0]);
+            }
+            else
+            {
+                HandleOK(data_json["response"]);
+            }
             break;
         case COAP_RESPONSE_CODE_BAD_REQUEST:
             NS_LOG_INFO("[App.Cli] Bad request ");
@@ -410,7 +480,11 @@ ContextConsumer::HandleRead(Ptr<Socket> socket)
             NS_LOG_INFO("[App.Cli] Erro no servidor");
             break;
         case COAP_RESPONSE_CODE_CREATED:
-            m_objectId = data_json["id"];
+            if (data_json.contains("id") && data_json["id"].is_number_integer())
+            {
+                m_objectId = data_json["id"];
+            }
+            m_queryId = data_json.value("queryId", 0);
             break;
         case COAP_RESPONSE_CODE_NOT_FOUND:
             NS_LOG_INFO("[App.Cli]  não foi encontrado objeto pedido");
@@ -441,7 +515,25 @@ ContextConsumer::HandleRead(Ptr<Socket> socket)
 void
 ContextConsumer::SetDataMessage()
 {    
-    m_reqData = m_messages["requestMessages"][m_applicationType];
+    if (m_structuredQuery)
+    {
+        m_reqData = m_messages["requestQueries"][m_applicationType];
+
+        // valores pedidos vem junto na resposta da busca
+        std::istringstream chaves(m_project);
+        std::string chave;
+        while (std::getline(chaves, chave, ','))
+        {
+            if (!chave.empty())
+            {
+                m_reqData["project"].push_back(chave);
+            }
+        }
+    }
+    else
+    {
+        m_reqData = m_messages["requestMessages"][m_applicationType];
+    }
     m_firstData = m_messages["subscribeMessagesApplications"][m_applicationType];
 }
 
@@ -455,6 +547,11 @@ ContextConsumer::HandleOK(nlohmann::json response)
                 // NS_LOG_INFO("[App.Cli] Chegou resposta do cotas vazio,"
                 //             << "não há objetos que correspondem a pesquisa");
             }
+            else if (response.contains("context")){
+                // o cotas já mandou os valores, não precisa ir ao objeto
+                NS_LOG_INFO("[App.Cli] Contexto recebido na busca: "
+                            << response["context"].dump());
+            }
             else{ // não chegou vazio, existe objeto que corresponde a pesquisa
                 // se comunica com o objeto em si (abstraido pra pedir só para o
                 // primeiro objeto)
@@ -119,9 +119,15 @@ class ContextConsumer : public SourceApplication
     std::optional<uint16_t> m_peerPort; //!< Remote peer port (deprecated) // NS_DEPRECATED_3_44
     EventId m_sendEvent;                //!< Event to send the next packet
     uint32_t m_applicationType;
+    bool m_structuredQuery;            //!< Send requestQueries (json) instead of requestMessages
+    bool m_standingQuery;              //!< Register the search at subscription
+    std::string m_project;             //!< Update keys read from the search response
+    std::string m_tenant;              //!< Tenant CoAP option, empty for none
+    Time m_deadline;                   //!< Deadline CoAP option, zero for none
     State m_state;                     //!< State of application (sending messages for cotas|objects)
     Address m_objectAdress;                //!< Address of the object of interest
     uint32_t m_objectId;
+    uint32_t m_queryId;                //!< Registered search, 0 if none
     nlohmann::json m_reqData;
     nlohmann::json m_firstData;
     nlohmann::json m_messages;
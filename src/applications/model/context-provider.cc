@@ -6,12 +6,14 @@
 #include "context-provider.h"
 
 #include "ns3/address-utils.h"
+#include "ns3/boolean.h"
 #include "ns3/log.h"
 #include "ns3/nstime.h"
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
 #include "ns3/socket.h"
+#include "ns3/string.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
 #include "ns3/timestamp-tag.h"
@@ -69,6 +71,25 @@ ContextProvider::GetTypeId()
                           UintegerValue(1),
                           MakeUintegerAccessor(&ContextProvider::m_objectType),
                           MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ByReference",
+                          "Subscribe by device model plus overrides; the full "
+                          "profile goes only if CoTaS does not know the model",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&ContextProvider::m_byReference),
+                          MakeBooleanChecker())
+            .AddAttribute("Tenant",
+                          "Home sent in the Tenant CoAP option; empty lets CoTaS "
+                          "use the node subnet",
+                          StringValue(""),
+                          MakeStringAccessor(&ContextProvider::m_tenant),
+                          MakeStringChecker())
+            .AddAttribute("Deadline",
+                          "How long the client waits for a response, sent in the "
+                          "Deadline CoAP option so CoTaS drops the request after it; "
+                          "zero sends no option",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&ContextProvider::m_deadline),
+                          MakeTimeChecker())
             .AddTraceSource("Tx",
                             "A new packet is created and is sent",
                             MakeTraceSourceAccessor(&ContextProvider::m_txTrace),
@@ -293,6 +314,29 @@ ContextProvider::Send()
         data.erase(0, 1);
         data.erase(data.find_last_of("\""));
         data.erase(std::remove(data.begin(), data.end(), '\\'), data.end());
+        if (m_byReference)
+        {
+            // o primeiro termo do perfil é o modelo; toda chave que os
+            // updates escrevem vai como sobrescrito e fica na instância
+            nlohmann::json referencia;
+            referencia["model"] = data.substr(0, data.find(' '));
+            referencia["overrides"] = nlohmann::json::object();
+            for (const auto& update : m_updateData)
+            {
+                for (auto& [chave, valor] : update.items())
+                {
+                    if (chave != "objectId" && !referencia["overrides"].contains(chave))
+                    {
+                        referencia["overrides"][chave] = valor;
+                    }
+                }
+            }
+            if (m_sendProfile)
+            {
+                referencia["profile"] = data;
+            }
+            data = referencia.dump();
+        }
         uri_path = "/subscribe/object";
         request_code = COAP_REQUEST_CODE_POST;
 
@@ -308,7 +352,23 @@ ContextProvider::Send()
     }
 
     // configura mensagens a serem trafegadas
-    data_pdu = EncodePduRequest(uri_path, request_code, data);
+    std::vector<std::pair<uint16_t, std::string>> opcoes;
+    if (!m_tenant.empty())
+    {
+        opcoes.emplace_back(COAP_OPTION_TENANT, m_tenant);
+    }
+    if (!m_deadline.IsZero())
+    {
+        opcoes.emplace_back(COAP_OPTION_DEADLINE, EncodeUintOption(m_deadline.GetMilliSeconds()));
+    }
+    data_pdu = EncodePduRequest(uri_path, request_code, data, opcoes);
+    if (data_pdu.size == 0)
+    {
+        // não coube na pdu: fica para o próximo envio
+        NS_LOG_WARN("[S.O.Cli] Falha ao codificar a pdu");
+        ScheduleTransmit(m_interval);
+        return;
+    }
     
     // cria o pacote
     p = Create<Packet>(data_pdu.buffer, data_pdu.size);
@@ -362,12 +422,16 @@ ContextProvider::HandleRead(Ptr<Socket> socket)
 
         pdu_code = coap_pdu_get_code(pdu);
         
-        data_json = GetPduPayloadJson(pdu);
+        // resposta sem corpo json fica com data_json nulo
+        GetPduPayloadJson(pdu, data_json);
 
         switch (pdu_code)
         {
         case COAP_RESPONSE_CODE_CREATED:
-            m_objectId = data_json["id"];
+            if (data_json.contains("id") && data_json["id"].is_number_integer())
+            {
+                m_objectId = data_json["id"];
+            }
             break;
         case COAP_RESPONSE_CODE_CHANGED:
             // resposta do update, não faz nada
@@ -379,6 +443,11 @@ ContextProvider::HandleRead(Ptr<Socket> socket)
         case COAP_RESPONSE_CODE_INTERNAL_ERROR:
             NS_LOG_INFO("[S.O.Cli] Erro no servidor");
             break;
+        case COAP_RESPONSE_CODE_NOT_FOUND:
+            // modelo desconhecido, a próxima inscrição leva o perfil
+            NS_LOG_INFO("[S.O.Cli] Modelo desconhecido, reenvia com perfil");
+            m_sendProfile = m_byReference && m_objectId == 0;
+            break;
         case COAP_RESPONSE_CODE_CONTENT:
             break;
         default:
@@ -122,6 +122,10 @@ class ContextProvider : public SourceApplication
     std::optional<uint16_t> m_peerPort; //!< Remote peer port (deprecated) // NS_DEPRECATED_3_44
     EventId m_sendEvent;                //!< Event to send the next packet
     uint32_t m_objectType;
+    std::string m_tenant;              //!< Tenant CoAP option, empty for none
+    Time m_deadline;                   //!< Deadline CoAP option, zero for none
+    bool m_byReference;                //!< subscribe by model reference
+    bool m_sendProfile{false};         //!< CoTaS asked for the model profile
     uint32_t m_objectId;
     nlohmann::json m_firstData;
     nlohmann::json m_updateData;
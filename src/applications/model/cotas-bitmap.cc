@@ -0,0 +1,416 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-bitmap.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+namespace ns3
+{
+
+void
+CotasBitmap::Add(uint32_t value)
+{
+    uint16_t key = value >> 16;
+    uint16_t baixo = value & 0xffff;
+
+    auto it = std::lower_bound(m_containers.begin(),
+                               m_containers.end(),
+                               key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == m_containers.end() || it->key != key)
+    {
+        it = m_containers.insert(it, Container{key, 0, {}, {}});
+    }
+
+    Container& c = *it;
+    if (c.IsBitset())
+    {
+        uint64_t bit = uint64_t{1} << (baixo & 63);
+        if (!(c.bits[baixo >> 6] & bit))
+        {
+            c.bits[baixo >> 6] |= bit;
+            c.cardinality++;
+        }
+        return;
+    }
+
+    auto pos = std::lower_bound(c.array.begin(), c.array.end(), baixo);
+    if (pos != c.array.end() && *pos == baixo)
+    {
+        return;
+    }
+    c.array.insert(pos, baixo);
+    c.cardinality++;
+    Normalize(c);
+}
+
+void
+CotasBitmap::Remove(uint32_t value)
+{
+    Container* c = Find(value >> 16);
+    if (!c)
+    {
+        return;
+    }
+    uint16_t baixo = value & 0xffff;
+
+    if (c->IsBitset())
+    {
+        uint64_t bit = uint64_t{1} << (baixo & 63);
+        if (c->bits[baixo >> 6] & bit)
+        {
+            c->bits[baixo >> 6] &= ~bit;
+            c->cardinality--;
+        }
+    }
+    else
+    {
+        auto pos = std::lower_bound(c->array.begin(), c->array.end(), baixo);
+        if (pos != c->array.end() && *pos == baixo)
+        {
+            c->array.erase(pos);
+            c->cardinality--;
+        }
+    }
+
+    if (c->cardinality == 0)
+    {
+        m_containers.erase(m_containers.begin() + (c - m_containers.data()));
+        return;
+    }
+    Normalize(*c);
+}
+
+bool
+CotasBitmap::Contains(uint32_t value) const
+{
+    const Container* c = Find(value >> 16);
+    if (!c)
+    {
+        return false;
+    }
+    uint16_t baixo = value & 0xffff;
+    if (c->IsBitset())
+    {
+        return (c->bits[baixo >> 6] >> (baixo & 63)) & 1;
+    }
+    return std::binary_search(c->array.begin(), c->array.end(), baixo);
+}
+
+uint64_t
+CotasBitmap::Cardinality() const
+{
+    uint64_t total = 0;
+    for (auto& c : m_containers)
+    {
+        total += c.cardinality;
+    }
+    return total;
+}
+
+bool
+CotasBitmap::Empty() const
+{
+    return m_containers.empty();
+}
+
+std::vector<uint32_t>
+CotasBitmap::ToVector() const
+{
+    std::vector<uint32_t> valores;
+    valores.reserve(Cardinality());
+    for (auto& c : m_containers)
+    {
+        uint32_t alto = static_cast<uint32_t>(c.key) << 16;
+        if (c.IsBitset())
+        {
+            for (size_t w = 0; w < WORDS; w++)
+            {
+                // tira o bit menos significativo a cada passo
+                for (uint64_t palavra = c.bits[w]; palavra; palavra &= palavra - 1)
+                {
+                    valores.push_back(alto | (w << 6) | std::countr_zero(palavra));
+                }
+            }
+        }
+        else
+        {
+            for (uint16_t baixo : c.array)
+            {
+                valores.push_back(alto | baixo);
+            }
+        }
+    }
+    return valores;
+}
+
+CotasBitmap&
+CotasBitmap::operator&=(const CotasBitmap& other)
+{
+    std::vector<Container> resultado;
+    auto a = m_containers.begin();
+    auto b = other.m_containers.begin();
+    while (a != m_containers.end() && b != other.m_containers.end())
+    {
+        if (a->key < b->key)
+        {
+            a++;
+        }
+        else if (b->key < a->key)
+        {
+            b++;
+        }
+        else
+        {
+            Container c = Combine(*a, *b, AND);
+            if (c.cardinality)
+            {
+                resultado.push_back(std::move(c));
+            }
+            a++;
+            b++;
+        }
+    }
+    m_containers.swap(resultado);
+    return *this;
+}
+
+CotasBitmap&
+CotasBitmap::operator|=(const CotasBitmap& other)
+{
+    std::vector<Container> resultado;
+    auto a = m_containers.begin();
+    auto b = other.m_containers.begin();
+    while (a != m_containers.end() || b != other.m_containers.end())
+    {
+        if (b == other.m_containers.end() || (a != m_containers.end() && a->key < b->key))
+        {
+            resultado.push_back(std::move(*a++));
+        }
+        else if (a == m_containers.end() || b->key < a->key)
+        {
+            resultado.push_back(*b++);
+        }
+        else
+        {
+            resultado.push_back(Combine(*a++, *b++, OR));
+        }
+    }
+    m_containers.swap(resultado);
+    return *this;
+}
+
+CotasBitmap&
+CotasBitmap::operator-=(const CotasBitmap& other)
+{
+    std::vector<Container> resultado;
+    auto b = other.m_containers.begin();
+    for (auto& a : m_containers)
+    {
+        while (b != other.m_containers.end() && b->key < a.key)
+        {
+            b++;
+        }
+        if (b == other.m_containers.end() || b->key != a.key)
+        {
+            resultado.push_back(std::move(a));
+            continue;
+        }
+        Container c = Combine(a, *b, ANDNOT);
+        if (c.cardinality)
+        {
+            resultado.push_back(std::move(c));
+        }
+    }
+    m_containers.swap(resultado);
+    return *this;
+}
+
+CotasBitmap::Container*
+CotasBitmap::Find(uint16_t key)
+{
+    auto it = std::lower_bound(m_containers.begin(),
+                               m_containers.end(),
+                               key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    return (it == m_containers.end() || it->key != key) ? nullptr : &*it;
+}
+
+const CotasBitmap::Container*
+CotasBitmap::Find(uint16_t key) const
+{
+    return const_cast<CotasBitmap*>(this)->Find(key);
+}
+
+CotasBitmap::Container
+CotasBitmap::Combine(const Container& a, const Container& b, Operation op)
+{
+    Container c{a.key, 0, {}, {}};
+
+    if (a.IsBitset() && b.IsBitset())
+    {
+        // laços simples sobre palavras, o compilador vetoriza
+        c.bits.resize(WORDS);
+        const uint64_t* x = a.bits.data();
+        const uint64_t* y = b.bits.data();
+        uint64_t* z = c.bits.data();
+        switch (op)
+        {
+        case AND:
+            for (size_t w = 0; w < WORDS; w++)
+            {
+                z[w] = x[w] & y[w];
+            }
+            break;
+        case OR:
+            for (size_t w = 0; w < WORDS; w++)
+            {
+                z[w] = x[w] | y[w];
+            }
+            break;
+        case ANDNOT:
+            for (size_t w = 0; w < WORDS; w++)
+            {
+                z[w] = x[w] & ~y[w];
+            }
+            break;
+        }
+        uint32_t total = 0;
+        for (size_t w = 0; w < WORDS; w++)
+        {
+            total += std::popcount(z[w]);
+        }
+        c.cardinality = total;
+        Normalize(c);
+        return c;
+    }
+
+    if (!a.IsBitset() && !b.IsBitset())
+    {
+        switch (op)
+        {
+        case AND:
+            std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                  std::back_inserter(c.array));
+            break;
+        case OR:
+            std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                           std::back_inserter(c.array));
+            break;
+        case ANDNOT:
+            std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                std::back_inserter(c.array));
+            break;
+        }
+        c.cardinality = c.array.size();
+        Normalize(c);
+        return c;
+    }
+
+    // um array e um bitset
+    const Container& arr = a.IsBitset() ? b : a;
+    const Container& bitset = a.IsBitset() ? a : b;
+    auto marcado = [&bitset](uint16_t v) { return (bitset.bits[v >> 6] >> (v & 63)) & 1; };
+
+    if (op == AND)
+    {
+        for (uint16_t v : arr.array)
+        {
+            if (marcado(v))
+            {
+                c.array.push_back(v);
+            }
+        }
+        c.cardinality = c.array.size();
+    }
+    else if (op == OR)
+    {
+        c.bits = bitset.bits;
+        c.cardinality = bitset.cardinality;
+        for (uint16_t v : arr.array)
+        {
+            if (!marcado(v))
+            {
+                c.bits[v >> 6] |= uint64_t{1} << (v & 63);
+                c.cardinality++;
+            }
+        }
+    }
+    else if (a.IsBitset())
+    {
+        // bitset - array
+        c.bits = a.bits;
+        c.cardinality = a.cardinality;
+        for (uint16_t v : b.array)
+        {
+            if (marcado(v))
+            {
+                c.bits[v >> 6] &= ~(uint64_t{1} << (v & 63));
+                c.cardinality--;
+            }
+        }
+    }
+    else
+    {
+        // array - bitset
+        for (uint16_t v : a.array)
+        {
+            if (!marcado(v))
+            {
+                c.array.push_back(v);
+            }
+        }
+        c.cardinality = c.array.size();
+    }
+    Normalize(c);
+    return c;
+}
+
+void
+CotasBitmap::ToBitset(Container& c)
+{
+    c.bits.assign(WORDS, 0);
+    for (uint16_t v : c.array)
+    {
+        c.bits[v >> 6] |= uint64_t{1} << (v & 63);
+    }
+    c.array.clear();
+    c.array.shrink_to_fit();
+}
+
+void
+CotasBitmap::ToArray(Container& c)
+{
+    c.array.clear();
+    c.array.reserve(c.cardinality);
+    for (size_t w = 0; w < WORDS; w++)
+    {
+        for (uint64_t palavra = c.bits[w]; palavra; palavra &= palavra - 1)
+        {
+            c.array.push_back((w << 6) | std::countr_zero(palavra));
+        }
+    }
+    c.bits.clear();
+    c.bits.shrink_to_fit();
+}
+
+void
+CotasBitmap::Normalize(Container& c)
+{
+    if (c.IsBitset() && c.cardinality <= ARRAY_MAX)
+    {
+        ToArray(c);
+    }
+    else if (!c.IsBitset() && c.cardinality > ARRAY_MAX)
+    {
+        ToBitset(c);
+    }
+}
+
+} // namespace ns3
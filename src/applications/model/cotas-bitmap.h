@@ -0,0 +1,107 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_BITMAP_H
+#define COTAS_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Compressed bitmap of device ordinals, in the Roaring layout.
+ *
+ * The 32-bit ordinal is split in a 16-bit key, which selects a container,
+ * and a 16-bit low part. A container with up to 4096 values is a sorted
+ * array; above that it is a 65536-bit bitset. Bitset operations are plain
+ * loops over 64-bit words, written so the compiler can vectorize them.
+ */
+class CotasBitmap
+{
+  public:
+    static constexpr size_t ARRAY_MAX{4096}; //!< largest array container
+    static constexpr size_t WORDS{1024};     //!< 64-bit words of a bitset container
+
+    /**
+     * @brief Adds a value.
+     */
+    void Add(uint32_t value);
+
+    /**
+     * @brief Removes a value.
+     */
+    void Remove(uint32_t value);
+
+    /**
+     * @brief Checks if the value is in the bitmap.
+     */
+    bool Contains(uint32_t value) const;
+
+    /**
+     * @brief Number of values.
+     */
+    uint64_t Cardinality() const;
+
+    /**
+     * @brief Checks if there is no value.
+     */
+    bool Empty() const;
+
+    /**
+     * @brief Values in increasing order.
+     */
+    std::vector<uint32_t> ToVector() const;
+
+    /// Intersection
+    CotasBitmap& operator&=(const CotasBitmap& other);
+
+    /// Union
+    CotasBitmap& operator|=(const CotasBitmap& other);
+
+    /// Difference
+    CotasBitmap& operator-=(const CotasBitmap& other);
+
+  private:
+    struct Container
+    {
+        uint16_t key;                 //!< high 16 bits
+        uint32_t cardinality{0};      //!< number of values
+        std::vector<uint16_t> array;  //!< sorted values, if not a bitset
+        std::vector<uint64_t> bits;   //!< WORDS words, if a bitset
+
+        bool IsBitset() const
+        {
+            return !bits.empty();
+        }
+    };
+
+    enum Operation
+    {
+        AND,
+        OR,
+        ANDNOT
+    };
+
+    /// container of key, nullptr if absent
+    Container* Find(uint16_t key);
+    const Container* Find(uint16_t key) const;
+
+    static Container Combine(const Container& a, const Container& b, Operation op);
+    static void ToBitset(Container& c);
+    static void ToArray(Container& c);
+    /// chooses the representation by the cardinality
+    static void Normalize(Container& c);
+
+    std::vector<Container> m_containers; //!< sorted by key
+};
+
+} // namespace ns3
+
+#endif /* COTAS_BITMAP_H */
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-block-assembler.h"
+
+namespace ns3
+{
+
+CotasBlockAssembler::CotasBlockAssembler(size_t maxBody, size_t maxTransfers, size_t maxBytes)
+    : m_maxBody(maxBody),
+      m_maxTransfers(maxTransfers),
+      m_maxBytes(maxBytes)
+{
+}
+
+CotasBlockAssembler::Result
+CotasBlockAssembler::Add(const std::string& key,
+                         uint32_t num,
+                         bool more,
+                         size_t size,
+                         const std::string& chunk,
+                         int64_t now,
+                         std::string& body)
+{
+    auto it = m_transfers.find(key);
+    if (num == 0 && it != m_transfers.end())
+    {
+        // o cliente recomeçou a transferência
+        Drop(it);
+        it = m_transfers.end();
+    }
+
+    size_t recebido = it == m_transfers.end() ? 0 : it->second.body.size();
+    if (static_cast<uint64_t>(num) * size != recebido)
+    {
+        // bloco perdido ou fora de ordem: o cliente recomeça do zero
+        if (it != m_transfers.end())
+        {
+            Drop(it);
+        }
+        return OUT_OF_ORDER;
+    }
+    if (recebido + chunk.size() > m_maxBody)
+    {
+        if (it != m_transfers.end())
+        {
+            Drop(it);
+        }
+        return TOO_LARGE;
+    }
+
+    if (!more)
+    {
+        body.clear();
+        if (it != m_transfers.end())
+        {
+            m_bytes -= it->second.body.size();
+            body = std::move(it->second.body);
+            m_transfers.erase(it);
+        }
+        body += chunk;
+        return DONE;
+    }
+
+    // só transferência nova conta no limite de abertas
+    if (it == m_transfers.end())
+    {
+        if (m_transfers.size() >= m_maxTransfers)
+        {
+            return BUSY;
+        }
+        it = m_transfers.emplace(key, Transfer{"", now}).first;
+    }
+    if (m_bytes + chunk.size() > m_maxBytes)
+    {
+        Drop(it);
+        return BUSY;
+    }
+    it->second.body += chunk;
+    it->second.last = now;
+    m_bytes += chunk.size();
+    return MORE;
+}
+
+void
+CotasBlockAssembler::Expire(int64_t time)
+{
+    for (auto it = m_transfers.begin(); it != m_transfers.end();)
+    {
+        auto atual = it++;
+        if (atual->second.last < time)
+        {
+            Drop(atual);
+        }
+    }
+}
+
+size_t
+CotasBlockAssembler::Transfers() const
+{
+    return m_transfers.size();
+}
+
+size_t
+CotasBlockAssembler::Bytes() const
+{
+    return m_bytes;
+}
+
+void
+CotasBlockAssembler::Drop(std::unordered_map<std::string, Transfer>::iterator it)
+{
+    m_bytes -= it->second.body.size();
+    m_transfers.erase(it);
+}
+
+} // namespace ns3
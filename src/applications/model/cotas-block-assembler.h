@@ -0,0 +1,100 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_BLOCK_ASSEMBLER_H
+#define COTAS_BLOCK_ASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Reassembles the bodies of Block1 requests (RFC 7959).
+ *
+ * Each transfer is kept under a key chosen by the caller, usually the
+ * client address and the path. Memory is bounded three ways: a body
+ * larger than maxBody is refused, no more than maxTransfers transfers
+ * are open at once, and their bodies together never pass maxBytes.
+ * Transfers whose client went quiet are dropped by Expire.
+ */
+class CotasBlockAssembler
+{
+  public:
+    /// Outcome of a block
+    enum Result
+    {
+        MORE,         //!< block kept, the client sends the next one
+        DONE,         //!< last block, the body is complete
+        OUT_OF_ORDER, //!< block lost or out of order, the transfer was dropped
+        TOO_LARGE,    //!< body over maxBody, the transfer was dropped
+        BUSY          //!< over maxTransfers or maxBytes, the transfer was dropped
+    };
+
+    /**
+     * @param maxBody bytes of one body
+     * @param maxTransfers transfers open at once
+     * @param maxBytes bytes of all open transfers together
+     */
+    CotasBlockAssembler(size_t maxBody, size_t maxTransfers, size_t maxBytes);
+
+    /**
+     * @brief Adds a block to the transfer of key.
+     * @param num block number, zero starts the transfer again
+     * @param more whether blocks follow this one
+     * @param size block size negotiated by the client
+     * @param chunk payload of the block
+     * @param now time of arrival in milliseconds
+     * @param body receives the whole body when the result is DONE
+     */
+    Result Add(const std::string& key,
+               uint32_t num,
+               bool more,
+               size_t size,
+               const std::string& chunk,
+               int64_t now,
+               std::string& body);
+
+    /**
+     * @brief Drops the transfers whose last block arrived before time.
+     */
+    void Expire(int64_t time);
+
+    /**
+     * @brief Number of open transfers.
+     */
+    size_t Transfers() const;
+
+    /**
+     * @brief Bytes held by the open transfers.
+     */
+    size_t Bytes() const;
+
+  private:
+    /// Blocks of one body received so far
+    struct Transfer
+    {
+        std::string body; //!< concatenated payloads
+        int64_t last;     //!< arrival of the latest block, in milliseconds
+    };
+
+    /// forgets a transfer and its bytes
+    void Drop(std::unordered_map<std::string, Transfer>::iterator it);
+
+    size_t m_maxBody;                                     //!< bytes of one body
+    size_t m_maxTransfers;                                //!< open transfers
+    size_t m_maxBytes;                                    //!< bytes of all transfers
+    std::unordered_map<std::string, Transfer> m_transfers; //!< key -> transfer
+    size_t m_bytes{0};                                    //!< bytes held now
+};
+
+} // namespace ns3
+
+#endif /* COTAS_BLOCK_ASSEMBLER_H */
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-bloom-filter.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+namespace
+{
+
+uint64_t
+Fnv1a(const std::string& text, uint64_t seed)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+} // namespace
+
+CotasBloomFilter::CotasBloomFilter(uint32_t bits, uint8_t hashes)
+    : m_words(std::max<uint32_t>((bits + 63) / 64, 1), 0),
+      m_hashes(std::max<uint8_t>(hashes, 1))
+{
+}
+
+void
+CotasBloomFilter::Add(const std::string& name)
+{
+    for (uint32_t bit : Positions(name))
+    {
+        m_words[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+}
+
+bool
+CotasBloomFilter::MayContain(const std::string& name) const
+{
+    for (uint32_t bit : Positions(name))
+    {
+        if (!(m_words[bit / 64] & (uint64_t{1} << (bit % 64))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t
+CotasBloomFilter::Hashes() const
+{
+    return m_hashes;
+}
+
+std::string
+CotasBloomFilter::ToHex() const
+{
+    static const char* digitos = "0123456789abcdef";
+    std::string texto;
+    texto.reserve(m_words.size() * 16);
+    for (uint64_t palavra : m_words)
+    {
+        for (int deslocamento = 60; deslocamento >= 0; deslocamento -= 4)
+        {
+            texto += digitos[(palavra >> deslocamento) & 0xf];
+        }
+    }
+    return texto;
+}
+
+bool
+CotasBloomFilter::FromHex(const std::string& hex, uint8_t hashes, CotasBloomFilter& filter)
+{
+    if (hex.empty() || hex.size() % 16 != 0 || hashes == 0)
+    {
+        return false;
+    }
+    filter = CotasBloomFilter(hex.size() * 4, hashes);
+    for (size_t i = 0; i < hex.size(); i++)
+    {
+        char c = hex[i];
+        uint64_t digito;
+        if (c >= '0' && c <= '9')
+        {
+            digito = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            digito = c - 'a' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        filter.m_words[i / 16] |= digito << (60 - 4 * (i % 16));
+    }
+    return true;
+}
+
+std::vector<uint32_t>
+CotasBloomFilter::Positions(const std::string& name) const
+{
+    // hash duplo: a posição i é h1 + i * h2
+    uint64_t primeiro = Fnv1a(name, 0);
+    uint64_t segundo = Fnv1a(name, 0x9e3779b97f4a7c15ULL) | 1;
+    uint64_t bits = m_words.size() * 64;
+    std::vector<uint32_t> posicoes(m_hashes);
+    for (uint8_t i = 0; i < m_hashes; i++)
+    {
+        posicoes[i] = static_cast<uint32_t>((primeiro + i * segundo) % bits);
+    }
+    return posicoes;
+}
+
+} // namespace ns3
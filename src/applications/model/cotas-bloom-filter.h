@@ -0,0 +1,72 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_BLOOM_FILTER_H
+#define COTAS_BLOOM_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Set of names that answers "maybe" or "no", used as the digest a
+ *        home CoTaS sends upstream.
+ *
+ * The hashes are FNV-1a, so every node computes the same bits for a name
+ * and the filter can travel as hex text.
+ */
+class CotasBloomFilter
+{
+  public:
+    /**
+     * @param bits size of the filter, rounded up to a multiple of 64
+     * @param hashes bits set per name
+     */
+    CotasBloomFilter(uint32_t bits = 512, uint8_t hashes = 4);
+
+    /**
+     * @brief Adds a name.
+     */
+    void Add(const std::string& name);
+
+    /**
+     * @brief Checks a name; false means it was never added.
+     */
+    bool MayContain(const std::string& name) const;
+
+    /**
+     * @brief Bits set per name.
+     */
+    uint8_t Hashes() const;
+
+    /**
+     * @brief The bits as hex text.
+     */
+    std::string ToHex() const;
+
+    /**
+     * @brief Reads a filter written by ToHex.
+     * @return false if the text is not a filter
+     */
+    static bool FromHex(const std::string& hex, uint8_t hashes, CotasBloomFilter& filter);
+
+    bool operator==(const CotasBloomFilter& other) const = default;
+
+  private:
+    /// bit positions of a name
+    std::vector<uint32_t> Positions(const std::string& name) const;
+
+    std::vector<uint64_t> m_words; //!< the bits
+    uint8_t m_hashes;              //!< bits set per name
+};
+
+} // namespace ns3
+
+#endif /* COTAS_BLOOM_FILTER_H */
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-category-index.h"
+
+namespace ns3
+{
+
+uint32_t
+CotasCategoryIndex::Add(int32_t id, uint32_t ip, uint32_t port)
+{
+    auto [it, novo] = m_ordinals.try_emplace(id, m_devices.size());
+    if (novo)
+    {
+        m_devices.push_back({id, ip, port});
+        m_all.Add(it->second);
+    }
+    return it->second;
+}
+
+bool
+CotasCategoryIndex::Contains(int32_t id) const
+{
+    return m_ordinals.count(id) > 0;
+}
+
+bool
+CotasCategoryIndex::Ordinal(int32_t id, uint32_t& ordinal) const
+{
+    auto it = m_ordinals.find(id);
+    if (it == m_ordinals.end())
+    {
+        return false;
+    }
+    ordinal = it->second;
+    return true;
+}
+
+void
+CotasCategoryIndex::AddClass(int32_t id, const std::string& name)
+{
+    auto it = m_ordinals.find(id);
+    if (it != m_ordinals.end())
+    {
+        m_classes[name].Add(it->second);
+    }
+}
+
+void
+CotasCategoryIndex::AddUsedFor(int32_t id, const std::string& name)
+{
+    auto it = m_ordinals.find(id);
+    if (it != m_ordinals.end())
+    {
+        m_usedFor[name].Add(it->second);
+    }
+}
+
+void
+CotasCategoryIndex::SetState(int32_t id, const std::string& key, bool value)
+{
+    auto it = m_ordinals.find(id);
+    if (it == m_ordinals.end())
+    {
+        return;
+    }
+    m_known[key].Add(it->second);
+    if (value)
+    {
+        m_true[key].Add(it->second);
+    }
+    else
+    {
+        m_true[key].Remove(it->second);
+    }
+}
+
+const CotasBitmap&
+CotasCategoryIndex::All() const
+{
+    return m_all;
+}
+
+CotasBitmap
+CotasCategoryIndex::Classes(const std::vector<std::string>& names) const
+{
+    return Union(m_classes, names);
+}
+
+CotasBitmap
+CotasCategoryIndex::UsedFor(const std::vector<std::string>& names) const
+{
+    return Union(m_usedFor, names);
+}
+
+std::vector<std::string>
+CotasCategoryIndex::ClassNames() const
+{
+    return Names(m_classes);
+}
+
+std::vector<std::string>
+CotasCategoryIndex::UsedForNames() const
+{
+    return Names(m_usedFor);
+}
+
+CotasBitmap
+CotasCategoryIndex::State(const std::string& key, bool value) const
+{
+    auto verdade = m_true.find(key);
+    if (value)
+    {
+        return verdade == m_true.end() ? CotasBitmap() : verdade->second;
+    }
+
+    // falso é "tem valor" menos "é 1"
+    auto conhecido = m_known.find(key);
+    if (conhecido == m_known.end())
+    {
+        return CotasBitmap();
+    }
+    CotasBitmap resultado = conhecido->second;
+    if (verdade != m_true.end())
+    {
+        resultado -= verdade->second;
+    }
+    return resultado;
+}
+
+const CotasCategoryIndex::Device&
+CotasCategoryIndex::Get(uint32_t ordinal) const
+{
+    return m_devices[ordinal];
+}
+
+CotasBitmap
+CotasCategoryIndex::Union(const std::unordered_map<std::string, CotasBitmap>& bitmaps,
+                          const std::vector<std::string>& names)
+{
+    CotasBitmap resultado;
+    for (auto& nome : names)
+    {
+        auto it = bitmaps.find(nome);
+        if (it != bitmaps.end())
+        {
+            resultado |= it->second;
+        }
+    }
+    return resultado;
+}
+
+std::vector<std::string>
+CotasCategoryIndex::Names(const std::unordered_map<std::string, CotasBitmap>& bitmaps)
+{
+    std::vector<std::string> nomes;
+    for (auto& [nome, bitmap] : bitmaps)
+    {
+        if (!bitmap.Empty())
+        {
+            nomes.push_back(nome);
+        }
+    }
+    return nomes;
+}
+
+} // namespace ns3
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_CATEGORY_INDEX_H
+#define COTAS_CATEGORY_INDEX_H
+
+#include "cotas-bitmap.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Bitmaps of the subscribed devices per class, usedFor context and
+ *        boolean state.
+ *
+ * Devices get dense ordinals in subscription order, so the bitmaps of a
+ * home stay in one or a few containers.
+ */
+class CotasCategoryIndex
+{
+  public:
+    /// What a search response needs from a device
+    struct Device
+    {
+        int32_t id;    //!< objectId
+        uint32_t ip;   //!< IPv4 address
+        uint32_t port; //!< port
+    };
+
+    /**
+     * @brief Adds the device, if it is not indexed yet.
+     * @return the ordinal of the device
+     */
+    uint32_t Add(int32_t id, uint32_t ip, uint32_t port);
+
+    /**
+     * @brief Checks if the device is indexed.
+     */
+    bool Contains(int32_t id) const;
+
+    /**
+     * @brief Gets the ordinal of an indexed device.
+     * @return false if the device is not indexed
+     */
+    bool Ordinal(int32_t id, uint32_t& ordinal) const;
+
+    /**
+     * @brief Marks the device as an instance of the class (ex: cot:SmartWatch).
+     */
+    void AddClass(int32_t id, const std::string& name);
+
+    /**
+     * @brief Marks the device as used for the context (ex: cot:PetCare).
+     */
+    void AddUsedFor(int32_t id, const std::string& name);
+
+    /**
+     * @brief Sets a boolean state (ex: turnedOn) of the device.
+     */
+    void SetState(int32_t id, const std::string& key, bool value);
+
+    /**
+     * @brief Every indexed device.
+     */
+    const CotasBitmap& All() const;
+
+    /**
+     * @brief Devices of any of the classes.
+     */
+    CotasBitmap Classes(const std::vector<std::string>& names) const;
+
+    /**
+     * @brief Devices used for any of the contexts.
+     */
+    CotasBitmap UsedFor(const std::vector<std::string>& names) const;
+
+    /**
+     * @brief Names of the classes with at least one device.
+     */
+    std::vector<std::string> ClassNames() const;
+
+    /**
+     * @brief Names of the contexts with at least one device.
+     */
+    std::vector<std::string> UsedForNames() const;
+
+    /**
+     * @brief Devices whose state is known and equal to value.
+     */
+    CotasBitmap State(const std::string& key, bool value) const;
+
+    /**
+     * @brief Device of an ordinal.
+     */
+    const Device& Get(uint32_t ordinal) const;
+
+  private:
+    /// names with a non-empty bitmap
+    static std::vector<std::string> Names(
+        const std::unordered_map<std::string, CotasBitmap>& bitmaps);
+
+    /// union of the bitmaps of the names
+    static CotasBitmap Union(const std::unordered_map<std::string, CotasBitmap>& bitmaps,
+                             const std::vector<std::string>& names);
+
+    std::unordered_map<int32_t, uint32_t> m_ordinals;         //!< objectId -> ordinal
+    std::vector<Device> m_devices;                            //!< ordinal -> device
+    CotasBitmap m_all;                                        //!< every ordinal
+    std::unordered_map<std::string, CotasBitmap> m_classes;   //!< class -> devices
+    std::unordered_map<std::string, CotasBitmap> m_usedFor;   //!< context -> devices
+    std::unordered_map<std::string, CotasBitmap> m_true;      //!< state -> devices with 1
+    std::unordered_map<std::string, CotasBitmap> m_known;     //!< state -> devices with a value
+};
+
+} // namespace ns3
+
+#endif /* COTAS_CATEGORY_INDEX_H */
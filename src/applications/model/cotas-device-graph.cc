@@ -0,0 +1,707 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-device-graph.h"
+
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <sstream>
+
+namespace ns3
+{
+
+namespace
+{
+
+const std::string RDF_TYPE = "<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>";
+const std::string XSD = "http://www.w3.org/2001/XMLSchema#";
+
+/// Closes a token that is not an IRI or a literal
+bool
+IsDelimiter(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) || c == ';' || c == ',' || c == '[' ||
+           c == ']' || c == '(' || c == ')' || c == '<' || c == '"';
+}
+
+} // namespace
+
+const std::string CotasDeviceGraph::SKOLEM_PREFIX =
+    "http://nesped1.caf.ufv.br/.well-known/genid/";
+
+bool
+CotasDeviceGraph::Parse(const std::string& turtle,
+                        const std::string& prefixes,
+                        const std::string& name,
+                        std::string& skolemized)
+{
+    // declarações vêm uma por linha: BASE <iri> ou PREFIX p: <iri>
+    m_prefixes.clear();
+    m_base.clear();
+    std::istringstream linhas(prefixes);
+    std::string palavra;
+    while (linhas >> palavra)
+    {
+        std::string nome;
+        std::string iri;
+        if (palavra == "PREFIX")
+        {
+            linhas >> nome;
+        }
+        else if (palavra != "BASE")
+        {
+            return false;
+        }
+        linhas >> iri;
+        if (iri.size() < 2 || iri.front() != '<' || iri.back() != '>')
+        {
+            return false;
+        }
+        iri = Expand(iri);
+        if (palavra == "BASE")
+        {
+            m_base = iri.substr(1, iri.size() - 2);
+        }
+        else
+        {
+            m_prefixes[nome.substr(0, nome.size() - 1)] = iri.substr(1, iri.size() - 2);
+        }
+    }
+
+    m_node = SKOLEM_PREFIX + name + "-";
+    m_nextNode = 0;
+    m_triples.clear();
+
+    std::vector<Token> tokens;
+    if (!Tokenize(turtle, tokens))
+    {
+        return false;
+    }
+
+    // sujeito lista-de-predicados . , quantas vezes houver
+    std::vector<std::array<std::string, 3>> triplas;
+    size_t pos = 0;
+    while (pos < tokens.size())
+    {
+        std::string sujeito;
+        if (tokens[pos].kind == 't' && tokens[pos].text.front() == '<')
+        {
+            sujeito = tokens[pos++].text;
+        }
+        else if (!ReadObject(tokens, pos, sujeito, triplas) || sujeito.front() != '<')
+        {
+            return false;
+        }
+        if (pos < tokens.size() && tokens[pos].kind != '.' &&
+            !ReadPredicateObjects(tokens, pos, sujeito, triplas))
+        {
+            return false;
+        }
+        if (pos >= tokens.size() || tokens[pos].kind != '.')
+        {
+            return false;
+        }
+        pos++;
+        // o id e o ip vão no último sujeito, então ele é o dispositivo
+        m_subject = sujeito;
+    }
+
+    for (auto& [s, p, o] : triplas)
+    {
+        m_triples[{s, p}].push_back(o);
+    }
+    skolemized = Serialize();
+    return !skolemized.empty();
+}
+
+bool
+CotasDeviceGraph::Rename(const std::string& subject)
+{
+    auto cot = m_prefixes.find("cot");
+    if (cot == m_prefixes.end() || m_subject.empty() || subject == m_subject)
+    {
+        return false;
+    }
+
+    std::map<std::pair<std::string, std::string>, std::vector<std::string>> triplas;
+    for (auto& [chave, objetos] : m_triples)
+    {
+        std::string sujeito = chave.first == m_subject ? subject : chave.first;
+        auto& destino = triplas[{sujeito, chave.second}];
+        for (auto& objeto : objetos)
+        {
+            destino.push_back(objeto == m_subject ? subject : objeto);
+        }
+    }
+    triplas[{subject, "<" + cot->second + "instanceOf>"}].push_back(m_subject);
+    m_triples = std::move(triplas);
+    m_subject = subject;
+    return true;
+}
+
+std::string
+CotasDeviceGraph::Serialize(const std::vector<std::string>& dropped) const
+{
+    std::vector<std::string> fora;
+    auto cot = m_prefixes.find("cot");
+    for (auto& nome : dropped)
+    {
+        if (cot != m_prefixes.end())
+        {
+            fora.push_back("<" + cot->second + nome + ">");
+        }
+    }
+
+    // em largura a partir do dispositivo: só o que ele alcança é escrito,
+    // os nós nomeados primeiro e o dispositivo por último
+    std::ostringstream saida;
+    std::ostringstream dispositivo;
+    std::vector<std::string> fila = {m_subject};
+    for (size_t i = 0; i < fila.size(); i++)
+    {
+        std::string no = fila[i];
+        for (auto it = m_triples.lower_bound({no, ""});
+             it != m_triples.end() && it->first.first == no;
+             it++)
+        {
+            const std::string& predicado = it->first.second;
+            if (i == 0 && std::find(fora.begin(), fora.end(), predicado) != fora.end())
+            {
+                continue;
+            }
+            for (auto& objeto : it->second)
+            {
+                if (i == 0)
+                {
+                    dispositivo << (dispositivo.tellp() > 0 ? " ;\n    " : no + " ")
+                                << predicado << " " << objeto;
+                }
+                else
+                {
+                    saida << no << " " << predicado << " " << objeto << " .\n";
+                }
+                if (objeto.compare(0, m_node.size() + 1, "<" + m_node) == 0 &&
+                    std::find(fila.begin(), fila.end(), objeto) == fila.end())
+                {
+                    fila.push_back(objeto);
+                }
+            }
+        }
+    }
+    if (dispositivo.tellp() <= 0)
+    {
+        return "";
+    }
+    return saida.str() + dispositivo.str() + " .";
+}
+
+std::string
+CotasDeviceGraph::NTriples() const
+{
+    // em largura a partir do dispositivo, como em Serialize
+    std::ostringstream saida;
+    std::vector<std::string> fila = {m_subject};
+    for (size_t i = 0; i < fila.size(); i++)
+    {
+        const std::string no = fila[i];
+        for (auto it = m_triples.lower_bound({no, ""});
+             it != m_triples.end() && it->first.first == no;
+             it++)
+        {
+            for (auto& objeto : it->second)
+            {
+                saida << no << " " << it->first.second << " " << objeto << " .\n";
+                if (objeto.compare(0, m_node.size() + 1, "<" + m_node) == 0 &&
+                    std::find(fila.begin(), fila.end(), objeto) == fila.end())
+                {
+                    fila.push_back(objeto);
+                }
+            }
+        }
+    }
+    return saida.str();
+}
+
+const std::string&
+CotasDeviceGraph::Subject() const
+{
+    return m_subject;
+}
+
+bool
+CotasDeviceGraph::Compose(const std::string& subject,
+                          const std::vector<std::string>& statements,
+                          const nlohmann::json& values,
+                          std::string& turtle)
+{
+    // árvore das chaves: "a/T.b" vira cot:a [ a cot:T ; cot:b valor ]
+    struct No
+    {
+        std::map<std::string, No> filhos;
+        nlohmann::json valor;
+    };
+    No raiz;
+    for (auto& [chave, valor] : values.items())
+    {
+        // só valores que viram um literal: dump de lista ou objeto não é turtle
+        if (!valor.is_number() && !valor.is_boolean() && !valor.is_string())
+        {
+            return false;
+        }
+        No* no = &raiz;
+        size_t inicio = 0;
+        while (true)
+        {
+            size_t fim = chave.find('.', inicio);
+            std::string trecho = chave.substr(inicio, fim - inicio);
+            // cada nome vira cot:nome, que não pode ser vazio nem começar com '-'
+            bool valido = !trecho.empty();
+            char anterior = '/';
+            for (char c : trecho)
+            {
+                valido = valido && (std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+                                    (c == '-' && anterior != '/') || (c == '/' && anterior != '/'));
+                anterior = c;
+            }
+            valido = valido && anterior != '/';
+            // o último trecho é a propriedade, não leva tipo
+            if (!valido || (fim == std::string::npos && trecho.find('/') != std::string::npos))
+            {
+                return false;
+            }
+            no = &no->filhos[trecho];
+            if (fim == std::string::npos)
+            {
+                no->valor = valor;
+                break;
+            }
+            inicio = fim + 1;
+        }
+    }
+
+    std::function<std::string(const No&)> escreve = [&escreve](const No& no) {
+        std::string texto;
+        for (auto& [trecho, filho] : no.filhos)
+        {
+            size_t barra = trecho.find('/');
+            texto += " cot:" + trecho.substr(0, barra) + " ";
+            if (filho.filhos.empty())
+            {
+                texto += filho.valor.dump() + " ;";
+                continue;
+            }
+            texto += "[";
+            while (barra != std::string::npos)
+            {
+                size_t proxima = trecho.find('/', barra + 1);
+                texto += " a cot:" + trecho.substr(barra + 1, proxima - barra - 1) + " ;";
+                barra = proxima;
+            }
+            texto += escreve(filho) + " ] ;";
+        }
+        return texto;
+    };
+
+    turtle = subject;
+    for (auto& declaracao : statements)
+    {
+        turtle += " " + declaracao + " ;";
+    }
+    turtle += escreve(raiz) + " .";
+    return true;
+}
+
+bool
+CotasDeviceGraph::Patch(const std::string& key,
+                        const nlohmann::json& value,
+                        std::string& operations,
+                        Change& change) const
+{
+    auto cot = m_prefixes.find("cot");
+    std::string novo = Term(value);
+    if (cot == m_prefixes.end() || novo.empty())
+    {
+        return false;
+    }
+
+    // "a/Classe.b.c": a partir do dispositivo segue a, filtra os do
+    // tipo Classe, segue b e troca o valor de c
+    std::vector<std::pair<char, std::string>> passos;
+    char separador = '.';
+    std::string nome;
+    for (char c : key + '.')
+    {
+        if (c == '.' || c == '/')
+        {
+            if (nome.empty())
+            {
+                return false;
+            }
+            passos.emplace_back(separador, "<" + cot->second + nome + ">");
+            separador = c;
+            nome.clear();
+        }
+        else
+        {
+            nome += c;
+        }
+    }
+    if (passos.back().first != '.')
+    {
+        return false;
+    }
+
+    std::vector<std::string> nos = {m_subject};
+    for (size_t i = 0; i + 1 < passos.size(); i++)
+    {
+        std::vector<std::string> proximos;
+        for (auto& no : nos)
+        {
+            auto it = m_triples.find({no, passos[i].first == '.' ? passos[i].second : RDF_TYPE});
+            if (it == m_triples.end())
+            {
+                continue;
+            }
+            if (passos[i].first == '/')
+            {
+                for (auto& tipo : it->second)
+                {
+                    if (tipo == passos[i].second)
+                    {
+                        proximos.push_back(no);
+                        break;
+                    }
+                }
+                continue;
+            }
+            for (auto& objeto : it->second)
+            {
+                // só nós seguem adiante, literais não
+                if (objeto.front() == '<')
+                {
+                    proximos.push_back(objeto);
+                }
+            }
+        }
+        nos = std::move(proximos);
+    }
+    if (nos.empty())
+    {
+        return false;
+    }
+
+    // sem valor antigo conhecido o caminho fica com o SPARQL,
+    // que também não insere nada nesse caso
+    std::string linhas;
+    change.slots.clear();
+    for (auto& no : nos)
+    {
+        auto it = m_triples.find({no, passos.back().second});
+        if (it == m_triples.end() || it->second.empty())
+        {
+            return false;
+        }
+        for (auto& antigo : it->second)
+        {
+            linhas += "D " + no + " " + passos.back().second + " " + antigo + " .\n";
+        }
+        linhas += "A " + no + " " + passos.back().second + " " + novo + " .\n";
+        change.slots.emplace_back(no, passos.back().second);
+    }
+    change.object = novo;
+    operations += linhas;
+    return true;
+}
+
+void
+CotasDeviceGraph::Commit(const Change& change)
+{
+    for (auto& vaga : change.slots)
+    {
+        m_triples[vaga] = {change.object};
+    }
+}
+
+bool
+CotasDeviceGraph::Tokenize(const std::string& turtle, std::vector<Token>& tokens) const
+{
+    size_t i = 0;
+    while (i < turtle.size())
+    {
+        char c = turtle[i];
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            i++;
+        }
+        else if (c == '#')
+        {
+            i = turtle.find('\n', i);
+            i = i == std::string::npos ? turtle.size() : i;
+        }
+        else if (c == '[' || c == ']' || c == ';' || c == ',' || c == '.')
+        {
+            tokens.push_back({c, ""});
+            i++;
+        }
+        else if (c == '<')
+        {
+            size_t fim = turtle.find('>', i);
+            if (fim == std::string::npos)
+            {
+                return false;
+            }
+            tokens.push_back({'t', Expand(turtle.substr(i, fim - i + 1))});
+            i = fim + 1;
+        }
+        else if (c == '"')
+        {
+            // escapes do turtle valem no n-triples, o texto vai como está
+            if (turtle.compare(i, 3, "\"\"\"") == 0)
+            {
+                return false;
+            }
+            size_t fim = i + 1;
+            while (fim < turtle.size() && turtle[fim] != '"')
+            {
+                fim += turtle[fim] == '\\' ? 2 : 1;
+            }
+            if (fim >= turtle.size())
+            {
+                return false;
+            }
+            std::string literal = turtle.substr(i, fim - i + 1);
+            i = fim + 1;
+            if (turtle.compare(i, 3, "^^<") == 0)
+            {
+                size_t fimTipo = turtle.find('>', i);
+                if (fimTipo == std::string::npos)
+                {
+                    return false;
+                }
+                literal += "^^" + Expand(turtle.substr(i + 2, fimTipo - i - 1));
+                i = fimTipo + 1;
+            }
+            else if (turtle.compare(i, 2, "^^") == 0 || (i < turtle.size() && turtle[i] == '@'))
+            {
+                // @idioma ou ^^prefixo:tipo vão até o próximo delimitador
+                size_t inicio = i + (turtle[i] == '@' ? 1 : 2);
+                size_t fimTipo = inicio;
+                while (fimTipo < turtle.size() && !IsDelimiter(turtle[fimTipo]) &&
+                       !(turtle[fimTipo] == '.' && (fimTipo + 1 == turtle.size() ||
+                                                    IsDelimiter(turtle[fimTipo + 1]))))
+                {
+                    fimTipo++;
+                }
+                std::string sufixo = turtle.substr(inicio, fimTipo - inicio);
+                if (sufixo.empty())
+                {
+                    return false; // "x"@ ou "x"^^ sem nada depois
+                }
+                if (turtle[i] == '@')
+                {
+                    literal += "@" + sufixo;
+                }
+                else if (Expand(sufixo).empty())
+                {
+                    return false;
+                }
+                else
+                {
+                    literal += "^^" + Expand(sufixo);
+                }
+                i = fimTipo;
+            }
+            tokens.push_back({'t', literal});
+        }
+        else if (c == '(' || c == ')' || c == '\'')
+        {
+            // coleções e aspas simples não aparecem nos perfis
+            return false;
+        }
+        else
+        {
+            // nome com prefixo, palavra-chave ou número; um '.' no fim
+            // seguido de espaço fecha a declaração
+            size_t fim = i;
+            while (fim < turtle.size() && !IsDelimiter(turtle[fim]) &&
+                   !(turtle[fim] == '.' &&
+                     (fim + 1 == turtle.size() || IsDelimiter(turtle[fim + 1]))))
+            {
+                fim++;
+            }
+            std::string palavra = turtle.substr(i, fim - i);
+            i = fim;
+
+            std::string termo;
+            bool numero = std::isdigit(static_cast<unsigned char>(palavra[0])) ||
+                          ((palavra[0] == '+' || palavra[0] == '-' || palavra[0] == '.') &&
+                           palavra.size() > 1);
+            if (palavra == "a")
+            {
+                termo = RDF_TYPE;
+            }
+            else if (palavra == "true" || palavra == "false")
+            {
+                termo = "\"" + palavra + "\"^^<" + XSD + "boolean>";
+            }
+            else if (numero)
+            {
+                const char* tipo = palavra.find_first_of("eE") != std::string::npos ? "double"
+                                   : palavra.find('.') != std::string::npos       ? "decimal"
+                                                                                   : "integer";
+                termo = "\"" + palavra + "\"^^<" + XSD + tipo + ">";
+            }
+            else
+            {
+                termo = Expand(palavra);
+            }
+            if (termo.empty())
+            {
+                return false;
+            }
+            tokens.push_back({'t', termo});
+        }
+    }
+    return true;
+}
+
+bool
+CotasDeviceGraph::ReadPredicateObjects(const std::vector<Token>& tokens,
+                                       size_t& pos,
+                                       const std::string& subject,
+                                       std::vector<std::array<std::string, 3>>& triples)
+{
+    while (pos < tokens.size())
+    {
+        if (tokens[pos].kind != 't' || tokens[pos].text.front() != '<')
+        {
+            return false;
+        }
+        std::string predicado = tokens[pos++].text;
+        do
+        {
+            std::string objeto;
+            if (!ReadObject(tokens, pos, objeto, triples))
+            {
+                return false;
+            }
+            triples.push_back({subject, predicado, objeto});
+        } while (pos < tokens.size() && tokens[pos].kind == ',' && ++pos);
+
+        if (pos >= tokens.size() || tokens[pos].kind != ';')
+        {
+            return true;
+        }
+        // "; ;" e "; ]" são válidos
+        while (pos < tokens.size() && tokens[pos].kind == ';')
+        {
+            pos++;
+        }
+        if (pos < tokens.size() && (tokens[pos].kind == ']' || tokens[pos].kind == '.'))
+        {
+            return true;
+        }
+    }
+    return true;
+}
+
+bool
+CotasDeviceGraph::ReadObject(const std::vector<Token>& tokens,
+                             size_t& pos,
+                             std::string& object,
+                             std::vector<std::array<std::string, 3>>& triples)
+{
+    if (pos >= tokens.size())
+    {
+        return false;
+    }
+    if (tokens[pos].kind == 't')
+    {
+        object = tokens[pos++].text;
+        return true;
+    }
+    if (tokens[pos].kind != '[')
+    {
+        return false;
+    }
+
+    // nó em branco ganha um nome fixo, que as atualizações usam depois
+    object = "<" + m_node + std::to_string(m_nextNode++) + ">";
+    pos++;
+    if (pos < tokens.size() && tokens[pos].kind != ']' &&
+        !ReadPredicateObjects(tokens, pos, object, triples))
+    {
+        return false;
+    }
+    if (pos >= tokens.size() || tokens[pos].kind != ']')
+    {
+        return false;
+    }
+    pos++;
+    return true;
+}
+
+std::string
+CotasDeviceGraph::Expand(const std::string& name) const
+{
+    if (name.empty())
+    {
+        return "";
+    }
+    if (name.front() == '<')
+    {
+        // relativo à BASE: <#x> ou <x>
+        std::string iri = name.substr(1, name.size() - 2);
+        if (iri.find(':') != std::string::npos || m_base.empty())
+        {
+            return name;
+        }
+        if (iri.empty() || iri.front() == '#')
+        {
+            return "<" + m_base + iri + ">";
+        }
+        return "<" + m_base.substr(0, m_base.find_last_of('/') + 1) + iri + ">";
+    }
+    size_t doisPontos = name.find(':');
+    if (doisPontos == std::string::npos)
+    {
+        return "";
+    }
+    auto it = m_prefixes.find(name.substr(0, doisPontos));
+    if (it == m_prefixes.end())
+    {
+        return "";
+    }
+    return "<" + it->second + name.substr(doisPontos + 1) + ">";
+}
+
+std::string
+CotasDeviceGraph::Term(const nlohmann::json& value)
+{
+    // o mesmo termo que o SPARQL gravaria para valor.dump()
+    if (value.is_boolean())
+    {
+        return "\"" + value.dump() + "\"^^<" + XSD + "boolean>";
+    }
+    if (value.is_number_integer())
+    {
+        return "\"" + value.dump() + "\"^^<" + XSD + "integer>";
+    }
+    if (value.is_number())
+    {
+        std::string texto = value.dump();
+        const char* tipo = texto.find_first_of("eE") != std::string::npos ? "double" : "decimal";
+        return "\"" + texto + "\"^^<" + XSD + tipo + ">";
+    }
+    if (value.is_string())
+    {
+        return value.dump();
+    }
+    return "";
+}
+
+} // namespace ns3
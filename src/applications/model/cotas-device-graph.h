@@ -0,0 +1,151 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_DEVICE_GRAPH_H
+#define COTAS_DEVICE_GRAPH_H
+
+#include "json.hpp"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Skolemized description of one device, used to send its updates
+ *        as RDF Patch.
+ *
+ * Parse names every blank node of the subscription profile with an IRI
+ * under SKOLEM_PREFIX and keeps the resulting triples, so an update key
+ * such as "physicalStorage/CoatHanger.value" is resolved in memory to the
+ * node that holds the value. Patch then emits the delete/add pair of that
+ * triple, which the store applies without matching any graph pattern.
+ */
+class CotasDeviceGraph
+{
+  public:
+    /// Triples a Patch will replace: (subject, predicate) slots and the new object
+    struct Change
+    {
+        std::vector<std::pair<std::string, std::string>> slots; //!< (node, predicate)
+        std::string object;                                     //!< new object term
+    };
+
+    static const std::string SKOLEM_PREFIX; //!< namespace of the minted node IRIs
+
+    /**
+     * @brief Parses a Turtle profile and names its blank nodes.
+     * @param turtle the profile, statements without prefix declarations
+     * @param prefixes BASE and PREFIX declarations the profile uses
+     * @param name part of the minted IRIs, the objectId for devices
+     * @param skolemized the profile rewritten with the minted IRIs; the
+     *        statement about the device comes last, ending in " ."
+     * @return false if the profile uses syntax this parser does not know
+     */
+    bool Parse(const std::string& turtle,
+               const std::string& prefixes,
+               const std::string& name,
+               std::string& skolemized);
+
+    /**
+     * @brief Moves the device to another IRI.
+     *
+     * The old IRI stays as the cot:instanceOf of the device.
+     *
+     * @param subject the new device IRI, in N-Triples form
+     * @return false if nothing was parsed or the profile has no cot prefix
+     */
+    bool Rename(const std::string& subject);
+
+    /**
+     * @brief Writes the parsed profile back as Turtle.
+     * @param dropped cot properties of the device left out, together with
+     *        the nodes under them
+     */
+    std::string Serialize(const std::vector<std::string>& dropped = {}) const;
+
+    /**
+     * @brief Writes the parsed profile as N-Triples, one "s p o ." line
+     *        per triple the device reaches.
+     */
+    std::string NTriples() const;
+
+    /**
+     * @brief The device IRI, in N-Triples form.
+     */
+    const std::string& Subject() const;
+
+    /**
+     * @brief Builds the profile of a device from update-style keys.
+     * @param subject the device IRI
+     * @param statements predicate-object pairs written as they are
+     * @param values {"a.b": 1, "c": 2} gives cot:a [ cot:b 1 ] ; cot:c 2
+     * @param turtle receives the profile, ending in " ."
+     * @return false if a key is not a valid path or a value is not a
+     *         number, boolean or string
+     */
+    static bool Compose(const std::string& subject,
+                        const std::vector<std::string>& statements,
+                        const nlohmann::json& values,
+                        std::string& turtle);
+
+    /**
+     * @brief Builds the RDF Patch operations that set an update key.
+     * @param key update key, in the syntax of the update messages
+     * @param value new value
+     * @param operations receives the D and A rows
+     * @param change what Commit must record once the store applied them
+     * @return false if the key does not resolve to known values
+     */
+    bool Patch(const std::string& key,
+               const nlohmann::json& value,
+               std::string& operations,
+               Change& change) const;
+
+    /**
+     * @brief Records a change the store applied.
+     */
+    void Commit(const Change& change);
+
+  private:
+    /// Lexical token of the profile
+    struct Token
+    {
+        char kind;        //!< 't' term, or the punctuation itself
+        std::string text; //!< term in N-Triples form
+    };
+
+    bool Tokenize(const std::string& turtle, std::vector<Token>& tokens) const;
+    bool ReadPredicateObjects(const std::vector<Token>& tokens,
+                              size_t& pos,
+                              const std::string& subject,
+                              std::vector<std::array<std::string, 3>>& triples);
+    bool ReadObject(const std::vector<Token>& tokens,
+                    size_t& pos,
+                    std::string& object,
+                    std::vector<std::array<std::string, 3>>& triples);
+    std::string Expand(const std::string& name) const;
+
+    static std::string Term(const nlohmann::json& value);
+
+    std::string m_base;                              //!< BASE IRI
+    std::map<std::string, std::string> m_prefixes;   //!< prefix -> namespace
+    std::string m_node;                              //!< namespace of the minted IRIs
+    uint32_t m_nextNode{0};                          //!< next minted IRI number
+    std::string m_subject;                           //!< device IRI
+    std::map<std::pair<std::string, std::string>, std::vector<std::string>>
+        m_triples;                                   //!< (subject, predicate) -> objects
+};
+
+} // namespace ns3
+
+#endif /* COTAS_DEVICE_GRAPH_H */
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-heavy-hitters.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace ns3
+{
+
+CotasHeavyHitters::CotasHeavyHitters(uint32_t width, uint32_t depth, uint32_t k)
+    : m_width(std::max(width, 1u)),
+      m_depth(std::max(depth, 1u)),
+      m_k(k),
+      m_counters(static_cast<size_t>(m_width) * m_depth, 0)
+{
+}
+
+void
+CotasHeavyHitters::Add(const std::string& key, uint64_t count)
+{
+    m_total += count;
+    uint64_t hash = std::hash<std::string>{}(key);
+
+    // atualização conservadora: só sobe as células que ficariam abaixo da
+    // nova estimativa, o que reduz o erro das chaves raras
+    uint64_t estimativa = std::numeric_limits<uint64_t>::max();
+    for (uint32_t linha = 0; linha < m_depth; linha++)
+    {
+        estimativa = std::min(estimativa, m_counters[Index(hash, linha)]);
+    }
+    estimativa += count;
+    for (uint32_t linha = 0; linha < m_depth; linha++)
+    {
+        uint64_t& celula = m_counters[Index(hash, linha)];
+        celula = std::max(celula, estimativa);
+    }
+
+    if (m_k == 0)
+    {
+        return;
+    }
+    auto it = m_top.find(key);
+    if (it != m_top.end())
+    {
+        bool eraMenor = it->second == m_floor;
+        it->second = estimativa;
+        if (eraMenor)
+        {
+            UpdateFloor();
+        }
+        return;
+    }
+    if (m_top.size() >= m_k)
+    {
+        if (estimativa <= m_floor)
+        {
+            return;
+        }
+        // entra no lugar da menor
+        m_top.erase(std::min_element(m_top.begin(), m_top.end(), [](auto& a, auto& b) {
+            return a.second < b.second;
+        }));
+    }
+    m_top.emplace(key, estimativa);
+    UpdateFloor();
+}
+
+uint64_t
+CotasHeavyHitters::Estimate(const std::string& key) const
+{
+    uint64_t hash = std::hash<std::string>{}(key);
+    uint64_t estimativa = std::numeric_limits<uint64_t>::max();
+    for (uint32_t linha = 0; linha < m_depth; linha++)
+    {
+        estimativa = std::min(estimativa, m_counters[Index(hash, linha)]);
+    }
+    return estimativa;
+}
+
+std::vector<CotasHeavyHitters::Entry>
+CotasHeavyHitters::Top() const
+{
+    std::vector<Entry> chaves(m_top.begin(), m_top.end());
+    std::sort(chaves.begin(), chaves.end(), [](const Entry& a, const Entry& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return chaves;
+}
+
+uint64_t
+CotasHeavyHitters::Total() const
+{
+    return m_total;
+}
+
+void
+CotasHeavyHitters::Clear()
+{
+    std::fill(m_counters.begin(), m_counters.end(), 0);
+    m_top.clear();
+    m_floor = 0;
+    m_total = 0;
+}
+
+void
+CotasHeavyHitters::UpdateFloor()
+{
+    // só com o top cheio uma chave nova precisa superar alguém
+    m_floor = 0;
+    if (m_top.size() >= m_k)
+    {
+        m_floor = std::min_element(m_top.begin(), m_top.end(), [](auto& a, auto& b) {
+                      return a.second < b.second;
+                  })->second;
+    }
+}
+
+size_t
+CotasHeavyHitters::Index(uint64_t hash, uint32_t row) const
+{
+    // hash duplo: cada linha usa h1 + linha * h2
+    uint64_t segundo = (hash ^ (hash >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    segundo = (segundo ^ (segundo >> 32)) | 1;
+    return static_cast<size_t>(row) * m_width + (hash + row * segundo) % m_width;
+}
+
+} // namespace ns3
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_HEAVY_HITTERS_H
+#define COTAS_HEAVY_HITTERS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Most frequent keys of a stream, in fixed memory.
+ *
+ * A count-min sketch estimates the count of every key; the k keys with
+ * the largest estimates are kept by name. Estimates never fall below the
+ * real count and exceed it by at most 2/width of the total with
+ * probability 1 - 2^-depth. Add costs depth counter increments and, for
+ * keys outside the top, one comparison with the smallest top count.
+ */
+class CotasHeavyHitters
+{
+  public:
+    /// Key and estimated count
+    using Entry = std::pair<std::string, uint64_t>;
+
+    /**
+     * @param width counters per row
+     * @param depth rows, each with its own hash
+     * @param k keys kept by name
+     */
+    CotasHeavyHitters(uint32_t width = 1024, uint32_t depth = 4, uint32_t k = 10);
+
+    /**
+     * @brief Counts occurrences of a key.
+     */
+    void Add(const std::string& key, uint64_t count = 1);
+
+    /**
+     * @brief Estimated count of a key.
+     */
+    uint64_t Estimate(const std::string& key) const;
+
+    /**
+     * @brief Kept keys, most frequent first.
+     */
+    std::vector<Entry> Top() const;
+
+    /**
+     * @brief Sum of all counts added.
+     */
+    uint64_t Total() const;
+
+    /**
+     * @brief Forgets every count, to start a new period.
+     */
+    void Clear();
+
+  private:
+    /// position in m_counters of the key counter in a row
+    size_t Index(uint64_t hash, uint32_t row) const;
+
+    /// recomputes m_floor after the top changed
+    void UpdateFloor();
+
+    uint32_t m_width;                                //!< counters per row
+    uint32_t m_depth;                                //!< number of rows
+    uint32_t m_k;                                    //!< size of the top
+    std::vector<uint64_t> m_counters;                //!< depth x width
+    std::unordered_map<std::string, uint64_t> m_top; //!< kept key -> estimate
+    uint64_t m_floor{0};                             //!< smallest estimate in a full top
+    uint64_t m_total{0};                             //!< sum of all counts
+};
+
+} // namespace ns3
+
+#endif /* COTAS_HEAVY_HITTERS_H */
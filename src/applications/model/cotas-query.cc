@@ -0,0 +1,651 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-query.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace ns3
+{
+
+bool
+CotasQuery::IsStructured(const std::string& payload)
+{
+    // consultas sparql começam com ?device ou com { (UNION),
+    // então só aceita como json se o parse der certo e for objeto
+    size_t first = payload.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos || payload[first] != '{')
+    {
+        return false;
+    }
+    nlohmann::json j = nlohmann::json::parse(payload, nullptr, false);
+    return !j.is_discarded() && j.is_object();
+}
+
+bool
+CotasQuery::Parse(const nlohmann::json& payload, CotasQuery& query, std::string& error)
+{
+    query = CotasQuery();
+
+    if (!payload.is_object())
+    {
+        error = "query must be a json object";
+        return false;
+    }
+
+    for (auto& elemento : payload.items())
+    {
+        const std::string& chave = elemento.key();
+        const nlohmann::json& valor = elemento.value();
+
+        if (chave == "class" || chave == "usedFor")
+        {
+            std::vector<std::string>& destino =
+                (chave == "class") ? query.m_classes : query.m_usedFor;
+            nlohmann::json lista = valor.is_array() ? valor : nlohmann::json::array({valor});
+
+            if (lista.empty() || lista.size() > MAX_SET_SIZE)
+            {
+                error = "'" + chave + "' must have between 1 and " +
+                        std::to_string(MAX_SET_SIZE) + " names";
+                return false;
+            }
+            for (auto& item : lista)
+            {
+                std::string nome;
+                if (!ParseName(item, nome))
+                {
+                    error = "invalid name in '" + chave + "': " + item.dump();
+                    return false;
+                }
+                destino.push_back(nome);
+            }
+            std::sort(destino.begin(), destino.end());
+            destino.erase(std::unique(destino.begin(), destino.end()), destino.end());
+        }
+        else if (chave == "where")
+        {
+            if (!valor.is_object() || valor.size() > MAX_PREDICATES)
+            {
+                error = "'where' must be an object with at most " +
+                        std::to_string(MAX_PREDICATES) + " properties";
+                return false;
+            }
+            for (auto& filtro : valor.items())
+            {
+                std::vector<std::string> tokens;
+                if (!ParsePath(filtro.key(), tokens))
+                {
+                    error = "invalid property path: " + filtro.key();
+                    return false;
+                }
+
+                // "prop": valor é igualdade, "prop": {"lt": x, ...} são comparações
+                nlohmann::json comparacoes = filtro.value();
+                if (!comparacoes.is_object())
+                {
+                    comparacoes = {{"eq", filtro.value()}};
+                }
+                if (comparacoes.empty())
+                {
+                    error = "empty filter for " + filtro.key();
+                    return false;
+                }
+                for (auto& comparacao : comparacoes.items())
+                {
+                    Predicate predicado;
+                    predicado.path = filtro.key();
+                    predicado.value = comparacao.value();
+                    std::string nome;
+                    if (!ParseOperator(comparacao.key(), predicado.op))
+                    {
+                        error = "unknown operator: " + comparacao.key();
+                        return false;
+                    }
+                    if (!predicado.value.is_number() && !predicado.value.is_boolean() &&
+                        !ParseName(predicado.value, nome))
+                    {
+                        error = "invalid value for " + filtro.key();
+                        return false;
+                    }
+                    if (predicado.value.is_string() && predicado.op != EQ && predicado.op != NE)
+                    {
+                        error = "only eq/ne can compare names: " + filtro.key();
+                        return false;
+                    }
+                    if (predicado.value.is_string())
+                    {
+                        predicado.value = nome;
+                    }
+                    query.m_predicates.push_back(predicado);
+                }
+            }
+            if (query.m_predicates.size() > MAX_PREDICATES)
+            {
+                error = "too many comparisons in 'where'";
+                return false;
+            }
+        }
+        else if (chave == "near")
+        {
+            if (!valor.is_object() || !valor.contains("latitude") ||
+                !valor.contains("longitude") || !valor["latitude"].is_number() ||
+                !valor["longitude"].is_number())
+            {
+                error = "'near' needs numeric latitude and longitude";
+                return false;
+            }
+            for (auto& campo : valor.items())
+            {
+                if (campo.key() != "latitude" && campo.key() != "longitude" &&
+                    campo.key() != "radius")
+                {
+                    error = "unknown field in 'near': " + campo.key();
+                    return false;
+                }
+            }
+            query.m_near = true;
+            query.m_latitude = valor["latitude"].get<double>();
+            query.m_longitude = valor["longitude"].get<double>();
+            if (valor.contains("radius"))
+            {
+                if (!valor["radius"].is_number() || valor["radius"].get<double>() <= 0)
+                {
+                    error = "'radius' must be a positive number";
+                    return false;
+                }
+                query.m_radius = valor["radius"].get<double>();
+            }
+        }
+        else if (chave == "zone")
+        {
+            std::string nome;
+            if (!valor.is_string() || !ParseName(valor, nome))
+            {
+                error = "invalid zone: " + valor.dump();
+                return false;
+            }
+            query.m_zone = valor.get<std::string>();
+        }
+        else if (chave == "limit")
+        {
+            if (!valor.is_number_unsigned() || valor.get<uint32_t>() == 0 ||
+                valor.get<uint32_t>() > MAX_LIMIT)
+            {
+                error = "'limit' must be between 1 and " + std::to_string(MAX_LIMIT);
+                return false;
+            }
+            query.m_limit = valor.get<uint32_t>();
+        }
+        else if (chave == "project")
+        {
+            if (!valor.is_array() || valor.size() > MAX_PREDICATES)
+            {
+                error = "'project' must be an array with at most " +
+                        std::to_string(MAX_PREDICATES) + " properties";
+                return false;
+            }
+            for (auto& item : valor)
+            {
+                std::vector<std::string> tokens;
+                if (!item.is_string() || !ParsePath(item.get<std::string>(), tokens))
+                {
+                    error = "invalid property path: " + item.dump();
+                    return false;
+                }
+                query.m_project.push_back(item.get<std::string>());
+            }
+        }
+        else
+        {
+            error = "unknown field: " + chave;
+            return false;
+        }
+    }
+
+    std::sort(query.m_project.begin(), query.m_project.end());
+    query.m_project.erase(std::unique(query.m_project.begin(), query.m_project.end()),
+                          query.m_project.end());
+    std::sort(query.m_predicates.begin(),
+              query.m_predicates.end(),
+              [](const Predicate& a, const Predicate& b) {
+                  if (a.path != b.path)
+                  {
+                      return a.path < b.path;
+                  }
+                  return a.op < b.op;
+              });
+    return true;
+}
+
+uint32_t
+CotasQuery::Cost() const
+{
+    // cada padrão do grafo é uma junção no fuseki;
+    // ip, porta e id sempre entram
+    uint32_t custo = 3;
+    custo += m_classes.empty() ? 0 : 1;
+    custo += m_usedFor.empty() ? 0 : 2;
+
+    for (auto& predicado : m_predicates)
+    {
+        std::vector<std::string> tokens;
+        ParsePath(predicado.path, tokens);
+        custo += (tokens.size() + 1) / 2;
+    }
+
+    // sem classe, contexto ou região não há âncora,
+    // o fuseki percorre todos os dispositivos
+    if (m_classes.empty() && m_usedFor.empty() && !IsSpatial())
+    {
+        custo *= 4;
+    }
+    return custo;
+}
+
+bool
+CotasQuery::IsSpatial() const
+{
+    return m_near || !m_zone.empty();
+}
+
+std::string
+CotasQuery::ToSparqlWhere(const std::vector<int32_t>& candidates, bool stateGraphs) const
+{
+    std::ostringstream where;
+
+    // candidatos do índice espacial são a âncora mais seletiva
+    if (!candidates.empty())
+    {
+        where << "VALUES ?id {";
+        for (int32_t id : candidates)
+        {
+            where << " " << id;
+        }
+        where << " } ?device cot:objectId ?id . ";
+    }
+
+    // os conjuntos vem primeiro: VALUES é mais barato que
+    // FILTER IN depois de varrer todos os "?device a ?class"
+    if (m_classes.size() == 1)
+    {
+        where << "?device a " << m_classes[0] << " . ";
+    }
+    else if (!m_classes.empty())
+    {
+        where << "VALUES ?class {";
+        for (auto& classe : m_classes)
+        {
+            where << " " << classe;
+        }
+        where << " } ?device a ?class . ";
+    }
+
+    if (!m_usedFor.empty())
+    {
+        if (m_classes.empty())
+        {
+            where << "?device a ?class . ";
+        }
+        std::string classe = (m_classes.size() == 1) ? m_classes[0] : "?class";
+        if (m_usedFor.size() == 1)
+        {
+            where << classe << " cot:usedFor " << m_usedFor[0] << " . ";
+        }
+        else
+        {
+            where << "VALUES ?context {";
+            for (auto& contexto : m_usedFor)
+            {
+                where << " " << contexto;
+            }
+            where << " } " << classe << " cot:usedFor ?context . ";
+        }
+    }
+
+    if (candidates.empty())
+    {
+        where << "?device cot:objectId ?id . ";
+    }
+    where << "?device cot:ipAddress ?ip . "
+          << "?device cot:port ?port . ";
+
+    // cada caminho vira uma cadeia de variaveis ?pN_M
+    size_t n = 0;
+    std::vector<std::pair<std::string, std::string>> caminhos; // caminho -> variavel final
+    for (auto& predicado : m_predicates)
+    {
+        std::string variavel;
+        for (auto& visto : caminhos)
+        {
+            if (visto.first == predicado.path)
+            {
+                variavel = visto.second;
+            }
+        }
+
+        if (variavel.empty())
+        {
+            std::string cadeia;
+            std::string no =
+                PathPattern(predicado.path, "?device", "?p" + std::to_string(n), cadeia);
+
+            if (stateGraphs)
+            {
+                // valor do grafo de estado, se o dispositivo já atualizou,
+                // senão o do perfil
+                variavel = "?p" + std::to_string(n);
+                where << "OPTIONAL { " << cadeia << "} "
+                      << "OPTIONAL { GRAPH " << STATE_GRAPH << " { " << variavel
+                      << "_s cot:objectId ?id ; " << StateProperty(predicado.path) << " "
+                      << variavel << "_e . } } "
+                      << "BIND (COALESCE(" << variavel << "_e, " << no << ") AS " << variavel
+                      << ") ";
+            }
+            else
+            {
+                where << cadeia;
+                variavel = no;
+            }
+            caminhos.emplace_back(predicado.path, variavel);
+            n++;
+        }
+
+        static const char* simbolos[] = {"=", "!=", "<", "<=", ">", ">="};
+        where << "FILTER (" << variavel << " " << simbolos[predicado.op] << " "
+              << Literal(predicado.value) << ") ";
+    }
+
+    where << "FILTER (!isBlank(?device))";
+    return where.str();
+}
+
+std::string
+CotasQuery::PathPattern(const std::string& path,
+                        const std::string& node,
+                        const std::string& prefix,
+                        std::string& pattern)
+{
+    std::vector<std::string> tokens;
+    ParsePath(path, tokens);
+
+    std::ostringstream cadeia;
+    std::string no = node;
+    size_t m = 0;
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        if (tokens[i] == "/")
+        {
+            cadeia << no << " a cot:" << tokens[++i] << " . ";
+        }
+        else if (tokens[i] != ".")
+        {
+            // o primeiro passo também vale pelo modelo do dispositivo,
+            // onde fica o perfil estático dos assinados por referência
+            std::string proximo = prefix + "_" + std::to_string(m);
+            cadeia << no << (m++ == 0 ? " cot:instanceOf?/cot:" : " cot:") << tokens[i] << " "
+                   << proximo << " . ";
+            no = proximo;
+        }
+    }
+    pattern = cadeia.str();
+    return no;
+}
+
+std::string
+CotasQuery::StateGraph(int32_t id)
+{
+    return "<urn:cotas:state:" + std::to_string(id) + ">";
+}
+
+std::string
+CotasQuery::StateSubject(int32_t id)
+{
+    return "<urn:cotas:device:" + std::to_string(id) + ">";
+}
+
+std::string
+CotasQuery::DeviceSubject(int32_t id)
+{
+    return "<urn:cotas:object:" + std::to_string(id) + ">";
+}
+
+std::string
+CotasQuery::StateProperty(const std::string& path)
+{
+    std::vector<std::string> tokens;
+    if (!ParsePath(path, tokens))
+    {
+        return "";
+    }
+    if (tokens.size() == 1)
+    {
+        std::string nome;
+        ParseName(tokens[0], nome);
+        return nome;
+    }
+
+    // normaliza os nomes para o mesmo caminho dar a mesma IRI
+    std::string iri = "<urn:cotas:path:";
+    for (auto& token : tokens)
+    {
+        std::string nome;
+        iri += ParseName(token, nome) ? nome.substr(4) : token;
+    }
+    return iri + ">";
+}
+
+std::string
+CotasQuery::Key() const
+{
+    // Parse já deixa tudo ordenado, então o dump é canônico
+    nlohmann::json canonico = {{"class", m_classes},
+                               {"usedFor", m_usedFor},
+                               {"limit", m_limit}};
+    nlohmann::json filtros = nlohmann::json::array();
+    for (auto& predicado : m_predicates)
+    {
+        filtros.push_back({predicado.path, predicado.op, predicado.value});
+    }
+    canonico["where"] = filtros;
+    if (m_near)
+    {
+        canonico["near"] = {m_latitude, m_longitude, m_radius};
+    }
+    if (!m_zone.empty())
+    {
+        canonico["zone"] = m_zone;
+    }
+    // a projeção muda a resposta, então entra na chave
+    if (!m_project.empty())
+    {
+        canonico["project"] = m_project;
+    }
+    return canonico.dump();
+}
+
+std::string
+CotasQuery::Shape() const
+{
+    nlohmann::json forma = {{"class", m_classes}, {"usedFor", m_usedFor}};
+    nlohmann::json filtros = nlohmann::json::array();
+    for (auto& predicado : m_predicates)
+    {
+        filtros.push_back({predicado.path, predicado.op});
+    }
+    forma["where"] = filtros;
+    if (m_near)
+    {
+        forma["near"] = m_radius > 0 ? "radius" : "sort";
+    }
+    if (!m_zone.empty())
+    {
+        forma["zone"] = true;
+    }
+    if (!m_project.empty())
+    {
+        forma["project"] = m_project;
+    }
+    return forma.dump();
+}
+
+std::string
+CotasQuery::FragmentShape(const std::string& fragment)
+{
+    std::string forma;
+    forma.reserve(fragment.size());
+    for (size_t i = 0; i < fragment.size(); i++)
+    {
+        char c = fragment[i];
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            if (!forma.empty() && forma.back() != ' ')
+            {
+                forma += ' ';
+            }
+        }
+        else if (c == '"')
+        {
+            // string até a aspa que fecha, com escapes
+            for (i++; i < fragment.size() && fragment[i] != '"'; i++)
+            {
+                i += fragment[i] == '\\';
+            }
+            forma += '?';
+        }
+        else if (std::isdigit(static_cast<unsigned char>(c)) &&
+                 (forma.empty() || !std::isalnum(static_cast<unsigned char>(forma.back()))))
+        {
+            // número fora de nome: 12, -3.5, 1e3
+            while (i + 1 < fragment.size() &&
+                   (std::isalnum(static_cast<unsigned char>(fragment[i + 1])) ||
+                    fragment[i + 1] == '.') &&
+                   !(fragment[i + 1] == '.' &&
+                     (i + 2 >= fragment.size() ||
+                      !std::isdigit(static_cast<unsigned char>(fragment[i + 2])))))
+            {
+                i++;
+            }
+            if (!forma.empty() && forma.back() == '-')
+            {
+                forma.pop_back();
+            }
+            forma += '?';
+        }
+        else
+        {
+            forma += c;
+        }
+    }
+    if (!forma.empty() && forma.back() == ' ')
+    {
+        forma.pop_back();
+    }
+    return forma;
+}
+
+// aceita "cot:Nome" ou "Nome", devolve sempre "cot:Nome"
+bool
+CotasQuery::ParseName(const nlohmann::json& value, std::string& name)
+{
+    if (!value.is_string())
+    {
+        return false;
+    }
+    std::string nome = value.get<std::string>();
+    if (nome.rfind("cot:", 0) == 0)
+    {
+        nome.erase(0, 4);
+    }
+    if (nome.empty() || !(std::isalpha(static_cast<unsigned char>(nome[0])) || nome[0] == '_'))
+    {
+        return false;
+    }
+    for (char c : nome)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+        {
+            return false;
+        }
+    }
+    name = "cot:" + nome;
+    return true;
+}
+
+// mesmo analisador léxico das atualizações:
+// "essa/é.uma.chave" => [ "essa", "/", "é", ".", "uma", ".", "chave"]
+bool
+CotasQuery::ParsePath(const std::string& path, std::vector<std::string>& tokens)
+{
+    tokens.clear();
+    std::string palavra;
+    for (char c : path)
+    {
+        if (c == '.' || c == '/')
+        {
+            tokens.push_back(palavra);
+            tokens.emplace_back(1, c);
+            palavra.clear();
+        }
+        else
+        {
+            palavra += c;
+        }
+    }
+    tokens.push_back(palavra);
+
+    // primeiro e último são propriedades, e não pode haver
+    // dois separadores seguidos nem nomes inválidos
+    size_t saltos = 0;
+    for (size_t i = 0; i < tokens.size(); i += 2)
+    {
+        std::string nome;
+        if (!ParseName(tokens[i], nome))
+        {
+            return false;
+        }
+        if (i == 0 || tokens[i - 1] == ".")
+        {
+            saltos++;
+        }
+    }
+    bool terminaEmPropriedade = tokens.size() == 1 || tokens[tokens.size() - 2] == ".";
+    return terminaEmPropriedade && saltos <= MAX_PATH_DEPTH;
+}
+
+bool
+CotasQuery::ParseOperator(const std::string& op, Operator& out)
+{
+    static const std::vector<std::pair<std::string, Operator>> operadores = {
+        {"eq", EQ}, {"ne", NE}, {"lt", LT}, {"lte", LTE}, {"gt", GT}, {"gte", GTE}};
+    for (auto& par : operadores)
+    {
+        if (par.first == op)
+        {
+            out = par.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string
+CotasQuery::Literal(const nlohmann::json& value)
+{
+    if (value.is_boolean())
+    {
+        return value.get<bool>() ? "1" : "0";
+    }
+    if (value.is_string())
+    {
+        return value.get<std::string>(); // já validado como cot:Nome
+    }
+    return value.dump();
+}
+
+} // namespace ns3
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_QUERY_H
+#define COTAS_QUERY_H
+
+#include "json.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Structured search accepted by CoTaS on /search.
+ *
+ * Instead of a raw SPARQL fragment the consumer may send a JSON object:
+ *
+ * @code
+ * {
+ *   "class":   ["cot:SmartWatch", "cot:SmartRing"],
+ *   "usedFor": ["cot:PetCare"],
+ *   "where":   { "turnedOn": 1, "powerSupply.batteryLevel": { "lt": 20 } },
+ *   "near":    { "latitude": 3, "longitude": 9, "radius": 3 },
+ *   "zone":    "Kitchen",
+ *   "limit":   1
+ * }
+ * @endcode
+ *
+ * Property paths in "where" use the same syntax as the update messages
+ * ("a.b" walks into a node, "a/Class" types the node). The query is
+ * validated on Parse and compiled to a SPARQL WHERE body that binds
+ * ?device, ?id, ?ip and ?port.
+ *
+ * "near" and "zone" are answered by the CoTaS spatial index: the store
+ * only checks the candidates it returns, and results are sorted by
+ * distance. Without "radius", "near" with "limit" k is a k-nearest search.
+ */
+class CotasQuery
+{
+  public:
+    /// Comparison applied to a property value
+    enum Operator
+    {
+        EQ,
+        NE,
+        LT,
+        LTE,
+        GT,
+        GTE
+    };
+
+    /// One "where" predicate: path op value
+    struct Predicate
+    {
+        std::string path;     //!< property path, ex: powerSupply.batteryLevel
+        Operator op;          //!< comparison
+        nlohmann::json value; //!< number, boolean or cot: name
+    };
+
+    static constexpr size_t MAX_SET_SIZE{32};   //!< max names in class/usedFor
+    static constexpr size_t MAX_PREDICATES{8};  //!< max entries in "where"
+    static constexpr size_t MAX_PATH_DEPTH{6};  //!< max hops in a property path
+    static constexpr uint32_t MAX_LIMIT{50};    //!< max results per query
+
+    /// Union of every device state graph, as seen by the search service
+    static constexpr const char* STATE_GRAPH{"<urn:cotas:state>"};
+
+    /**
+     * @brief Checks if the payload looks like a structured query.
+     * @param payload the raw /search payload
+     * @return true if it is a JSON object
+     */
+    static bool IsStructured(const std::string& payload);
+
+    /**
+     * @brief Parses and validates a structured query.
+     * @param payload the JSON object sent by the consumer
+     * @param query output query
+     * @param error reason of the rejection, when false is returned
+     * @return true if the query is valid
+     */
+    static bool Parse(const nlohmann::json& payload, CotasQuery& query, std::string& error);
+
+    /**
+     * @brief Graph pattern walking a property path.
+     * @param path property path, ex: powerSupply.batteryLevel
+     * @param node variable the path starts from, ex: ?device; its first
+     *        property may also be found on its cot:instanceOf model
+     * @param prefix prefix of the variables created along the path
+     * @param pattern output graph pattern
+     * @return the variable bound to the value at the end of the path
+     */
+    static std::string PathPattern(const std::string& path,
+                                   const std::string& node,
+                                   const std::string& prefix,
+                                   std::string& pattern);
+
+    /**
+     * @brief Named graph holding the volatile values of one device.
+     */
+    static std::string StateGraph(int32_t id);
+
+    /**
+     * @brief Subject of the volatile values of one device.
+     */
+    static std::string StateSubject(int32_t id);
+
+    /**
+     * @brief IRI minted for one subscribed device.
+     *
+     * Units of the same product subscribe with the same subject, so each
+     * is stored under its own IRI, with cot:instanceOf the original one.
+     */
+    static std::string DeviceSubject(int32_t id);
+
+    /**
+     * @brief Property used for an update key in the state graphs.
+     *
+     * A single property keeps its cot: name; a path such as
+     * "powerSupply.batteryLevel" is flattened to one IRI, since the
+     * blank nodes it walks through live in the reasoned graph.
+     *
+     * @return empty if the key is not a valid path
+     */
+    static std::string StateProperty(const std::string& path);
+
+    /**
+     * @brief Estimated cost of running the query in the store.
+     *
+     * Counts the joins the store has to make; a query without class or
+     * usedFor is not anchored and pays for scanning every device.
+     */
+    uint32_t Cost() const;
+
+    /**
+     * @brief Checks if the query has a "near" or "zone" constraint.
+     */
+    bool IsSpatial() const;
+
+    /**
+     * @brief Compiles the query into the body of a SPARQL WHERE clause.
+     * @param candidates if not empty, only these objectIds may match
+     * @param stateGraphs read "where" values from the device state
+     *        graphs first, falling back to the profile
+     * @return graph patterns binding ?device ?id ?ip ?port
+     */
+    std::string ToSparqlWhere(const std::vector<int32_t>& candidates = {},
+                              bool stateGraphs = false) const;
+
+    /**
+     * @brief Canonical text of the query, equal for equivalent queries.
+     */
+    std::string Key() const;
+
+    /**
+     * @brief Key() without the constants, equal for queries that differ
+     *        only in values, limit or reference point.
+     */
+    std::string Shape() const;
+
+    /**
+     * @brief Shape of a SPARQL fragment search: literals become "?" and
+     *        whitespace runs one space.
+     */
+    static std::string FragmentShape(const std::string& fragment);
+
+    std::vector<std::string> m_classes;   //!< device class must be one of these
+    std::vector<std::string> m_usedFor;   //!< device class must be used for one of these
+    std::vector<Predicate> m_predicates;  //!< property filters
+    uint32_t m_limit{1};                  //!< max number of results
+    bool m_near{false};                   //!< sort by distance to (m_latitude, m_longitude)
+    double m_latitude{0};                 //!< reference point y
+    double m_longitude{0};                //!< reference point x
+    double m_radius{0};                   //!< max distance, 0 for no limit
+    std::string m_zone;                   //!< named area configured in CoTaS
+    std::vector<std::string> m_project;   //!< update keys returned with each result
+
+  private:
+    static bool ParseName(const nlohmann::json& value, std::string& name);
+    static bool ParsePath(const std::string& path, std::vector<std::string>& tokens);
+    static bool ParseOperator(const std::string& op, Operator& out);
+    static std::string Literal(const nlohmann::json& value);
+};
+
+} // namespace ns3
+
+#endif /* COTAS_QUERY_H */
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-range-index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+void
+CotasRangeIndex::Configure(const std::vector<std::string>& keys)
+{
+    m_keys = keys;
+    m_properties.clear();
+    for (auto& chave : keys)
+    {
+        m_properties[chave];
+    }
+}
+
+const std::vector<std::string>&
+CotasRangeIndex::Keys() const
+{
+    return m_keys;
+}
+
+bool
+CotasRangeIndex::Indexes(const std::string& key) const
+{
+    return m_properties.count(key) > 0;
+}
+
+void
+CotasRangeIndex::Update(int32_t id, const std::string& key, double value)
+{
+    auto it = m_properties.find(key);
+    if (it == m_properties.end() || std::isnan(value))
+    {
+        return;
+    }
+    Property& p = it->second;
+    auto [atual, novo] = p.values.try_emplace(id, value);
+    if (!novo)
+    {
+        if (atual->second == value)
+        {
+            return;
+        }
+        p.ordered.erase({atual->second, id});
+        atual->second = value;
+    }
+    p.ordered.emplace(value, id);
+}
+
+std::vector<int32_t>
+CotasRangeIndex::Range(const std::string& key, CotasQuery::Operator op, double operand) const
+{
+    std::vector<int32_t> ids;
+    auto it = m_properties.find(key);
+    if (it == m_properties.end())
+    {
+        return ids;
+    }
+    const auto& ordenado = it->second.ordered;
+
+    // primeiro par com valor == operand e primeiro com valor > operand
+    constexpr int32_t menor = std::numeric_limits<int32_t>::min();
+    constexpr int32_t maior = std::numeric_limits<int32_t>::max();
+    auto inicioIgual = ordenado.lower_bound({operand, menor});
+    auto fimIgual = ordenado.upper_bound({operand, maior});
+
+    auto coleta = [&ids](auto de, auto ate) {
+        for (; de != ate; de++)
+        {
+            ids.push_back(de->second);
+        }
+    };
+
+    switch (op)
+    {
+    case CotasQuery::EQ:
+        coleta(inicioIgual, fimIgual);
+        break;
+    case CotasQuery::NE:
+        coleta(ordenado.begin(), inicioIgual);
+        coleta(fimIgual, ordenado.end());
+        break;
+    case CotasQuery::LT:
+        coleta(ordenado.begin(), inicioIgual);
+        break;
+    case CotasQuery::LTE:
+        coleta(ordenado.begin(), fimIgual);
+        break;
+    case CotasQuery::GT:
+        coleta(fimIgual, ordenado.end());
+        break;
+    case CotasQuery::GTE:
+        coleta(inicioIgual, ordenado.end());
+        break;
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace ns3
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_RANGE_INDEX_H
+#define COTAS_RANGE_INDEX_H
+
+#include "cotas-query.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Ordered index of the current value of selected numeric properties.
+ *
+ * Properties are named by update keys (ex: temperature,
+ * powerSupply.batteryLevel). Each one keeps its (value, objectId) pairs in
+ * a balanced tree, so a threshold search walks only the matching range.
+ */
+class CotasRangeIndex
+{
+  public:
+    /**
+     * @brief Sets the indexed properties and drops every value.
+     */
+    void Configure(const std::vector<std::string>& keys);
+
+    /**
+     * @brief Indexed properties.
+     */
+    const std::vector<std::string>& Keys() const;
+
+    /**
+     * @brief Checks if the property is indexed.
+     */
+    bool Indexes(const std::string& key) const;
+
+    /**
+     * @brief Sets the current value of a device; ignored if the property is
+     *        not indexed.
+     */
+    void Update(int32_t id, const std::string& key, double value);
+
+    /**
+     * @brief Devices whose value satisfies "value op operand".
+     * @return objectIds in increasing order
+     */
+    std::vector<int32_t> Range(const std::string& key,
+                               CotasQuery::Operator op,
+                               double operand) const;
+
+  private:
+    struct Property
+    {
+        std::set<std::pair<double, int32_t>> ordered; //!< (value, objectId)
+        std::unordered_map<int32_t, double> values;   //!< objectId -> value
+    };
+
+    std::vector<std::string> m_keys;                      //!< indexed properties
+    std::unordered_map<std::string, Property> m_properties; //!< key -> index
+};
+
+} // namespace ns3
+
+#endif /* COTAS_RANGE_INDEX_H */
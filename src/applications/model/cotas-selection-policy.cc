@@ -0,0 +1,168 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-selection-policy.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+bool
+CotasSelectionPolicy::FromString(const std::string& name, Type& type)
+{
+    static const std::vector<std::pair<std::string, Type>> nomes = {
+        {"first", FIRST},
+        {"round-robin", ROUND_ROBIN},
+        {"least-recent", LEAST_RECENT},
+        {"least-loaded", LEAST_LOADED},
+        {"ap-affinity", AP_AFFINITY}};
+    for (auto& par : nomes)
+    {
+        if (par.first == name)
+        {
+            type = par.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+CotasSelectionPolicy::CotasSelectionPolicy(uint8_t prefixLength)
+    : m_mask{prefixLength == 0 ? 0 : (prefixLength >= 32 ? 0xffffffff : ~(0xffffffffu >> prefixLength))}
+{
+}
+
+void
+CotasSelectionPolicy::Order(Type type,
+                            const std::string& key,
+                            uint32_t client,
+                            std::vector<Candidate>& candidates)
+{
+    if (candidates.size() < 2)
+    {
+        return;
+    }
+
+    // desempate sempre pela ordem do fuseki, para ser determinístico
+    auto carga = [this](const Candidate& a, const Candidate& b) {
+        uint32_t ca = Load(a.id);
+        uint32_t cb = Load(b.id);
+        return ca != cb ? ca < cb : a.index < b.index;
+    };
+
+    switch (type)
+    {
+    case FIRST:
+        break;
+    case ROUND_ROBIN: {
+        // a ordem do fuseki pode mudar entre consultas, então gira sobre os ids
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.id < b.id;
+        });
+        // perder os cursores só faz as rotações recomeçarem
+        if (m_cursor.size() >= MAX_CURSORS && !m_cursor.count(key))
+        {
+            m_cursor.clear();
+        }
+        size_t& cursor = m_cursor[key];
+        std::rotate(candidates.begin(),
+                    candidates.begin() + (cursor % candidates.size()),
+                    candidates.end());
+        cursor++;
+        break;
+    }
+    case LEAST_RECENT:
+        // quem nunca foi escolhido vem primeiro
+        std::stable_sort(candidates.begin(),
+                         candidates.end(),
+                         [this](const Candidate& a, const Candidate& b) {
+                             auto ia = m_lastAssigned.find(a.id);
+                             auto ib = m_lastAssigned.find(b.id);
+                             if (ia == m_lastAssigned.end() || ib == m_lastAssigned.end())
+                             {
+                                 return ia == m_lastAssigned.end() && ib != m_lastAssigned.end();
+                             }
+                             return ia->second < ib->second;
+                         });
+        break;
+    case LEAST_LOADED:
+        std::sort(candidates.begin(), candidates.end(), carga);
+        break;
+    case AP_AFFINITY: {
+        // objetos na mesma sub-rede (mesmo AP) do cliente primeiro
+        uint32_t rede = client & m_mask;
+        std::sort(candidates.begin(),
+                  candidates.end(),
+                  [&](const Candidate& a, const Candidate& b) {
+                      bool la = (a.ip & m_mask) == rede;
+                      bool lb = (b.ip & m_mask) == rede;
+                      return la != lb ? la : carga(a, b);
+                  });
+        break;
+    }
+    }
+}
+
+void
+CotasSelectionPolicy::Assign(uint32_t client, const std::string& key, int32_t id, double now)
+{
+    m_lastAssigned[id] = now;
+
+    // o cliente sai do objeto anterior para essa mesma consulta
+    auto [it, novo] = m_assignments.try_emplace({client, key}, Assignment{id, now});
+    if (!novo)
+    {
+        int32_t anterior = it->second.id;
+        it->second = {id, now};
+        if (anterior == id)
+        {
+            return;
+        }
+        auto carga = m_load.find(anterior);
+        if (carga != m_load.end() && carga->second > 0)
+        {
+            carga->second--;
+        }
+    }
+    m_load[id]++;
+    if (novo && m_assignments.size() > MAX_ASSIGNMENTS)
+    {
+        DropOldest();
+    }
+}
+
+void
+CotasSelectionPolicy::DropOldest()
+{
+    // só roda com o mapa cheio, uma vez por par novo
+    auto antigo = std::min_element(m_assignments.begin(),
+                                   m_assignments.end(),
+                                   [](const auto& a, const auto& b) {
+                                       return a.second.time < b.second.time;
+                                   });
+    auto carga = m_load.find(antigo->second.id);
+    if (carga != m_load.end() && --carga->second == 0)
+    {
+        m_load.erase(carga);
+    }
+    m_assignments.erase(antigo);
+}
+
+uint32_t
+CotasSelectionPolicy::Load(int32_t id) const
+{
+    auto it = m_load.find(id);
+    return it == m_load.end() ? 0 : it->second;
+}
+
+size_t
+CotasSelectionPolicy::Assignments() const
+{
+    return m_assignments.size();
+}
+
+} // namespace ns3
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_SELECTION_POLICY_H
+#define COTAS_SELECTION_POLICY_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Chooses which of the matching objects a consumer is sent to.
+ *
+ * CoTaS tracks which object each (client, query) pair was last sent to;
+ * the number of clients currently routed to an object is its load.
+ * Both the pairs and the round-robin cursors are keyed by the text of the
+ * query, so they are bounded: past MAX_ASSIGNMENTS the pair assigned
+ * longest ago is forgotten and stops counting in the load, and past
+ * MAX_CURSORS the rotations start over.
+ */
+class CotasSelectionPolicy
+{
+  public:
+    /// Available policies
+    enum Type
+    {
+        FIRST,        //!< first binding returned by the store
+        ROUND_ROBIN,  //!< rotates over the matches of the same query
+        LEAST_RECENT, //!< object assigned longest ago
+        LEAST_LOADED, //!< object with fewest clients routed to it
+        AP_AFFINITY   //!< least loaded among objects in the client subnet
+    };
+
+    static constexpr size_t MAX_ASSIGNMENTS{4096}; //!< (client, query) pairs tracked
+    static constexpr size_t MAX_CURSORS{1024};     //!< queries with a round-robin cursor
+
+    /// A matching object
+    struct Candidate
+    {
+        int32_t id;   //!< objectId
+        uint32_t ip;  //!< object IPv4 address
+        size_t index; //!< position in the store result
+    };
+
+    /**
+     * @brief Converts "first", "round-robin", "least-recent",
+     *        "least-loaded" or "ap-affinity" to a Type.
+     * @return false if the name is unknown
+     */
+    static bool FromString(const std::string& name, Type& type);
+
+    /**
+     * @param prefixLength bits of the address shared by clients
+     *        and objects under the same access point
+     */
+    explicit CotasSelectionPolicy(uint8_t prefixLength = 24);
+
+    /**
+     * @brief Sorts the candidates, best first.
+     * @param type policy to apply
+     * @param key canonical text of the query (round-robin cursor)
+     * @param client IPv4 address of the consumer
+     * @param candidates matches to sort
+     */
+    void Order(Type type, const std::string& key, uint32_t client, std::vector<Candidate>& candidates);
+
+    /**
+     * @brief Records that the client was sent to the object.
+     * @param now current time in seconds
+     */
+    void Assign(uint32_t client, const std::string& key, int32_t id, double now);
+
+    /**
+     * @brief Number of clients currently routed to the object.
+     */
+    uint32_t Load(int32_t id) const;
+
+    /**
+     * @brief Number of (client, query) pairs tracked.
+     */
+    size_t Assignments() const;
+
+  private:
+    /// Object a (client, query) pair was sent to
+    struct Assignment
+    {
+        int32_t id;  //!< objectId
+        double time; //!< when, in seconds
+    };
+
+    /// forgets the pair assigned longest ago and its share of the load
+    void DropOldest();
+
+    uint32_t m_mask;                                                       //!< subnet mask
+    std::map<std::pair<uint32_t, std::string>, Assignment> m_assignments;  //!< (client, query)
+    std::unordered_map<int32_t, uint32_t> m_load;                        //!< object -> clients
+    std::unordered_map<int32_t, double> m_lastAssigned;                  //!< object -> time
+    std::unordered_map<std::string, size_t> m_cursor;                    //!< query -> round-robin
+};
+
+} // namespace ns3
+
+#endif /* COTAS_SELECTION_POLICY_H */
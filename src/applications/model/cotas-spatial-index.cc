@@ -0,0 +1,216 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-spatial-index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+
+CotasSpatialIndex::CotasSpatialIndex(double cellSize)
+    : m_cellSize{cellSize > 0 ? cellSize : 1.0}
+{
+}
+
+void
+CotasSpatialIndex::Update(int32_t id, double x, double y)
+{
+    int64_t cell = Cell(Coord(x), Coord(y));
+    auto it = m_positions.find(id);
+    if (it != m_positions.end())
+    {
+        if (it->second.cell != cell)
+        {
+            // mudou de célula, tira da antiga
+            auto& antiga = m_cells[it->second.cell];
+            antiga.erase(std::remove(antiga.begin(), antiga.end(), id), antiga.end());
+            if (antiga.empty())
+            {
+                m_cells.erase(it->second.cell);
+            }
+            m_cells[cell].push_back(id);
+        }
+        it->second = {x, y, cell};
+        return;
+    }
+    m_positions[id] = {x, y, cell};
+    m_cells[cell].push_back(id);
+}
+
+void
+CotasSpatialIndex::Remove(int32_t id)
+{
+    auto it = m_positions.find(id);
+    if (it == m_positions.end())
+    {
+        return;
+    }
+    auto& celula = m_cells[it->second.cell];
+    celula.erase(std::remove(celula.begin(), celula.end(), id), celula.end());
+    if (celula.empty())
+    {
+        m_cells.erase(it->second.cell);
+    }
+    m_positions.erase(it);
+}
+
+bool
+CotasSpatialIndex::Get(int32_t id, double& x, double& y) const
+{
+    auto it = m_positions.find(id);
+    if (it == m_positions.end())
+    {
+        return false;
+    }
+    x = it->second.x;
+    y = it->second.y;
+    return true;
+}
+
+CotasSpatialIndex::Result
+CotasSpatialIndex::Radius(double x, double y, double radius) const
+{
+    Result resultado;
+    Collect(Coord(x - radius), Coord(y - radius), Coord(x + radius), Coord(y + radius), x, y,
+            resultado);
+
+    // as células da borda trazem pontos de fora do círculo
+    resultado.erase(std::remove_if(resultado.begin(),
+                                   resultado.end(),
+                                   [radius](const std::pair<int32_t, double>& r) {
+                                       return r.second > radius;
+                                   }),
+                    resultado.end());
+    std::sort(resultado.begin(), resultado.end(), [](const auto& a, const auto& b) {
+        return a.second < b.second;
+    });
+    return resultado;
+}
+
+CotasSpatialIndex::Result
+CotasSpatialIndex::Nearest(double x, double y, size_t k) const
+{
+    Result resultado;
+    if (k == 0 || m_positions.empty())
+    {
+        return resultado;
+    }
+    k = std::min(k, m_positions.size());
+
+    // expande anéis de células em volta do ponto; depois do anel r
+    // qualquer ponto não visitado está a mais de r * cellSize
+    int32_t cx = Coord(x);
+    int32_t cy = Coord(y);
+    for (int32_t r = 0;; r++)
+    {
+        resultado.clear();
+        Collect(cx - r, cy - r, cx + r, cy + r, x, y, resultado);
+        if (resultado.size() >= k)
+        {
+            std::sort(resultado.begin(), resultado.end(), [](const auto& a, const auto& b) {
+                return a.second < b.second;
+            });
+            if (resultado[k - 1].second <= r * m_cellSize || resultado.size() == m_positions.size())
+            {
+                resultado.resize(k);
+                return resultado;
+            }
+        }
+    }
+}
+
+CotasSpatialIndex::Result
+CotasSpatialIndex::Box(double minX, double minY, double maxX, double maxY, double x, double y)
+    const
+{
+    Result resultado;
+    Collect(Coord(minX), Coord(minY), Coord(maxX), Coord(maxY), x, y, resultado);
+
+    resultado.erase(std::remove_if(resultado.begin(),
+                                   resultado.end(),
+                                   [&](const std::pair<int32_t, double>& r) {
+                                       const Position& p = m_positions.at(r.first);
+                                       return p.x < minX || p.x > maxX || p.y < minY ||
+                                              p.y > maxY;
+                                   }),
+                    resultado.end());
+    std::sort(resultado.begin(), resultado.end(), [](const auto& a, const auto& b) {
+        return a.second < b.second;
+    });
+    return resultado;
+}
+
+size_t
+CotasSpatialIndex::Size() const
+{
+    return m_positions.size();
+}
+
+int64_t
+CotasSpatialIndex::Cell(int32_t cx, int32_t cy) const
+{
+    return (static_cast<int64_t>(cx) << 32) | static_cast<uint32_t>(cy);
+}
+
+int32_t
+CotasSpatialIndex::Coord(double v) const
+{
+    return static_cast<int32_t>(std::floor(v / m_cellSize));
+}
+
+void
+CotasSpatialIndex::Collect(int32_t cx0,
+                           int32_t cy0,
+                           int32_t cx1,
+                           int32_t cy1,
+                           double x,
+                           double y,
+                           Result& out) const
+{
+    // se a janela tem mais células que o índice, é mais barato
+    // andar pelas células ocupadas
+    int64_t janela = static_cast<int64_t>(cx1 - cx0 + 1) * (cy1 - cy0 + 1);
+    if (janela > static_cast<int64_t>(m_cells.size()))
+    {
+        for (auto& [cell, ids] : m_cells)
+        {
+            int32_t ccx = static_cast<int32_t>(cell >> 32);
+            int32_t ccy = static_cast<int32_t>(static_cast<uint32_t>(cell));
+            if (ccx < cx0 || ccx > cx1 || ccy < cy0 || ccy > cy1)
+            {
+                continue;
+            }
+            for (int32_t id : ids)
+            {
+                const Position& p = m_positions.at(id);
+                out.emplace_back(id, std::hypot(p.x - x, p.y - y));
+            }
+        }
+        return;
+    }
+
+    for (int32_t i = cx0; i <= cx1; i++)
+    {
+        for (int32_t j = cy0; j <= cy1; j++)
+        {
+            auto it = m_cells.find(Cell(i, j));
+            if (it == m_cells.end())
+            {
+                continue;
+            }
+            for (int32_t id : it->second)
+            {
+                const Position& p = m_positions.at(id);
+                out.emplace_back(id, std::hypot(p.x - x, p.y - y));
+            }
+        }
+    }
+}
+
+} // namespace ns3
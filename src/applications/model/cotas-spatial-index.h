@@ -0,0 +1,100 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_SPATIAL_INDEX_H
+#define COTAS_SPATIAL_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Uniform grid over the device positions known by CoTaS.
+ *
+ * Positions come from cot:localization (longitude is x, latitude is y)
+ * and are kept in the same unit the devices report. Every query returns
+ * (objectId, distance) pairs sorted by distance to the reference point.
+ */
+class CotasSpatialIndex
+{
+  public:
+    using Result = std::vector<std::pair<int32_t, double>>; //!< (objectId, distance)
+
+    /**
+     * @param cellSize side of each grid cell
+     */
+    explicit CotasSpatialIndex(double cellSize = 2.0);
+
+    /**
+     * @brief Inserts the device or moves it to a new position.
+     */
+    void Update(int32_t id, double x, double y);
+
+    /**
+     * @brief Removes the device from the index.
+     */
+    void Remove(int32_t id);
+
+    /**
+     * @brief Gets the last known position of a device.
+     * @return false if the device never reported its position
+     */
+    bool Get(int32_t id, double& x, double& y) const;
+
+    /**
+     * @brief Devices at most radius away from (x, y).
+     */
+    Result Radius(double x, double y, double radius) const;
+
+    /**
+     * @brief The k devices closest to (x, y).
+     */
+    Result Nearest(double x, double y, size_t k) const;
+
+    /**
+     * @brief Devices inside the box, sorted by distance to (x, y).
+     */
+    Result Box(double minX, double minY, double maxX, double maxY, double x, double y) const;
+
+    /**
+     * @brief Number of devices with a known position.
+     */
+    size_t Size() const;
+
+  private:
+    struct Position
+    {
+        double x;
+        double y;
+        int64_t cell;
+    };
+
+    int64_t Cell(int32_t cx, int32_t cy) const;
+    int32_t Coord(double v) const;
+
+    /// visits the devices of the cells in [cx0, cx1] x [cy0, cy1]
+    void Collect(int32_t cx0,
+                 int32_t cy0,
+                 int32_t cx1,
+                 int32_t cy1,
+                 double x,
+                 double y,
+                 Result& out) const;
+
+    double m_cellSize;
+    std::unordered_map<int64_t, std::vector<int32_t>> m_cells; //!< cell -> devices
+    std::unordered_map<int32_t, Position> m_positions;          //!< device -> position
+};
+
+} // namespace ns3
+
+#endif /* COTAS_SPATIAL_INDEX_H */
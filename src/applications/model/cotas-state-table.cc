@@ -0,0 +1,177 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-state-table.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+
+bool
+CotasStateTable::Contains(int32_t id) const
+{
+    return m_rows.count(id) > 0;
+}
+
+void
+CotasStateTable::Insert(int32_t id)
+{
+    if (!m_rows.try_emplace(id, m_ids.size()).second)
+    {
+        return;
+    }
+    m_ids.push_back(id);
+    for (auto& coluna : m_columns)
+    {
+        coluna.values.push_back(0);
+        coluna.present.push_back(0);
+        coluna.dirty.push_back(0);
+        coluna.updated.push_back(0);
+    }
+}
+
+void
+CotasStateTable::Set(int32_t id, const std::string& key, double value, double time)
+{
+    Write(id, key, value, time, true);
+}
+
+void
+CotasStateTable::Load(int32_t id, const std::string& key, double value, double time)
+{
+    Write(id, key, value, time, false);
+}
+
+bool
+CotasStateTable::Get(int32_t id, const std::string& key, double& value) const
+{
+    double instante;
+    return Get(id, key, value, instante);
+}
+
+bool
+CotasStateTable::Get(int32_t id, const std::string& key, double& value, double& time) const
+{
+    auto linha = m_rows.find(id);
+    auto coluna = m_columnId.find(key);
+    if (linha == m_rows.end() || coluna == m_columnId.end())
+    {
+        return false;
+    }
+    const Column& c = m_columns[coluna->second];
+    if (!c.present[linha->second])
+    {
+        return false;
+    }
+    value = c.values[linha->second];
+    time = c.updated[linha->second];
+    return true;
+}
+
+bool
+CotasStateTable::Matches(int32_t id, const std::string& key, double value) const
+{
+    double atual;
+    return Get(id, key, atual) && atual == value;
+}
+
+nlohmann::json
+CotasStateTable::Project(int32_t id, const std::vector<std::string>& keys) const
+{
+    nlohmann::json contexto = nlohmann::json::object();
+    for (auto& chave : keys)
+    {
+        double valor;
+        double instante;
+        if (Get(id, chave, valor, instante))
+        {
+            contexto[chave] = {{"value", ToJson(valor)}, {"time", instante}};
+        }
+    }
+    return contexto;
+}
+
+CotasStateTable::Batch
+CotasStateTable::TakeDirty()
+{
+    Batch lote;
+    // agrupa por linha para cada dispositivo virar uma atualização só
+    std::sort(m_dirty.begin(), m_dirty.end());
+    for (auto& [linha, coluna] : m_dirty)
+    {
+        Column& c = m_columns[coluna];
+        if (!c.dirty[linha])
+        {
+            continue;
+        }
+        c.dirty[linha] = 0;
+
+        int32_t id = m_ids[linha];
+        if (lote.empty() || lote.back().first != id)
+        {
+            lote.emplace_back(id, nlohmann::json{{"objectId", id}});
+        }
+        lote.back().second[m_keys[coluna]] = ToJson(c.values[linha]);
+    }
+    m_dirty.clear();
+    return lote;
+}
+
+size_t
+CotasStateTable::Size() const
+{
+    return m_ids.size();
+}
+
+nlohmann::json
+CotasStateTable::ToJson(double value)
+{
+    // inteiros voltam como inteiros para o literal não mudar de tipo
+    if (std::trunc(value) == value && std::fabs(value) < 9007199254740992.0)
+    {
+        return static_cast<int64_t>(value);
+    }
+    return value;
+}
+
+CotasStateTable::Column&
+CotasStateTable::GetColumn(const std::string& key)
+{
+    auto [it, nova] = m_columnId.try_emplace(key, m_columns.size());
+    if (nova)
+    {
+        m_keys.push_back(key);
+        m_columns.push_back({std::vector<double>(m_ids.size(), 0),
+                             std::vector<uint8_t>(m_ids.size(), 0),
+                             std::vector<uint8_t>(m_ids.size(), 0),
+                             std::vector<double>(m_ids.size(), 0)});
+    }
+    return m_columns[it->second];
+}
+
+void
+CotasStateTable::Write(int32_t id,
+                       const std::string& key,
+                       double value,
+                       double time,
+                       bool dirty)
+{
+    Insert(id);
+    uint32_t linha = m_rows[id];
+    Column& c = GetColumn(key);
+    c.values[linha] = value;
+    c.present[linha] = 1;
+    c.updated[linha] = time;
+    if (dirty && !c.dirty[linha])
+    {
+        c.dirty[linha] = 1;
+        m_dirty.emplace_back(linha, m_columnId[key]);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_STATE_TABLE_H
+#define COTAS_STATE_TABLE_H
+
+#include "json.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief In-memory columnar table with the current numeric context values.
+ *
+ * Each device is a row (dense, in subscription order) and each update key
+ * is a column, so a scan such as "turnedOn == 1" walks one contiguous
+ * vector. Values written with Set are kept dirty until TakeDirty hands
+ * them to be flushed to the store.
+ */
+class CotasStateTable
+{
+  public:
+    /// (objectId, update payload with the dirty keys)
+    using Batch = std::vector<std::pair<int32_t, nlohmann::json>>;
+
+    /**
+     * @brief Checks if the device has a row.
+     */
+    bool Contains(int32_t id) const;
+
+    /**
+     * @brief Adds a row for the device, if it has none.
+     */
+    void Insert(int32_t id);
+
+    /**
+     * @brief Writes a value that still has to reach the store.
+     * @param time when the provider reported the value, in seconds
+     */
+    void Set(int32_t id, const std::string& key, double value, double time = 0);
+
+    /**
+     * @brief Writes a value the store already has.
+     * @param time when the provider reported the value, in seconds
+     */
+    void Load(int32_t id, const std::string& key, double value, double time = 0);
+
+    /**
+     * @brief Reads the current value.
+     * @return false if the device or the value is unknown
+     */
+    bool Get(int32_t id, const std::string& key, double& value) const;
+
+    /**
+     * @brief Reads the current value and when it was reported.
+     * @return false if the device or the value is unknown
+     */
+    bool Get(int32_t id, const std::string& key, double& value, double& time) const;
+
+    /**
+     * @brief Checks if the device has key == value.
+     */
+    bool Matches(int32_t id, const std::string& key, double value) const;
+
+    /**
+     * @brief Current values of some keys of a device.
+     * @return {key: {"value": v, "time": t}}, without the unknown keys
+     */
+    nlohmann::json Project(int32_t id, const std::vector<std::string>& keys) const;
+
+    /**
+     * @brief Returns the dirty values grouped by device and clears them.
+     */
+    Batch TakeDirty();
+
+    /**
+     * @brief Number of rows.
+     */
+    size_t Size() const;
+
+  private:
+    struct Column
+    {
+        std::vector<double> values;   //!< value per row
+        std::vector<uint8_t> present; //!< row has a value
+        std::vector<uint8_t> dirty;   //!< row value not flushed yet
+        std::vector<double> updated;  //!< row value report time, in seconds
+    };
+
+    /// integral values become JSON integers, so literals keep their type
+    static nlohmann::json ToJson(double value);
+
+    Column& GetColumn(const std::string& key);
+    void Write(int32_t id, const std::string& key, double value, double time, bool dirty);
+
+    std::unordered_map<int32_t, uint32_t> m_rows;       //!< objectId -> row
+    std::vector<int32_t> m_ids;                         //!< row -> objectId
+    std::unordered_map<std::string, size_t> m_columnId; //!< key -> column
+    std::vector<std::string> m_keys;                    //!< column -> key
+    std::vector<Column> m_columns;                      //!< columns
+    std::vector<std::pair<uint32_t, size_t>> m_dirty;   //!< (row, column) to flush
+};
+
+} // namespace ns3
+
+#endif /* COTAS_STATE_TABLE_H */
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-store-pool.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+
+CotasStorePool::~CotasStorePool()
+{
+    Stop();
+}
+
+void
+CotasStorePool::Start(const std::string& host, uint16_t port, uint32_t threads)
+{
+    m_stopping = false;
+    for (uint32_t i = 0; i < std::max(threads, 1u); i++)
+    {
+        auto cliente = std::make_unique<httplib::Client>(host, port);
+        // a resposta é descomprimida no CoTaS::StoreSend, que mede os dois tamanhos
+        cliente->set_decompress(false);
+        m_clients.push_back(std::move(cliente));
+    }
+    for (auto& cliente : m_clients)
+    {
+        m_threads.emplace_back(&CotasStorePool::Loop, this, std::ref(*cliente));
+    }
+}
+
+void
+CotasStorePool::Submit(Job job)
+{
+    {
+        std::lock_guard<std::mutex> trava(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_ready.notify_one();
+}
+
+void
+CotasStorePool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> trava(m_mutex);
+        m_stopping = true;
+    }
+    m_ready.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+    m_threads.clear();
+    m_clients.clear();
+}
+
+bool
+CotasStorePool::Running() const
+{
+    return !m_threads.empty();
+}
+
+void
+CotasStorePool::Loop(httplib::Client& client)
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> trava(m_mutex);
+            m_ready.wait(trava, [this] { return m_stopping || !m_jobs.empty(); });
+            // com Stop a fila ainda é esvaziada: quem submeteu espera a resposta
+            if (m_jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job(client);
+    }
+}
+
+} // namespace ns3
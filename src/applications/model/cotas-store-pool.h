@@ -0,0 +1,82 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_STORE_POOL_H
+#define COTAS_STORE_POOL_H
+
+#include "httplib.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Threads that run blocking store calls off the simulator thread.
+ *
+ * Each thread owns an HTTP client to the store, since one client sends a
+ * request at a time. A job gets the client of the thread running it; what
+ * it touches besides the client must be safe to use from that thread.
+ */
+class CotasStorePool
+{
+  public:
+    /// Store call, given the client of the thread that runs it
+    using Job = std::function<void(httplib::Client&)>;
+
+    CotasStorePool() = default;
+    ~CotasStorePool();
+
+    CotasStorePool(const CotasStorePool&) = delete;
+    CotasStorePool& operator=(const CotasStorePool&) = delete;
+
+    /**
+     * @brief Starts the threads.
+     * @param host store host
+     * @param port store port
+     * @param threads store calls running at once
+     */
+    void Start(const std::string& host, uint16_t port, uint32_t threads);
+
+    /**
+     * @brief Queues a job for the next free thread.
+     */
+    void Submit(Job job);
+
+    /**
+     * @brief Runs the jobs still queued and joins the threads.
+     */
+    void Stop();
+
+    /**
+     * @brief Checks if the threads are running.
+     */
+    bool Running() const;
+
+  private:
+    /// thread body: takes jobs until Stop
+    void Loop(httplib::Client& client);
+
+    std::vector<std::thread> m_threads;                       //!< running the jobs
+    std::vector<std::unique_ptr<httplib::Client>> m_clients;  //!< one per thread
+    std::deque<Job> m_jobs;                                   //!< waiting for a thread
+    std::mutex m_mutex;                                       //!< guards m_jobs, m_stopping
+    std::condition_variable m_ready;                          //!< a job or Stop arrived
+    bool m_stopping{false};                                   //!< Stop was called
+};
+
+} // namespace ns3
+
+#endif /* COTAS_STORE_POOL_H */
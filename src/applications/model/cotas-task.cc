@@ -0,0 +1,110 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-task.h"
+
+namespace ns3
+{
+
+CotasTask
+CotasTask::promise_type::get_return_object()
+{
+    return CotasTask(state);
+}
+
+void
+CotasTask::promise_type::return_value(nlohmann::json value)
+{
+    state->result = std::move(value);
+}
+
+void
+CotasTask::promise_type::unhandled_exception()
+{
+    // segue para quem espera a tarefa; o servidor continua atendendo
+    state->error = std::current_exception();
+}
+
+CotasTask::CotasTask(std::shared_ptr<State> state)
+    : m_state(std::move(state))
+{
+}
+
+CotasTask
+CotasTask::Ready(nlohmann::json value)
+{
+    auto estado = std::make_shared<State>();
+    estado->done = true;
+    estado->result = std::move(value);
+    return CotasTask(estado);
+}
+
+CotasTask
+CotasTask::Failed(std::exception_ptr error)
+{
+    auto estado = std::make_shared<State>();
+    estado->done = true;
+    estado->error = std::move(error);
+    return CotasTask(estado);
+}
+
+void
+CotasTask::Then(Callback callback)
+{
+    if (m_state->done)
+    {
+        callback(std::move(m_state->result), m_state->error);
+        return;
+    }
+    m_state->then = std::move(callback);
+}
+
+bool
+CotasTask::IsDone() const
+{
+    return m_state->done;
+}
+
+bool
+CotasTask::await_ready() const noexcept
+{
+    return m_state->done;
+}
+
+void
+CotasTask::await_suspend(std::coroutine_handle<> handle)
+{
+    m_state->continuation = handle;
+}
+
+nlohmann::json
+CotasTask::await_resume()
+{
+    if (m_state->error)
+    {
+        std::rethrow_exception(m_state->error);
+    }
+    return std::move(m_state->result);
+}
+
+std::coroutine_handle<>
+CotasTask::Finish(const std::shared_ptr<State>& state)
+{
+    state->done = true;
+    if (state->continuation)
+    {
+        // quem esperava continua direto, sem passar pelo simulador
+        return state->continuation;
+    }
+    if (state->then)
+    {
+        auto callback = std::move(state->then);
+        callback(std::move(state->result), state->error);
+    }
+    return std::noop_coroutine();
+}
+
+} // namespace ns3
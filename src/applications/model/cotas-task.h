@@ -0,0 +1,124 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_TASK_H
+#define COTAS_TASK_H
+
+#include "json.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Response of a CoTaS handler written as a C++20 coroutine.
+ *
+ * The handler starts at once and runs until it co_awaits a store step;
+ * a simulator event resumes it when the step is over, so other requests
+ * are handled meanwhile. Then registers what to do with the response.
+ * A handler may also co_await another CotasTask. An exception that
+ * escapes the handler ends the task: it is rethrown in the coroutine
+ * awaiting it, or handed to the Then callback.
+ */
+class CotasTask
+{
+  public:
+    /// Called with the response, or with the exception that ended the handler
+    using Callback = std::function<void(nlohmann::json, std::exception_ptr)>;
+
+    /// Shared by the coroutine and the task, which may outlive each other
+    struct State
+    {
+        bool done{false};                             //!< result is set
+        nlohmann::json result;                        //!< handler response
+        std::exception_ptr error;                     //!< exception that ended the handler
+        Callback then;                                //!< completion callback
+        std::coroutine_handle<> continuation;         //!< coroutine awaiting this one
+    };
+
+    /// Hands the result over and frees the coroutine frame
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::shared_ptr<State> estado = handle.promise().state;
+            handle.destroy();
+            return Finish(estado);
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    /// Coroutine promise
+    struct promise_type
+    {
+        std::shared_ptr<State> state{std::make_shared<State>()}; //!< shared state
+
+        CotasTask get_return_object();
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_value(nlohmann::json value);
+        void unhandled_exception();
+    };
+
+    /**
+     * @brief Task that is already done.
+     */
+    static CotasTask Ready(nlohmann::json value);
+
+    /**
+     * @brief Task that already ended with an exception.
+     */
+    static CotasTask Failed(std::exception_ptr error);
+
+    /**
+     * @brief Calls back with the response; at once if it is done.
+     */
+    void Then(Callback callback);
+
+    /**
+     * @brief Checks if the handler finished.
+     */
+    bool IsDone() const;
+
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> handle);
+    nlohmann::json await_resume();
+
+  private:
+    explicit CotasTask(std::shared_ptr<State> state);
+
+    /// marks the state done and picks who runs next
+    static std::coroutine_handle<> Finish(const std::shared_ptr<State>& state);
+
+    std::shared_ptr<State> m_state; //!< shared with the coroutine
+};
+
+} // namespace ns3
+
+#endif /* COTAS_TASK_H */
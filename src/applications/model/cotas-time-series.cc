@@ -0,0 +1,322 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-time-series.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace ns3
+{
+
+namespace
+{
+
+uint64_t
+ToBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double
+FromBits(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// Reads a bit stream written by CotasTimeSeries::Write
+class BitReader
+{
+  public:
+    explicit BitReader(const std::vector<uint64_t>& words)
+        : m_words(words)
+    {
+    }
+
+    uint64_t Read(uint8_t size)
+    {
+        uint64_t palavra = m_pos / 64;
+        uint8_t livre = 64 - m_pos % 64;
+        uint64_t bits;
+        if (size <= livre)
+        {
+            bits = m_words[palavra] >> (livre - size);
+        }
+        else
+        {
+            // metade numa palavra, metade na outra
+            uint8_t resto = size - livre;
+            bits = (m_words[palavra] << resto) | (m_words[palavra + 1] >> (64 - resto));
+        }
+        m_pos += size;
+        return size == 64 ? bits : bits & ((uint64_t{1} << size) - 1);
+    }
+
+  private:
+    const std::vector<uint64_t>& m_words;
+    uint64_t m_pos{0};
+};
+
+/// Prefix, payload size and offset of each delta-of-delta range
+struct DodRange
+{
+    uint8_t prefix;     //!< control bits
+    uint8_t prefixSize; //!< number of control bits
+    uint8_t size;       //!< payload bits
+    int64_t offset;     //!< added to make the payload unsigned
+};
+
+constexpr DodRange DOD_RANGES[] = {{0b10, 2, 7, 63}, {0b110, 3, 9, 255}, {0b1110, 4, 12, 2047}};
+
+} // namespace
+
+bool
+CotasTimeSeries::Append(int64_t time, double value)
+{
+    if (!m_blocks.empty() && time < m_blocks.back().last)
+    {
+        return false;
+    }
+    if (m_blocks.empty() || m_blocks.back().count >= MAX_BLOCK_SAMPLES)
+    {
+        m_blocks.emplace_back();
+    }
+    Encode(m_blocks.back(), time, value);
+    return true;
+}
+
+std::vector<CotasTimeSeries::Sample>
+CotasTimeSeries::Range(int64_t from, int64_t to) const
+{
+    std::vector<Sample> amostras;
+    for (auto& bloco : m_blocks)
+    {
+        if (bloco.last < from || bloco.first > to)
+        {
+            continue;
+        }
+        std::vector<Sample> todas;
+        Decode(bloco, todas);
+        for (auto& amostra : todas)
+        {
+            if (amostra.first >= from && amostra.first <= to)
+            {
+                amostras.push_back(amostra);
+            }
+        }
+    }
+    return amostras;
+}
+
+std::vector<CotasTimeSeries::Bucket>
+CotasTimeSeries::Rollup(int64_t from, int64_t to, int64_t step) const
+{
+    std::vector<Bucket> intervalos;
+    for (auto& [instante, valor] : Range(from, to))
+    {
+        int64_t inicio = from + (instante - from) / step * step;
+        if (intervalos.empty() || intervalos.back().start != inicio)
+        {
+            intervalos.push_back({inicio, 0, valor, valor, 0});
+        }
+        Bucket& b = intervalos.back();
+        b.count++;
+        b.min = std::min(b.min, valor);
+        b.max = std::max(b.max, valor);
+        b.sum += valor;
+    }
+    return intervalos;
+}
+
+void
+CotasTimeSeries::Trim(int64_t time)
+{
+    auto fim = std::find_if(m_blocks.begin(), m_blocks.end(), [time](const Block& bloco) {
+        return bloco.last >= time;
+    });
+    m_blocks.erase(m_blocks.begin(), fim);
+}
+
+uint64_t
+CotasTimeSeries::Size() const
+{
+    uint64_t total = 0;
+    for (auto& bloco : m_blocks)
+    {
+        total += bloco.count;
+    }
+    return total;
+}
+
+uint64_t
+CotasTimeSeries::Bytes() const
+{
+    uint64_t total = 0;
+    for (auto& bloco : m_blocks)
+    {
+        total += bloco.words.size() * sizeof(uint64_t);
+    }
+    return total;
+}
+
+void
+CotasTimeSeries::Write(Block& block, uint64_t bits, uint8_t size)
+{
+    if (size < 64)
+    {
+        bits &= (uint64_t{1} << size) - 1;
+    }
+    uint64_t palavra = block.bits / 64;
+    uint8_t livre = 64 - block.bits % 64;
+    if (palavra == block.words.size())
+    {
+        block.words.push_back(0);
+    }
+    if (size <= livre)
+    {
+        block.words[palavra] |= bits << (livre - size);
+    }
+    else
+    {
+        uint8_t resto = size - livre;
+        block.words[palavra] |= bits >> resto;
+        block.words.push_back(bits << (64 - resto));
+    }
+    block.bits += size;
+}
+
+void
+CotasTimeSeries::Encode(Block& block, int64_t time, double value)
+{
+    uint64_t bits = ToBits(value);
+    if (block.count == 0)
+    {
+        // a primeira amostra vai inteira
+        Write(block, static_cast<uint64_t>(time), 64);
+        Write(block, bits, 64);
+        block.first = time;
+    }
+    else
+    {
+        // tempo: diferença entre os dois últimos intervalos
+        int64_t delta = time - block.last;
+        int64_t dod = delta - block.delta;
+        block.delta = delta;
+        if (dod == 0)
+        {
+            Write(block, 0, 1);
+        }
+        else
+        {
+            bool escrito = false;
+            for (auto& faixa : DOD_RANGES)
+            {
+                if (dod >= -faixa.offset && dod <= faixa.offset + 1)
+                {
+                    Write(block, faixa.prefix, faixa.prefixSize);
+                    Write(block, static_cast<uint64_t>(dod + faixa.offset), faixa.size);
+                    escrito = true;
+                    break;
+                }
+            }
+            if (!escrito)
+            {
+                Write(block, 0b1111, 4);
+                Write(block, static_cast<uint64_t>(dod), 64);
+            }
+        }
+
+        // valor: XOR com o anterior, só os bits que mudaram
+        uint64_t x = bits ^ block.value;
+        if (x == 0)
+        {
+            Write(block, 0, 1);
+        }
+        else
+        {
+            uint8_t zerosEsquerda = std::min(std::countl_zero(x), 31);
+            uint8_t zerosDireita = std::countr_zero(x);
+            if (block.leading != 0xff && zerosEsquerda >= block.leading &&
+                zerosDireita >= block.trailing)
+            {
+                // cabe na janela do XOR anterior
+                Write(block, 0b10, 2);
+                Write(block, x >> block.trailing, 64 - block.leading - block.trailing);
+            }
+            else
+            {
+                uint8_t tamanho = 64 - zerosEsquerda - zerosDireita;
+                Write(block, 0b11, 2);
+                Write(block, zerosEsquerda, 5);
+                Write(block, tamanho == 64 ? 0 : tamanho, 6);
+                Write(block, x >> zerosDireita, tamanho);
+                block.leading = zerosEsquerda;
+                block.trailing = zerosDireita;
+            }
+        }
+    }
+    block.last = time;
+    block.value = bits;
+    block.count++;
+}
+
+void
+CotasTimeSeries::Decode(const Block& block, std::vector<Sample>& samples)
+{
+    if (block.count == 0)
+    {
+        return;
+    }
+    BitReader leitor(block.words);
+    int64_t instante = static_cast<int64_t>(leitor.Read(64));
+    uint64_t valor = leitor.Read(64);
+    int64_t delta = 0;
+    uint8_t zerosEsquerda = 0;
+    uint8_t zerosDireita = 0;
+    samples.emplace_back(instante, FromBits(valor));
+
+    for (uint32_t i = 1; i < block.count; i++)
+    {
+        // conta os 1 do prefixo, no máximo 4
+        uint8_t prefixo = 0;
+        while (prefixo < 4 && leitor.Read(1))
+        {
+            prefixo++;
+        }
+        int64_t dod = 0;
+        if (prefixo == 4)
+        {
+            dod = static_cast<int64_t>(leitor.Read(64));
+        }
+        else if (prefixo > 0)
+        {
+            const DodRange& faixa = DOD_RANGES[prefixo - 1];
+            dod = static_cast<int64_t>(leitor.Read(faixa.size)) - faixa.offset;
+        }
+        delta += dod;
+        instante += delta;
+
+        if (leitor.Read(1))
+        {
+            if (leitor.Read(1))
+            {
+                zerosEsquerda = leitor.Read(5);
+                uint8_t tamanho = leitor.Read(6);
+                tamanho = tamanho == 0 ? 64 : tamanho;
+                zerosDireita = 64 - zerosEsquerda - tamanho;
+            }
+            valor ^= leitor.Read(64 - zerosEsquerda - zerosDireita) << zerosDireita;
+        }
+        samples.emplace_back(instante, FromBits(valor));
+    }
+}
+
+} // namespace ns3
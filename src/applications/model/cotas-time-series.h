@@ -0,0 +1,101 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_TIME_SERIES_H
+#define COTAS_TIME_SERIES_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Compressed history of one numeric context property of a device.
+ *
+ * Samples are packed as in Facebook's Gorilla: timestamps as
+ * delta-of-delta and values as the XOR with the previous one, so a
+ * periodic sensor with slowly changing readings costs one or two bytes
+ * per sample. The series is split in blocks of at most MAX_BLOCK_SAMPLES,
+ * which lets range reads skip whole blocks and old blocks be dropped.
+ */
+class CotasTimeSeries
+{
+  public:
+    /// (time in milliseconds, value)
+    using Sample = std::pair<int64_t, double>;
+
+    /// Aggregate of the samples of one rollup interval
+    struct Bucket
+    {
+        int64_t start; //!< first millisecond of the interval
+        uint32_t count; //!< number of samples
+        double min;     //!< smallest value
+        double max;     //!< largest value
+        double sum;     //!< sum of the values
+    };
+
+    static constexpr uint32_t MAX_BLOCK_SAMPLES{512}; //!< samples per block
+
+    /**
+     * @brief Appends a sample.
+     * @return false if it is older than the last sample
+     */
+    bool Append(int64_t time, double value);
+
+    /**
+     * @brief Samples with from <= time <= to, in time order.
+     */
+    std::vector<Sample> Range(int64_t from, int64_t to) const;
+
+    /**
+     * @brief Downsamples [from, to] in intervals of step milliseconds.
+     * @return the intervals that have samples, in time order
+     */
+    std::vector<Bucket> Rollup(int64_t from, int64_t to, int64_t step) const;
+
+    /**
+     * @brief Drops the blocks whose samples are all older than time.
+     */
+    void Trim(int64_t time);
+
+    /**
+     * @brief Number of samples kept.
+     */
+    uint64_t Size() const;
+
+    /**
+     * @brief Bytes used by the compressed samples.
+     */
+    uint64_t Bytes() const;
+
+  private:
+    /// Bits of up to MAX_BLOCK_SAMPLES samples
+    struct Block
+    {
+        std::vector<uint64_t> words; //!< bit stream, most significant bit first
+        uint64_t bits{0};            //!< bits written
+        uint32_t count{0};           //!< samples written
+        int64_t first{0};            //!< time of the first sample
+        int64_t last{0};             //!< time of the last sample
+        int64_t delta{0};            //!< last time delta
+        uint64_t value{0};           //!< last value, as bits
+        uint8_t leading{0xff};       //!< leading zeros of the last stored XOR
+        uint8_t trailing{0};         //!< trailing zeros of the last stored XOR
+    };
+
+    static void Write(Block& block, uint64_t bits, uint8_t size);
+    static void Encode(Block& block, int64_t time, double value);
+    static void Decode(const Block& block, std::vector<Sample>& samples);
+
+    std::vector<Block> m_blocks; //!< blocks in time order
+};
+
+} // namespace ns3
+
+#endif /* COTAS_TIME_SERIES_H */
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_TRANSPORT_H
+#define COTAS_TRANSPORT_H
+
+#include "ns3/address.h"
+#include "ns3/nstime.h"
+
+#include <memory>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * @ingroup cotas
+ * @brief Moves the CoAP datagrams of a CoTaS.
+ *
+ * The CoTaS core parses requests, runs the handlers and builds replies;
+ * it hands every datagram it sends to a transport. The ns-3 application
+ * is one transport, over the simulated sockets; CotasUdpDaemon is
+ * another, over a Linux UDP socket.
+ */
+class CotasTransport
+{
+  public:
+    /// Request as the transport received it
+    struct Request
+    {
+        Address from;                     //!< client address
+        std::shared_ptr<const void> link; //!< transport data the reply needs, may be null
+    };
+
+    virtual ~CotasTransport() = default;
+
+    /**
+     * @brief Sends the reply to a request.
+     * @param delay time the reply still waits, modelled processing time
+     *        of a simulation; zero outside one
+     */
+    virtual void Reply(const Request& request, const std::string& datagram, Time delay) = 0;
+
+    /**
+     * @brief Sends a datagram that is not a reply, such as a digest.
+     */
+    virtual void Send(const Address& to, const std::string& datagram) = 0;
+
+    /**
+     * @brief Checks if time passes for real, so store calls already took
+     *        their time and no delay is modelled.
+     */
+    virtual bool WallClock() const = 0;
+};
+
+} // namespace ns3
+
+#endif /* COTAS_TRANSPORT_H */
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-udp-daemon.h"
+
+#include "cotas.h"
+
+#include "ns3/inet-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("CotasUdpDaemon");
+
+namespace
+{
+
+sockaddr_in
+ToSockaddr(const Address& address)
+{
+    InetSocketAddress inet = InetSocketAddress::ConvertFrom(address);
+    sockaddr_in destino{};
+    destino.sin_family = AF_INET;
+    destino.sin_addr.s_addr = htonl(inet.GetIpv4().Get());
+    destino.sin_port = htons(inet.GetPort());
+    return destino;
+}
+
+} // namespace
+
+CotasUdpDaemon::CotasUdpDaemon(Ptr<CoTaS> cotas, uint16_t port, uint32_t workers)
+    : m_cotas(cotas),
+      m_port(port),
+      m_workerCount(workers ? workers : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+CotasUdpDaemon::~CotasUdpDaemon()
+{
+    Stop();
+    for (Worker& worker : m_workers)
+    {
+        if (worker.thread.joinable())
+        {
+            worker.thread.join();
+        }
+        for (int fd : {worker.socket, worker.epoll})
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+    if (m_wakeup >= 0)
+    {
+        close(m_wakeup);
+    }
+}
+
+bool
+CotasUdpDaemon::OpenWorker(Worker& worker)
+{
+    worker.socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int um = 1;
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(m_port);
+    // todos os workers na mesma porta; o kernel divide os clientes entre eles
+    if (worker.socket < 0 ||
+        setsockopt(worker.socket, SOL_SOCKET, SO_REUSEPORT, &um, sizeof(um)) < 0 ||
+        bind(worker.socket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0)
+    {
+        NS_LOG_ERROR("[CoTaS] Falha ao abrir a porta " << m_port << ": " << std::strerror(errno));
+        return false;
+    }
+
+    worker.epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (worker.epoll < 0)
+    {
+        NS_LOG_ERROR("[CoTaS] Falha ao criar o epoll: " << std::strerror(errno));
+        return false;
+    }
+    for (int fd : {worker.socket, m_wakeup})
+    {
+        epoll_event evento{};
+        evento.events = EPOLLIN;
+        evento.data.fd = fd;
+        epoll_ctl(worker.epoll, EPOLL_CTL_ADD, fd, &evento);
+    }
+    return true;
+}
+
+bool
+CotasUdpDaemon::Run()
+{
+    m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeup < 0)
+    {
+        NS_LOG_ERROR("[CoTaS] Falha ao criar o eventfd: " << std::strerror(errno));
+        return false;
+    }
+    m_workers.resize(m_workerCount);
+    for (Worker& worker : m_workers)
+    {
+        if (!OpenWorker(worker))
+        {
+            return false;
+        }
+    }
+
+    m_cotas->SetTransport(this);
+    if (!m_cotas->StartService())
+    {
+        return false;
+    }
+    NS_LOG_INFO("[CoTaS] Servindo na porta UDP " << m_port << " com " << m_workerCount
+                                                 << " workers");
+
+    for (Worker& worker : m_workers)
+    {
+        worker.thread = std::thread(&CotasUdpDaemon::ReadLoop, this, std::ref(worker));
+    }
+    Simulator::Schedule(Seconds(1), &CotasUdpDaemon::Watch, this);
+    Simulator::Run();
+
+    uint64_t recebidos = 0;
+    uint64_t chamadas = 0;
+    for (Worker& worker : m_workers)
+    {
+        worker.thread.join();
+        recebidos += worker.datagrams;
+        chamadas += worker.calls;
+    }
+    m_cotas->StopService();
+    Flush();
+
+    NS_LOG_INFO("[CoTaS] Datagramas recebidos: " << recebidos << " em " << chamadas
+                                                 << " recvmmsg; enviados: " << m_sent << " em "
+                                                 << m_sendCalls << " sendmmsg; descartados: "
+                                                 << m_dropped);
+    return true;
+}
+
+void
+CotasUdpDaemon::Stop()
+{
+    m_stopping = true;
+    if (m_wakeup >= 0)
+    {
+        uint64_t um = 1;
+        [[maybe_unused]] ssize_t escritos = write(m_wakeup, &um, sizeof(um));
+    }
+}
+
+void
+CotasUdpDaemon::Watch()
+{
+    // também mantém a lista de eventos do simulador sempre com algo
+    if (m_stopping)
+    {
+        Simulator::Stop();
+        return;
+    }
+    Simulator::Schedule(Seconds(1), &CotasUdpDaemon::Watch, this);
+}
+
+void
+CotasUdpDaemon::ReadLoop(Worker& worker)
+{
+    // buffers do worker, montados uma vez e reaproveitados em cada recvmmsg
+    std::vector<uint8_t> buffers(BATCH * BUFSIZE);
+    std::vector<sockaddr_in> origens(BATCH);
+    std::vector<iovec> vetores(BATCH);
+    std::vector<mmsghdr> mensagens(BATCH);
+    for (uint32_t i = 0; i < BATCH; i++)
+    {
+        vetores[i].iov_base = buffers.data() + i * BUFSIZE;
+        vetores[i].iov_len = BUFSIZE;
+        mensagens[i].msg_hdr.msg_iov = &vetores[i];
+        mensagens[i].msg_hdr.msg_iovlen = 1;
+        mensagens[i].msg_hdr.msg_name = &origens[i];
+    }
+
+    epoll_event eventos[2];
+    while (!m_stopping)
+    {
+        int prontos = epoll_wait(worker.epoll, eventos, 2, -1);
+        if (prontos < 0 && errno != EINTR)
+        {
+            NS_LOG_ERROR("[CoTaS] Falha no epoll: " << std::strerror(errno));
+            return;
+        }
+        for (int i = 0; i < prontos; i++)
+        {
+            if (eventos[i].data.fd != worker.socket)
+            {
+                return; // Stop
+            }
+            // esvazia o socket: o epoll só avisa de novo com dados novos
+            while (true)
+            {
+                for (mmsghdr& mensagem : mensagens)
+                {
+                    mensagem.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                    mensagem.msg_hdr.msg_flags = 0;
+                }
+                int lidos = recvmmsg(worker.socket, mensagens.data(), BATCH, 0, nullptr);
+                if (lidos <= 0)
+                {
+                    break;
+                }
+                worker.calls++;
+                worker.datagrams += lidos;
+
+                std::vector<Datagram> lote;
+                lote.reserve(lidos);
+                for (int j = 0; j < lidos; j++)
+                {
+                    if (mensagens[j].msg_hdr.msg_flags & MSG_TRUNC)
+                    {
+                        continue; // maior que qualquer mensagem CoAP que o CoTaS aceita
+                    }
+                    const sockaddr_in& origem = origens[j];
+                    lote.push_back({InetSocketAddress(Ipv4Address(ntohl(origem.sin_addr.s_addr)),
+                                                      ntohs(origem.sin_port)),
+                                    std::string(static_cast<char*>(vetores[j].iov_base),
+                                                mensagens[j].msg_len),
+                                    worker.socket});
+                }
+
+                // o CoTaS só roda na thread do simulador: um evento por lote
+                Simulator::ScheduleWithContext(Simulator::NO_CONTEXT,
+                                               Seconds(0),
+                                               [this, lote = std::move(lote)]() {
+                                                   Deliver(lote);
+                                               });
+                if (static_cast<uint32_t>(lidos) < BATCH)
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void
+CotasUdpDaemon::Deliver(const std::vector<Datagram>& batch)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+    // a resposta sai pelo socket que recebeu o pedido, na fila do mesmo worker
+    auto socket = std::make_shared<const int>(batch.front().socket);
+    for (const Datagram& datagrama : batch)
+    {
+        m_cotas->HandleDatagram(reinterpret_cast<const uint8_t*>(datagrama.bytes.data()),
+                                datagrama.bytes.size(),
+                                {datagrama.peer, socket});
+    }
+}
+
+void
+CotasUdpDaemon::Flush()
+{
+    // um sendmmsg por socket; a ordem de cada cliente se mantém
+    std::stable_sort(m_outbox.begin(),
+                     m_outbox.end(),
+                     [](const Datagram& a, const Datagram& b) { return a.socket < b.socket; });
+    auto inicio = m_outbox.begin();
+    while (inicio != m_outbox.end())
+    {
+        auto fim = std::find_if(inicio, m_outbox.end(), [inicio](const Datagram& d) {
+            return d.socket != inicio->socket;
+        });
+        FlushSocket(inicio, fim);
+        inicio = fim;
+    }
+    m_outbox.clear();
+}
+
+void
+CotasUdpDaemon::FlushSocket(std::vector<Datagram>::iterator begin,
+                            std::vector<Datagram>::iterator end)
+{
+    std::vector<sockaddr_in> destinos(BATCH);
+    std::vector<iovec> vetores(BATCH);
+    std::vector<mmsghdr> mensagens(BATCH);
+
+    int socket = begin->socket;
+    size_t total = end - begin;
+    size_t enviados = 0;
+    while (enviados < total)
+    {
+        uint32_t n = std::min<size_t>(BATCH, total - enviados);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            Datagram& datagrama = begin[enviados + i];
+            destinos[i] = ToSockaddr(datagrama.peer);
+            vetores[i].iov_base = datagrama.bytes.data();
+            vetores[i].iov_len = datagrama.bytes.size();
+            mensagens[i] = mmsghdr{};
+            mensagens[i].msg_hdr.msg_name = &destinos[i];
+            mensagens[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            mensagens[i].msg_hdr.msg_iov = &vetores[i];
+            mensagens[i].msg_hdr.msg_iovlen = 1;
+        }
+        int saidos = sendmmsg(socket, mensagens.data(), n, 0);
+        if (saidos <= 0)
+        {
+            // buffer do socket cheio: como em qualquer UDP, o cliente retransmite
+            NS_LOG_INFO("[CoTaS] Datagramas descartados: " << std::strerror(errno));
+            break;
+        }
+        m_sendCalls++;
+        enviados += saidos;
+    }
+    m_sent += enviados;
+    m_dropped += total - enviados;
+}
+
+void
+CotasUdpDaemon::Reply(const Request& request, const std::string& datagram, Time delay)
+{
+    if (!delay.IsZero())
+    {
+        Simulator::Schedule(delay, [this, request, datagram]() {
+            Reply(request, datagram, Seconds(0));
+        });
+        return;
+    }
+    int socket = request.link ? *std::static_pointer_cast<const int>(request.link)
+                              : m_workers.front().socket;
+    Queue({request.from, datagram, socket});
+}
+
+void
+CotasUdpDaemon::Send(const Address& to, const std::string& datagram)
+{
+    // sem pedido que o origine, qualquer socket da porta serve
+    Queue({to, datagram, m_workers.front().socket});
+}
+
+void
+CotasUdpDaemon::Queue(Datagram datagram)
+{
+    // as respostas do mesmo instante saem juntas, depois dos eventos já agendados
+    if (m_outbox.empty())
+    {
+        Simulator::ScheduleNow(&CotasUdpDaemon::Flush, this);
+    }
+    m_outbox.push_back(std::move(datagram));
+}
+
+bool
+CotasUdpDaemon::WallClock() const
+{
+    return true;
+}
+
+} // namespace ns3
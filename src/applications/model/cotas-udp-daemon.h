@@ -0,0 +1,132 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_UDP_DAEMON_H
+#define COTAS_UDP_DAEMON_H
+
+#include "cotas-transport.h"
+
+#include "ns3/ptr.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+class CoTaS;
+
+/**
+ * @ingroup cotas
+ * @brief Serves a CoTaS on Linux UDP sockets, outside a simulation.
+ *
+ * The ns-3 core must run with the real-time simulator, so the periodic
+ * events of CoTaS and its resumed handlers fire on the wall clock.
+ *
+ * Receiving is multi-queue: each worker thread owns a socket bound to the
+ * same port with SO_REUSEPORT, so the kernel spreads the clients over the
+ * workers' queues. A worker waits on its socket with epoll, drains it with
+ * recvmmsg and hands the whole batch to the simulator thread in one event.
+ * There the same CoTaS::HandleDatagram the simulations use runs for every
+ * datagram. The replies of an instant leave together with sendmmsg, each on
+ * the socket of the worker that received its request.
+ *
+ * Serving is not multi-core: parsing, the handlers and the in-memory
+ * indexes all run on the one simulator thread, and there are no
+ * worker-local caches. What runs beside it are the store round trips,
+ * on the StoreThreads threads of CoTaS, so throughput grows with the
+ * store's parallelism, not with the receiving workers.
+ */
+class CotasUdpDaemon : public CotasTransport
+{
+  public:
+    /**
+     * @param cotas the service, created but not installed on a node
+     * @param port UDP port the requests come to
+     * @param workers receiving threads, 0 for one per core
+     */
+    CotasUdpDaemon(Ptr<CoTaS> cotas, uint16_t port, uint32_t workers = 0);
+    ~CotasUdpDaemon() override;
+
+    /**
+     * @brief Serves until Stop is called, running the simulator.
+     * @return false if the sockets or the store could not be set up
+     */
+    bool Run();
+
+    /**
+     * @brief Makes Run return; only touches an atomic and an eventfd, so
+     *        it may be called from a signal handler.
+     */
+    void Stop();
+
+    void Reply(const Request& request, const std::string& datagram, Time delay) override;
+    void Send(const Address& to, const std::string& datagram) override;
+    bool WallClock() const override;
+
+  private:
+    /// datagrams a system call receives or sends at most
+    static constexpr uint32_t BATCH{64};
+
+    /// Receiving thread and what only it touches
+    struct Worker
+    {
+        int socket{-1};        //!< UDP socket, bound with SO_REUSEPORT
+        int epoll{-1};         //!< waits on the socket and the wakeup eventfd
+        std::thread thread;    //!< runs ReadLoop
+        uint64_t datagrams{0}; //!< datagrams received
+        uint64_t calls{0};     //!< recvmmsg calls that returned datagrams
+    };
+
+    /// Datagram on its way, in or out
+    struct Datagram
+    {
+        Address peer;      //!< client address
+        std::string bytes; //!< CoAP message
+        int socket{-1};    //!< socket it came in on or leaves by
+    };
+
+    /// opens and binds the socket of a worker
+    bool OpenWorker(Worker& worker);
+
+    /// worker thread: drains its socket in batches until Stop
+    void ReadLoop(Worker& worker);
+
+    /// runs, in the simulator, a batch a worker received
+    void Deliver(const std::vector<Datagram>& batch);
+
+    /// queues a datagram for the Flush of this instant
+    void Queue(Datagram datagram);
+
+    /// sends, in the simulator, the replies queued in this instant
+    void Flush();
+
+    /// sends queued datagrams that all leave by the same socket
+    void FlushSocket(std::vector<Datagram>::iterator begin, std::vector<Datagram>::iterator end);
+
+    /// checks once a second, in the simulator, if Stop was called
+    void Watch();
+
+    Ptr<CoTaS> m_cotas;                  //!< the service
+    uint16_t m_port;                     //!< UDP port
+    uint32_t m_workerCount;              //!< receiving threads
+    std::vector<Worker> m_workers;       //!< receiving threads
+    int m_wakeup{-1};                    //!< eventfd written by Stop
+    std::atomic<bool> m_stopping{false}; //!< Stop was called
+
+    // só a thread do simulador mexe daqui para baixo
+    std::vector<Datagram> m_outbox; //!< datagrams waiting for Flush
+    uint64_t m_sent{0};             //!< datagrams sent
+    uint64_t m_sendCalls{0};        //!< sendmmsg calls
+    uint64_t m_dropped{0};          //!< datagrams the kernel refused
+};
+
+} // namespace ns3
+
+#endif /* COTAS_UDP_DAEMON_H */
@@ -7,6 +7,8 @@
 #include "cotas.h"
 
 #include "ns3/address-utils.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/ipv4-address.h"
@@ -17,22 +19,50 @@
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
 #include "ns3/socket.h"
+#include "ns3/string.h"
 #include "ns3/udp-socket.h"
 #include "ns3/uinteger.h"
 #include "ns3/timestamp-tag.h"
 
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <iostream>
 #include <random>
+#include <regex>
 
 namespace ns3
 {
     
 #define BUFSIZE 1500
+// quantos objetos a política de seleção recebe para escolher
+static constexpr uint32_t MAX_OPCOES_POLITICA = 32;
+// acima disso os candidatos dos bitmaps não vão no VALUES da consulta
+static constexpr uint64_t MAX_CANDIDATOS_BITMAP = 256;
+// execuções compartilhadas abertas ao mesmo tempo; acima disso a
+// consulta vai ao banco sozinha
+static constexpr size_t MAX_VOOS = 256;
+// ids sorteados para uma inscrição antes de responder 5.03
+static constexpr uint32_t MAX_SORTEIOS_ID = 6;
+
+// pausa antes de cada sorteio: nenhuma no primeiro, depois 10 ms dobrando
+static Time
+PausaSorteio(uint32_t tentativa)
+{
+    return tentativa == 0 ? Seconds(0) : MilliSeconds(10 << (tentativa - 1));
+}
+// contadores por linha e linhas dos sketches de chaves quentes
+static constexpr uint32_t LARGURA_SKETCH = 1024;
+static constexpr uint32_t PROFUNDIDADE_SKETCH = 4;
+// namespace de cot: (BASE + <#>)
+static const std::string COT_NS = "http://nesped1.caf.ufv.br/od4cot#";
 NS_LOG_COMPONENT_DEFINE("CoTaSApplication");
 
 NS_OBJECT_ENSURE_REGISTERED(CoTaS);
 
+thread_local CoTaS::Tenant* CoTaS::s_storeTenant = nullptr;
+thread_local httplib::Client* CoTaS::s_storeClient = nullptr;
+
 TypeId
 CoTaS::GetTypeId()
 {
@@ -47,6 +77,191 @@ CoTaS::GetTypeId()
                           UintegerValue(0),
                           MakeUintegerAccessor(&CoTaS::m_tos),
                           MakeUintegerChecker<uint8_t>())
+            .AddAttribute("MaxQueryCost",
+                          "Structured searches estimated above this cost are "
+                          "rejected before reaching the store.",
+                          UintegerValue(64),
+                          MakeUintegerAccessor(&CoTaS::m_maxQueryCost),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("SpatialCellSize",
+                          "Side of the grid cells of the device location index, "
+                          "in the unit of cot:latitude/cot:longitude.",
+                          DoubleValue(2.0),
+                          MakeDoubleAccessor(&CoTaS::m_spatialCellSize),
+                          MakeDoubleChecker<double>(0))
+            .AddAttribute("Zones",
+                          "Named areas for zone searches, as "
+                          "\"Name:minX,minY,maxX,maxY;Other:...\".",
+                          StringValue(""),
+                          MakeStringAccessor(&CoTaS::m_zonesConfig),
+                          MakeStringChecker())
+            .AddAttribute("StateGraphs",
+                          "Write updates to per-device named graphs in the \"state\" "
+                          "service, outside the reasoned default graph.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&CoTaS::m_stateGraphs),
+                          MakeBooleanChecker())
+            .AddAttribute("FlushInterval",
+                          "Period in which numeric context values held in memory are "
+                          "written to the store. Zero writes every update directly.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&CoTaS::m_flushInterval),
+                          MakeTimeChecker())
+            .AddAttribute("BitmapIndex",
+                          "Answer class, usedFor and boolean state constraints of "
+                          "structured searches from in-memory bitmaps.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&CoTaS::m_bitmapIndex),
+                          MakeBooleanChecker())
+            .AddAttribute("BooleanStates",
+                          "Comma separated update keys indexed as boolean states.",
+                          StringValue("turnedOn,lightOn,locked,open,activated,curtainOpen,"
+                                      "windowOpen"),
+                          MakeStringAccessor(&CoTaS::m_booleanStatesConfig),
+                          MakeStringChecker())
+            .AddAttribute("RangeIndexes",
+                          "Comma separated numeric update keys (ex: temperature,"
+                          "powerSupply.batteryLevel) kept in ordered indexes for "
+                          "range predicates of structured searches.",
+                          StringValue(""),
+                          MakeStringAccessor(&CoTaS::m_rangeIndexesConfig),
+                          MakeStringChecker())
+            .AddAttribute("SelectionPolicy",
+                          "Policy used to pick among matching objects, per application "
+                          "class, as \"FallDetection=round-robin;*=least-loaded\". "
+                          "Policies: first, round-robin, least-recent, least-loaded, "
+                          "ap-affinity.",
+                          StringValue("*=first"),
+                          MakeStringAccessor(&CoTaS::m_selectionConfig),
+                          MakeStringChecker())
+            .AddAttribute("AffinityPrefixLength",
+                          "Prefix length of the subnet shared by the nodes of one "
+                          "access point, used by the ap-affinity policy.",
+                          UintegerValue(24),
+                          MakeUintegerAccessor(&CoTaS::m_affinityPrefixLength),
+                          MakeUintegerChecker<uint8_t>(0, 32))
+            .AddAttribute("Tenants",
+                          "Homes served by this instance, each with its own Fuseki "
+                          "dataset and indexes, as \"home1=10.1.1.0/24,10.1.2.0/24;"
+                          "home2=10.2.0.0/16\". Clients outside every subnet and "
+                          "without the Tenant CoAP option use the default dataset.",
+                          StringValue(""),
+                          MakeStringAccessor(&CoTaS::m_tenantsConfig),
+                          MakeStringChecker())
+            .AddAttribute("SingleFlight",
+                          "Identical store queries of one tenant arriving while an "
+                          "earlier one is still running share its result.",
+                          BooleanValue(true),
+                          MakeBooleanAccessor(&CoTaS::m_singleFlight),
+                          MakeBooleanChecker())
+            .AddAttribute("BatchWindow",
+                          "Time a search that reaches the store waits for others to be "
+                          "merged with it into one SPARQL query. Zero disables batching.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&CoTaS::m_batchWindow),
+                          MakeTimeChecker())
+            .AddAttribute("MaxBatchSize",
+                          "A batch with this many searches runs without waiting for "
+                          "the end of the window.",
+                          UintegerValue(16),
+                          MakeUintegerAccessor(&CoTaS::m_maxBatchSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("History",
+                          "Keep a compressed time series of every numeric update, "
+                          "read through the /history resource.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&CoTaS::m_historyEnabled),
+                          MakeBooleanChecker())
+            .AddAttribute("HistoryRetention",
+                          "Age after which history samples may be dropped. Zero keeps "
+                          "every sample.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&CoTaS::m_historyRetention),
+                          MakeTimeChecker())
+            .AddAttribute("PatchUpdates",
+                          "Send updates of values known from the subscription profile as "
+                          "RDF Patch triple swaps.",
+                          BooleanValue(true),
+                          MakeBooleanAccessor(&CoTaS::m_patchUpdates),
+                          MakeBooleanChecker())
+            .AddAttribute("HotKeys",
+                          "Most frequent keys reported per sketch: objectIds of the "
+                          "updates, client addresses and search shapes. Zero disables "
+                          "the sketches.",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&CoTaS::m_hotKeys),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("HotKeysInterval",
+                          "Period of the hot keys report, after which the sketches start "
+                          "over. Zero reports once, when the application stops.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&CoTaS::m_hotKeysInterval),
+                          MakeTimeChecker())
+            .AddAttribute("Upstream",
+                          "CoTaS that federates this one: every DigestInterval it gets "
+                          "a digest of the classes and usedFor contexts of each tenant, "
+                          "and it forwards the searches that may match.",
+                          AddressValue(),
+                          MakeAddressAccessor(&CoTaS::m_upstream),
+                          MakeAddressChecker())
+            .AddAttribute("DigestInterval",
+                          "Period of the digests sent to the Upstream CoTaS.",
+                          TimeValue(Seconds(5)),
+                          MakeTimeAccessor(&CoTaS::m_digestInterval),
+                          MakeTimeChecker())
+            .AddAttribute("DigestBits",
+                          "Size in bits of the Bloom filter of a digest.",
+                          UintegerValue(512),
+                          MakeUintegerAccessor(&CoTaS::m_digestBits),
+                          MakeUintegerChecker<uint32_t>(64, 8192))
+            .AddAttribute("FederationTimeout",
+                          "How long a federated search waits for the homes; the reply "
+                          "carries the results of those that answered.",
+                          TimeValue(MilliSeconds(500)),
+                          MakeTimeAccessor(&CoTaS::m_federationTimeout),
+                          MakeTimeChecker())
+            .AddAttribute("StoreCompression",
+                          "Ask the store for gzip responses and gzip the request bodies "
+                          "of at least StoreCompressionMin bytes.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&CoTaS::m_storeCompression),
+                          MakeBooleanChecker())
+            .AddAttribute("StoreCompressionMin",
+                          "Smallest request body, in bytes, sent compressed; smaller "
+                          "ones cost more to compress than they save.",
+                          UintegerValue(8192),
+                          MakeUintegerAccessor(&CoTaS::m_storeCompressionMin),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("StoreHost",
+                          "Host of the Fuseki server.",
+                          StringValue("localhost"),
+                          MakeStringAccessor(&CoTaS::m_storeHost),
+                          MakeStringChecker())
+            .AddAttribute("StorePort",
+                          "Port of the Fuseki server.",
+                          UintegerValue(3030),
+                          MakeUintegerAccessor(&CoTaS::m_storePort),
+                          MakeUintegerChecker<uint16_t>())
+            .AddAttribute("StoreThreads",
+                          "Store calls of the handlers running at once on the wall "
+                          "clock, each on its own thread and connection. Zero runs "
+                          "them on the simulator thread, one at a time. Simulations "
+                          "always run them there and model the overlap.",
+                          UintegerValue(4),
+                          MakeUintegerAccessor(&CoTaS::m_storeThreads),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("StandingQueryTimeout",
+                          "How long a standing query is kept without being registered "
+                          "again or requested.",
+                          TimeValue(Seconds(600)),
+                          MakeTimeAccessor(&CoTaS::m_standingTimeout),
+                          MakeTimeChecker())
+            .AddAttribute("BlockTimeout",
+                          "How long a Block1 request waits for its next block before "
+                          "its blocks are dropped.",
+                          TimeValue(Seconds(30)),
+                          MakeTimeAccessor(&CoTaS::m_blockTimeout),
+                          MakeTimeChecker())
             .AddTraceSource("Rx",
                             "A packet has been received",
                             MakeTraceSourceAccessor(&CoTaS::m_rxTrace),
@@ -54,15 +269,20 @@ CoTaS::GetTypeId()
             .AddTraceSource("RxWithAddresses",
                             "A packet has been received",
                             MakeTraceSourceAccessor(&CoTaS::m_rxTraceWithAddresses),
-                            "ns3::Packet::TwoAddressTracedCallback");
+                            "ns3::Packet::TwoAddressTracedCallback")
+            .AddTraceSource("HotKeys",
+                            "Most frequent keys of a sketch in the last period",
+                            MakeTraceSourceAccessor(&CoTaS::m_hotKeysTrace),
+                            "ns3::CoTaS::HotKeysCallback");
     return tid;
 }
 
 CoTaS::CoTaS()
     : SinkApplication(DEFAULT_PORT),
+      m_transport{this},
+      m_blocks{MAX_BLOCK_BODY, MAX_BLOCK_TRANSFERS, MAX_BLOCK_BYTES},
       m_socket{nullptr},
       m_socket6{nullptr},
-      m_cli{"localhost", 3030},
       m_recived_messages{0},
       m_send_messages{0}
 {
@@ -74,7 +294,11 @@ CoTaS::~CoTaS()
     NS_LOG_FUNCTION(this);
     m_socket = nullptr;
     m_socket6 = nullptr;
-    m_cli.stop();
+    m_storePool.Stop();
+    if (m_cli)
+    {
+        m_cli->stop();
+    }
 }
 
 void
@@ -83,23 +307,105 @@ CoTaS::StartApplication()
     NS_LOG_INFO("[CoTaS] Inicia CoTaS");
     NS_LOG_FUNCTION(this);
 
+    if (!StartService())
+    {
+        return;
+    }
+
+    // coisas do ns3
+    StartSockets();
+}
+
+bool
+CoTaS::StartService()
+{
+    // cada casa tem seu dataset e seus índices
+    ParseTenants();
+
+    m_cli = std::make_unique<httplib::Client>(m_storeHost, m_storePort);
+    // a resposta é descomprimida no StoreSend, que mede os dois tamanhos
+    m_cli->set_decompress(false);
+
     // inicia a conexão com o banco
     try
     {
         // faz put dos dados iniciais
-        SetupDatabase();
+        for (auto& [nome, tenant] : m_tenants)
+        {
+            m_tenant = &tenant;
+            SetupDatabase();
+        }
 
         NS_LOG_INFO("[CoTaS] Banco de dados criado e conectado com sucesso.");
     }
     catch ( const std::exception& e )
     {
         NS_LOG_ERROR("An exception occurred in setup database " << e.what() );
-        return;
+        return false;
     }
 
     StartHandlerDict();
 
-    // coisas do ns3
+    ParseZones();
+    ParseSelectionPolicies();
+
+    m_booleanStates.clear();
+    std::stringstream estados(m_booleanStatesConfig);
+    std::string estado;
+    while (std::getline(estados, estado, ','))
+    {
+        m_booleanStates.insert(estado);
+    }
+    m_booleanStates.insert("turnedOn");
+
+    std::vector<std::string> faixas;
+    std::stringstream indices(m_rangeIndexesConfig);
+    std::string indice;
+    while (std::getline(indices, indice, ','))
+    {
+        if (!indice.empty())
+        {
+            faixas.push_back(indice);
+        }
+    }
+    for (auto& [nome, tenant] : m_tenants)
+    {
+        tenant.spatialIndex = CotasSpatialIndex(m_spatialCellSize);
+        tenant.selection = CotasSelectionPolicy(m_affinityPrefixLength);
+        tenant.rangeIndex.Configure(faixas);
+        for (auto sketch : {&tenant.hotObjects, &tenant.hotClients, &tenant.hotQueries})
+        {
+            *sketch = CotasHeavyHitters(LARGURA_SKETCH, PROFUNDIDADE_SKETCH, m_hotKeys);
+        }
+    }
+
+    // no relógio de parede as etapas dos handlers esperam o banco em
+    // threads próprias; na simulação o tempo delas é modelado
+    if (m_transport->WallClock() && m_storeThreads > 0)
+    {
+        m_storePool.Start(m_storeHost, m_storePort, m_storeThreads);
+    }
+
+    // tabela quente manda para o banco de tempos em tempos
+    if (!m_flushInterval.IsZero())
+    {
+        m_flushEvent = Simulator::Schedule(m_flushInterval, &CoTaS::ScheduleFlush, this);
+    }
+    if (m_hotKeys > 0 && !m_hotKeysInterval.IsZero())
+    {
+        m_hotKeysEvent = Simulator::Schedule(m_hotKeysInterval, &CoTaS::ScheduleHotKeys, this);
+    }
+    // o primeiro resumo espera os dispositivos da casa se inscreverem
+    if (InetSocketAddress::IsMatchingType(m_upstream))
+    {
+        m_digestEvent = Simulator::Schedule(m_digestInterval, &CoTaS::SendDigests, this);
+    }
+    return true;
+}
+
+void
+CoTaS::StartSockets()
+{
     if (!m_socket)
     {
         auto tid = TypeId::LookupByName("ns3::UdpSocketFactory");
@@ -163,8 +469,7 @@ CoTaS::StopApplication()
 {
     NS_LOG_FUNCTION(this);
 
-    NS_LOG_INFO("Durante a simulação chegou " << m_recived_messages << " no cotas");
-    NS_LOG_INFO("Durante a simulação foram enviadas " << m_send_messages << " do cotas");
+    StopService();
 
     if (m_socket)
     {
@@ -178,22 +483,62 @@ CoTaS::StopApplication()
     }
 }
 
+void
+CoTaS::StopService()
+{
+    NS_LOG_INFO("Durante a simulação chegou " << m_recived_messages << " no cotas");
+    NS_LOG_INFO("Durante a simulação foram enviadas " << m_send_messages << " do cotas");
+
+    // as etapas em andamento terminam; daqui em diante o banco é
+    // chamado na thread do simulador
+    m_storePool.Stop();
+
+    // o que ficou na tabela quente ainda vai para o banco
+    m_flushEvent.Cancel();
+    m_hotKeysEvent.Cancel();
+    m_digestEvent.Cancel();
+    DumpHotKeys();
+    for (auto& [nome, tenant] : m_tenants)
+    {
+        m_tenant = &tenant;
+        tenant.batchEvent.Cancel();
+        tenant.batch.clear();
+        FlushState();
+        NS_LOG_INFO("[CoTaS] Casa '" << nome << "': " << tenant.subscriptions
+                                     << " inscrições, " << tenant.updates
+                                     << " atualizações, " << tenant.searches << " buscas, "
+                                     << tenant.collapsed << " consultas compartilhadas, "
+                                     << tenant.batches << " lotes");
+        if (tenant.federated > 0)
+        {
+            NS_LOG_INFO("[CoTaS] Casa '" << nome << "': " << tenant.federated
+                                         << " buscas federadas foram a " << tenant.forwarded
+                                         << " casas, de " << tenant.homes.size());
+        }
+        if (tenant.expired > 0 || tenant.skipped > 0)
+        {
+            NS_LOG_INFO("[CoTaS] Casa '" << nome << "': " << tenant.expired
+                                         << " pedidos descartados fora do prazo, "
+                                         << tenant.skipped << " etapas do banco evitadas");
+        }
+    }
+
+    NS_LOG_INFO("[CoTaS] Banco: " << m_storeTraffic.sent << " bytes enviados ("
+                                  << m_storeTraffic.sentWire << " na rede), "
+                                  << m_storeTraffic.received << " recebidos ("
+                                  << m_storeTraffic.receivedWire << " na rede)");
+}
+
 void
 CoTaS::HandleRead(Ptr<Socket> socket)
 {
     // NS_LOG_INFO("[CoTaS] Chegou requisição no servidor CoTaS");
     NS_LOG_FUNCTION(this << socket);
 
-    // coletando dados para analise
-    m_recived_messages++;
-    
     Address from;
     while (auto packet = socket->RecvFrom(from))
     {
         Address localAddress;
-        auto start_clock = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsed;
-        double seconds_taken;
 
         socket->GetSockName(localAddress);
         m_rxTrace(packet);
@@ -204,55 +549,11 @@ CoTaS::HandleRead(Ptr<Socket> socket)
         if (InetSocketAddress::IsMatchingType(from))
         {
             // raw_data são os dados que os objetos mandaram para o serviço
-            uint8_t* raw_data = new uint8_t[packet->GetSize()];
-            coap_pdu_t *pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, 0, BUFSIZE);
-            u_int8_t check;
-            std::string path;
-            nlohmann::json response_data;
-            TimestampTag timestampTag;
-            std::string data;
-            encoded_data data_pdu;
-            Ptr<Packet> response;
-
-            packet->CopyData(raw_data, packet->GetSize());
-
-            check = coap_pdu_parse(COAP_PROTO_UDP, raw_data, packet->GetSize(), pdu);
-            if (!check){
-                NS_LOG_INFO("[CoTaS] Falha ao decodificar a pdu" <<  check);
-                delete[] raw_data;
-                abort();
-            }
-            
-            path = GetPduPath(pdu);
-            // NS_LOG_INFO("[CoTaS] caminho que chegou no cotas:" << path);
-
-            if(m_handlerDict.count(path))
-            {   // existe a operação que responde a requisição:
-                // usa o dicionário de funções
-                HandlersFunctions handler = m_handlerDict[path];
-                response_data = handler(from, pdu);
-
-            }else
-            {   
-                response_data = HandleBadRequest();
-            }
-
-            data_pdu = EncodePduResponse(response_data["status"], response_data.dump());
-
-            response = Create<Packet>(data_pdu.buffer, data_pdu.size);
-            
-            if(packet->PeekPacketTag(timestampTag))
-            {
-                response->AddPacketTag(timestampTag);
-            }
-
-            auto end_clock = std::chrono::high_resolution_clock::now();
-
-            elapsed = end_clock - start_clock;
-            seconds_taken = elapsed.count();
-            
-            Simulator::Schedule(Seconds(seconds_taken), &CoTaS::SendReply, this, socket, response, from);
-            delete[] raw_data;
+            std::vector<uint8_t> raw_data(packet->GetSize());
+            packet->CopyData(raw_data.data(), raw_data.size());
+            HandleDatagram(raw_data.data(),
+                           raw_data.size(),
+                           {from, std::make_shared<SocketLink>(SocketLink{socket, packet})});
         }
         // trata no ipv6
         else if (Inet6SocketAddress::IsMatchingType(from))
@@ -265,224 +566,2042 @@ CoTaS::HandleRead(Ptr<Socket> socket)
     }
 }
 
-nlohmann::json
-CoTaS::HandleSubscription(Address from, coap_pdu_t* pdu)
+void
+CoTaS::HandleDatagram(const uint8_t* data, size_t size, const CotasTransport::Request& request)
 {
-    std::string payload = GetPduPayloadString(pdu);
+    // coletando dados para analise
+    m_recived_messages++;
 
-    // verifica se já foi feita inscrição pelo endereço de ip
-    int valida = ValidateIP_Q(from);
-    if (valida)
+    auto start_clock = std::chrono::high_resolution_clock::now();
+    const Address& from = request.from;
+    coap_pdu_t *pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, 0, BUFSIZE);
+    u_int8_t check;
+    std::string path;
+
+    check = coap_pdu_parse(COAP_PROTO_UDP, data, size, pdu);
+    if (!check){
+        // fora do simulador qualquer um manda datagramas, não só os nossos clientes
+        NS_LOG_INFO("[CoTaS] Falha ao decodificar a pdu" <<  check);
+        coap_delete_pdu(pdu);
+        return;
+    }
+    
+    // mensagem vazia não vai para os handlers: um ping (CON vazio) é
+    // respondido com RST, ACK e RST vazios não pedem nada
+    if (coap_pdu_get_code(pdu) == COAP_EMPTY_CODE)
     {
-        // ip já inscrito, manda o id novamente.
-        // NS_LOG_INFO("[CoTaS] IP já inscrito");
-        // NS_LOG_INFO("[CoTaS] Id do ip inscrito: " << valida);
-        nlohmann::json res = {{"status", COAP_RESPONSE_CODE_CREATED}, {"id", valida}};
-        
-        return res;
+        if (coap_pdu_get_type(pdu) == COAP_MESSAGE_CON)
+        {
+            SendReply(request,
+                      EncodePduEmpty(COAP_MESSAGE_RST, coap_pdu_get_mid(pdu)),
+                      Seconds(0));
+        }
+        coap_delete_pdu(pdu);
+        return;
     }
 
-    // gera id seguro (vamos abstrair segurança)
-    int precisa_gerar = 1;
-    int id;
-    while (precisa_gerar)
+    // resposta de uma casa a uma busca federada
+    if (COAP_RESPONSE_CLASS(coap_pdu_get_code(pdu)) >= 2)
+    {
+        HandleFederationReply(pdu);
+        coap_delete_pdu(pdu);
+        return;
+    }
+
+    // sem Uri-Path o caminho fica vazio, que nenhum handler atende: 4.00
+    GetPduPath(pdu, path);
+    // NS_LOG_INFO("[CoTaS] caminho que chegou no cotas:" << path);
+
+    // pedido em blocos só é tratado quando chega o último, e a
+    // resposta confirma o bloco final
+    coap_block_t bloco;
+    std::vector<std::pair<uint16_t, std::string>> opcoes;
+    std::string corpo;
+    bool temCorpo = true;
+    if (coap_get_block(pdu, COAP_OPTION_BLOCK1, &bloco))
     {
-        id = RandomInt(20000, 20000000);
-        // validar id
-        if (!ValidateID_Q(id))
+        if (!ReceiveBlock(request, path, pdu, bloco, corpo))
         {
-            precisa_gerar = 0;
+            coap_delete_pdu(pdu);
+            return;
         }
+        opcoes.emplace_back(COAP_OPTION_BLOCK1, EncodeBlockOption(bloco.num, false, bloco.szx));
+    }
+    else
+    {
+        temCorpo = GetPduPayloadString(pdu, corpo);
     }
 
-    // insere dados json
-    InsertDataSub_Q(id, from, payload);
+    // tudo abaixo usa o dataset e os índices da casa do cliente
+    m_tenant = ResolveTenant(from, pdu);
 
-    // retorna status ok com id ou error sem id
-    nlohmann::json res = {{"status", COAP_RESPONSE_CODE_CREATED}, {"id", id}};
+    // o prazo do cliente conta da chegada; quem já desistiu não
+    // ocupa o servidor
+    uint32_t orcamento;
+    Time prazo = GetPduUintOption(pdu, COAP_OPTION_DEADLINE, orcamento)
+                     ? Simulator::Now() + MilliSeconds(orcamento)
+                     : Seconds(0);
+    if (m_tenant && Expired(prazo))
+    {
+        m_tenant->expired++;
+        coap_delete_pdu(pdu);
+        return;
+    }
 
-    return res;
-}
+    CotasTask tarefa = CotasTask::Ready(nullptr);
+    bool escrita = path != "/search" && path != "/history" &&
+                   path != "/search/federated" && path != "/federation/digest";
+    std::string token = GetPduToken(pdu);
+    if (!m_tenant)
+    {
+        tarefa = CotasTask::Ready({{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                                   {"error", "unknown tenant"}});
+    }
+    else if (m_handlerDict.count(path) && !temCorpo)
+    {
+        // todas as operações do CoTaS levam um corpo
+        tarefa = CotasTask::Ready({{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                                   {"error", "payload required"}});
+    }
+    else if(m_handlerDict.count(path))
+    {
+        if (m_hotKeys > 0)
+        {
+            m_tenant->hotClients.Add(std::to_string(
+                InetSocketAddress::ConvertFrom(from).GetIpv4().Get()));
+        }
+        // existe a operação que responde a requisição:
+        // usa o dicionário de funções, o handler pode
+        // suspender nas etapas do banco e terminar depois
+        HandlersFunctions handler = m_handlerDict[path];
+        m_request = request;
+        m_requestToken = token;
+        m_requestDeadline = prazo;
+        try
+        {
+            tarefa = handler(from, std::move(corpo));
+        }
+        catch (...)
+        {
+            // handler que não é corrotina lança direto
+            tarefa = CotasTask::Failed(std::current_exception());
+        }
+        m_requestDeadline = Seconds(0);
 
-nlohmann::json
-CoTaS::HandleUpdate(Address from, coap_pdu_t* pdu)
-{   
+        // quem escreveu no banco invalida as execuções em andamento
+        if (escrita)
+        {
+            m_tenant->flights.clear();
+        }
 
-    nlohmann::json payload = GetPduPayloadJson(pdu);
-    nlohmann::json response;
-    // NS_LOG_INFO("[CoTaS] payload em json que chegou: " << payload.dump() );
-    
-    // verifica se id é válido garante que o json tem id
-    if (payload.contains("objectId") && !ValidateID_Q(payload["objectId"]))
-    {
-        // id inválido
-        NS_LOG_INFO("[CoTaS] ID inválido, enviando mensagem de não autorizado");
-        nlohmann::json res = {
-            {"status", COAP_RESPONSE_CODE_UNAUTHORIZED},
-        };
-        
-        return res;
+    }else
+    {   
+        tarefa = CotasTask::Ready(HandleBadRequest());
     }
 
-    // constroi mensagem
-    std::string update_query = JsonToSparqlUpdateParser(payload);
-    
-    // NS_LOG_INFO("[CoTaS] ultima query obtida: \n" << update_query);
+    Tenant* tenant = m_tenant;
+    Time chegada = Simulator::Now();
+    tarefa.Then([this,
+                 pdu,
+                 request,
+                 tenant,
+                 escrita,
+                 chegada,
+                 start_clock,
+                 token,
+                 opcoes,
+                 prazo](nlohmann::json response_data, std::exception_ptr erro) {
+        // o handler terminou, ninguém mais lê a pdu
+        coap_delete_pdu(pdu);
+        if (tenant && escrita)
+        {
+            tenant->flights.clear();
+        }
+        if (erro)
+        {
+            // exceção no handler vira 5.00, o servidor segue atendendo
+            try
+            {
+                std::rethrow_exception(erro);
+            }
+            catch (const std::exception& e)
+            {
+                NS_LOG_WARN("[CoTaS] Exceção no handler: " << e.what());
+            }
+            catch (...)
+            {
+                NS_LOG_WARN("[CoTaS] Exceção desconhecida no handler");
+            }
+            response_data = {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
+        }
+        // busca que entrou num lote é respondida por RunBatch
+        if (response_data.is_null())
+        {
+            return;
+        }
 
-    // envia consulta para o fuseki
-    auto res = m_cli.Post("/dataset/update", update_query, "application/sparql-update");
+        encoded_data data_pdu = EncodeReply(response_data, token, opcoes);
 
-    if (res && (res->status == 200 || res->status == 204)) {
-        // NS_LOG_INFO("[CoTaS] DADOS ATUALIZADOS COM SUCESSO!");
-    } else {
-        // se deu erro
-        NS_LOG_INFO("[CoTaS] Erro na atualizacao");
-        if (res) {
-            NS_LOG_INFO("[CoTaS] Status: " << res->status << " Body: " << res->body);
-            
-        } else {
-            NS_LOG_INFO("[CoTaS] Erro de conexao: " << httplib::to_string(res.error()));
+        // handler que suspendeu já passou o tempo do banco esperando,
+        // o que terminou direto ainda paga o tempo que levou
+        Time espera = Seconds(0);
+        if (Simulator::Now() == chegada)
+        {
+            std::chrono::duration<double> elapsed =
+                std::chrono::high_resolution_clock::now() - start_clock;
+            espera = ModelledDelay(Seconds(elapsed.count()));
+        }
+        if (!prazo.IsZero() && Simulator::Now() + espera > prazo)
+        {
+            // chegaria depois que o cliente desistiu
+            if (tenant)
+            {
+                tenant->expired++;
+            }
+            return;
         }
-        response = {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
-        return response;
+        SendReply(request, data_pdu, espera);
+    });
+}
+
+bool
+CoTaS::ReceiveBlock(const CotasTransport::Request& request,
+                    const std::string& path,
+                    coap_pdu_t* pdu,
+                    const coap_block_t& block,
+                    std::string& body)
+{
+    InetSocketAddress origem = InetSocketAddress::ConvertFrom(request.from);
+    std::string chave = std::to_string(origem.GetIpv4().Get()) + ":" +
+                        std::to_string(origem.GetPort()) + " " + path;
+
+    // cliente que parou no meio não segura memória para sempre
+    m_blocks.Expire((Simulator::Now() - m_blockTimeout).GetMilliSeconds());
+    std::string pedaco;
+    GetPduPayloadString(pdu, pedaco);
+    CotasBlockAssembler::Result resultado =
+        m_blocks.Add(chave,
+                     block.num,
+                     block.m,
+                     size_t{1} << (block.szx + 4),
+                     pedaco,
+                     Simulator::Now().GetMilliSeconds(),
+                     body);
+    if (resultado == CotasBlockAssembler::DONE)
+    {
+        return true;
     }
 
-    // se não deu erro
-    response = {{"status", COAP_RESPONSE_CODE_CHANGED}};
-    return response;
+    coap_pdu_code_t codigo = COAP_RESPONSE_CODE_CONTINUE;
+    std::vector<std::pair<uint16_t, std::string>> opcoes;
+    switch (resultado)
+    {
+    case CotasBlockAssembler::MORE:
+        opcoes.emplace_back(COAP_OPTION_BLOCK1, EncodeBlockOption(block.num, true, block.szx));
+        break;
+    case CotasBlockAssembler::OUT_OF_ORDER:
+        codigo = COAP_RESPONSE_CODE_INCOMPLETE;
+        break;
+    case CotasBlockAssembler::TOO_LARGE:
+        codigo = COAP_RESPONSE_CODE_REQUEST_TOO_LARGE;
+        break;
+    default:
+        // transferências demais abertas: o cliente tenta mais tarde
+        codigo = COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE;
+        break;
+    }
+    SendReply(request, EncodeReply({{"status", codigo}}, GetPduToken(pdu), opcoes), Seconds(0));
+    return false;
 }
 
-nlohmann::json
-CoTaS::HandleRequest(Address from, coap_pdu_t* pdu)
+CotasTask
+CoTaS::HandleSubscription(Address from, std::string payload)
 {
-    // NS_LOG_INFO("[CoTaS] chegou uma requisição de uma aplicação ");
-
-    std::string payload = GetPduPayloadString(pdu);
-    nlohmann::json response;
-    std::ostringstream sparql_query;
+    return Subscribe(from, std::move(payload));
+}
 
-    // Prepara a consulta
-    sparql_query << SparqlPrefix()
-                 << "SELECT ?ip ?port "
-                 << "WHERE { "
-                 << "?device cot:ipAddress ?ip . "
-                 << "?device cot:port ?port . "
-                 << "?device cot:turnedOn 1 . "
-                 << payload 
-                 << " }";
+CotasTask
+CoTaS::SubscribeObject(Address from, std::string payload)
+{
+    m_tenant->subscriptions++;
+    // por referência o perfil do dispositivo é montado no Subscribe; só
+    // vem preenchido se esta inscrição inseriu o dispositivo, então um CON
+    // retransmitido (ou o mesmo ip de novo) recebe o id sem reindexar
+    std::string perfil;
+    nlohmann::json res = co_await Subscribe(from, payload, &perfil);
+    // objeto novo pode entrar no resultado das consultas permanentes
+    if (res.contains("id") && !perfil.empty())
+    {
+        co_await IndexObject(res["id"], perfil);
+    }
+    co_return res;
+}
 
-    // envia consulta
-    httplib::Params params;
-    params.emplace("query", sparql_query.str());
+CotasTask
+CoTaS::HandleApplicationSubscription(Address from, std::string payload)
+{
+    if (!CotasQuery::IsStructured(payload))
+    {
+        RecordApplicationType(from, payload);
+        co_return co_await Subscribe(from, payload);
+    }
 
-    httplib::Headers headers = {
-        { "Accept", "application/sparql-results+json" }
-    };
+    // {"profile": "<turtle>", "query": <consulta>}: a consulta fica registrada
+    nlohmann::json mensagem = nlohmann::json::parse(payload, nullptr, false);
+    if (!mensagem.is_object() || !mensagem.contains("profile") ||
+        !mensagem["profile"].is_string() || !mensagem.contains("query"))
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                   {"error", "expected \"profile\" and \"query\""}};
+    }
 
-    // envia a query para o fuseki
-    auto res = m_cli.Post("/dataset/query", headers, params);
-    
-    // trata resposta
-    if (res && res->status == httplib::OK_200) 
+    nlohmann::json registro = co_await RegisterStandingQuery(mensagem["query"]);
+    if (!registro.contains("queryId"))
     {
-        try 
-        {
-            // Parse da string da resposta para um objeto JSON
-            nlohmann::json j = nlohmann::json::parse(res->body);
+        NS_LOG_INFO("[CoTaS] Consulta permanente rejeitada: " << registro.value("error", ""));
+        co_return registro;
+    }
+    uint32_t queryId = registro["queryId"];
 
-            const auto& bindings = j["results"]["bindings"];
+    std::string perfil = mensagem["profile"];
+    RecordApplicationType(from, perfil);
+    nlohmann::json res = co_await Subscribe(from, perfil);
+    res["queryId"] = queryId;
+    co_return res;
+}
+
+CotasTask
+CoTaS::ResolveModel(std::string payload)
+{
+    static const std::regex nomeModelo("cot:[A-Za-z0-9_-]+");
+    nlohmann::json mensagem = nlohmann::json::parse(payload, nullptr, false);
+    std::string teste;
+    if (mensagem.is_discarded() || !mensagem.contains("model") ||
+        !mensagem["model"].is_string() ||
+        !std::regex_match(mensagem["model"].get<std::string>(), nomeModelo) ||
+        (mensagem.contains("overrides") && !mensagem["overrides"].is_object()) ||
+        (mensagem.contains("profile") && !mensagem["profile"].is_string()) ||
+        !CotasDeviceGraph::Compose("<teste>",
+                                   {},
+                                   mensagem.value("overrides", nlohmann::json::object()),
+                                   teste))
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                   {"error", "expected \"model\" and \"overrides\""}};
+    }
+    std::string modelo = mensagem["model"];
+    nlohmann::json sobrescritos = mensagem.value("overrides", nlohmann::json::object());
+    Model info;
 
-            if (bindings.empty()) 
+    auto conhecido = m_tenant->models.find(modelo);
+    if (conhecido != m_tenant->models.end())
+    {
+        info = conhecido->second;
+    }
+    else
+    {
+        bool ok = co_await Step([this, modelo, &info] { return ModelInfo_Q(modelo, info); });
+        if (ok && info.classes.empty() && mensagem.contains("profile"))
+        {
+            // primeira unidade do modelo: guarda o perfil sem o que é
+            // próprio de cada instância
+            std::vector<std::string> proprios = {"objectId", "ipAddress"};
+            for (auto& [chave, valor] : sobrescritos.items())
             {
-                // NS_LOG_INFO("[CoTaS] Nenhum objeto encontrado");
-                response = {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
-            } else 
+                proprios.push_back(chave.substr(0, chave.find_first_of("./")));
+            }
+            CotasDeviceGraph grafoModelo;
+            std::string perfilModelo;
+            if (!grafoModelo.Parse(mensagem["profile"],
+                                   SparqlPrefix(),
+                                   modelo.substr(4),
+                                   perfilModelo))
             {
-                // NS_LOG_INFO("[CoTaS] Foram encontrados objetos");
-                // NS_LOG_INFO("[CoTaS] Resultados de objetos encontrados: ");
-                // NS_LOG_INFO("[CoTaS] bindings " << bindings.dump());
-
-                // Itera sobre cada "linha" de resultado
-                // aqui é pra ter só um 
-                // não há iteração
-                for (const auto& item : bindings) 
-                {
-                    // Pega o valor da variável "?device"
-                    std::string raw_ip = item["ip"]["value"];
-                    uint32_t ip = std::stoi(raw_ip);
-                    
-                    std::string raw_port = item["port"]["value"];
-                    uint32_t port = std::stoi(raw_port);
-                    
-                    response = {{"status", COAP_RESPONSE_CODE_CONTENT}};
-                    response["response"] = {{"ip", ip}, {"port", port}};
-
-                    // NS_LOG_INFO("[CoTaS] Dispositivo de IP: " << ip 
-                    //             << " e de porta " << port 
-                    //             << " sendo enviado para aplicação");
-                    break; // retorna só o primeiro por enquanto
-                }
+                co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                           {"error", "invalid model profile"}};
+            }
+            perfilModelo = grafoModelo.Serialize(proprios);
+            ok = co_await Step([this, modelo, perfilModelo] {
+                return RegisterModel_Q(modelo, perfilModelo);
+            });
+            ok = ok && co_await Step([this, modelo, &info] { return ModelInfo_Q(modelo, info); });
+            if (ok && info.classes.empty())
+            {
+                co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                           {"error", "profile does not describe " + modelo}};
             }
-        } catch (const nlohmann::json::parse_error& e) 
+        }
+        if (!ok)
         {
-            NS_LOG_ERROR("Erro no parse da resposta JSON: " << e.what());
-            NS_LOG_ERROR("Resposta recebida: " << res->body);
-            response = {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
+            co_return {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
         }
-    } else 
+        if (info.classes.empty())
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_NOT_FOUND}, {"error", "unknown model"}};
+        }
+        m_tenant->models[modelo] = info;
+    }
+
+    // o que o modelo guarda vale para todas as unidades: um valor também
+    // na instância faria cot:instanceOf?/ devolver os dois
+    for (auto& [chave, valor] : sobrescritos.items())
     {
-        NS_LOG_INFO("[CoTaS] Erro na requisição, status:" << res->status << 
-            "\n cabeçalho:" << res->get_header_value("Content-Type") << 
-            "\n corpo:" << res->body);
-        NS_LOG_INFO("[CoTaS] error code: " << res.error());
-        response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}};
+        if (info.properties.count(chave.substr(0, chave.find_first_of("./"))))
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                       {"error", "\"" + chave + "\" is held by " + modelo}};
+        }
     }
-    return response;
+    co_return {{"model", modelo}, {"overrides", sobrescritos}, {"classes", info.classes}};
 }
 
-nlohmann::json
-CoTaS::HandleBadRequest()
+bool
+CoTaS::PrepareDevice(NewDevice& device)
 {
-    nlohmann::json response;
-    response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}};
-    return response;
-}
-
-void
-CoTaS::SetupDatabase(){
+    // gera id seguro (vamos abstrair segurança)
+    device.id = RandomInt(20000, 20000000);
 
-    // le os dados do primeiro arquivo
-    std::string payload;
-    std::vector<std::string> arquivos;
+    device.text = device.payload;
+    if (!device.model.empty())
+    {
+        // a instância tem nó próprio, com as classes do modelo para
+        // as buscas por classe a encontrarem
+        std::vector<std::string> declaracoes = {"cot:instanceOf " + device.model};
+        for (auto& classe : device.classes)
+        {
+            declaracoes.push_back("a " + classe);
+        }
+        CotasDeviceGraph::Compose(CotasQuery::DeviceSubject(device.id),
+                                  declaracoes,
+                                  device.overrides,
+                                  device.text);
+    }
 
-    payload = ReadFile("definition.ttl");
-    
-    // primeiro arquivo
-    if (auto res = m_cli.Put("/dataset/data?default", payload, "text/turtle;charset=utf-8")) 
+    // nós em branco ganham nomes derivados do id, assim as
+    // atualizações depois trocam triplas sem casar padrões; o banco só
+    // recebe o que o parser entendeu, nunca o texto do cliente
+    device.graph = CotasDeviceGraph();
+    std::string nomeado;
+    if (!device.graph.Parse(device.text, SparqlPrefix(), std::to_string(device.id), nomeado))
     {
-        NS_LOG_INFO("[CoTaS] Arquivo definition.ttl" << res->status << "\n" 
-                    << res->get_header_value("Content-Type") << "\n" 
-                    << res->body);
-    } else 
+        NS_LOG_INFO("[CoTaS] Perfil fora da sintaxe do parser");
+        return false;
+    }
+    if (device.model.empty())
     {
-        NS_LOG_INFO("[CoTaS] error code: " << res.error());
+        // unidades do mesmo produto mandam o mesmo sujeito; cada uma
+        // ganha o seu para não virarem um nó só no banco
+        device.graph.Rename(CotasQuery::DeviceSubject(device.id));
     }
+    return true;
+}
 
-    // restante dos arquivos
-    arquivos = {"application.ttl", "context.ttl",
-                "object.ttl", "unit.ttl"}; 
-    
-    for(auto nome_arquivo : arquivos){
-        payload = ReadFile(nome_arquivo);
-        if (auto res = m_cli.Post("/dataset/data?default", payload, "text/turtle;charset=utf-8")) 
-        {
-            NS_LOG_INFO("[CoTaS] Arquivo" << nome_arquivo << res->status << "\n" 
-                        << res->get_header_value("Content-Type") << "\n" 
-                        << res->body);
-        } else 
-        {
-            NS_LOG_INFO("[CoTaS] error code: " << res.error());
-        }
+void
+CoTaS::IndexDevice(NewDevice& device)
+{
+    if (!device.model.empty())
+    {
+        m_tenant->instances[device.id] = device.model;
+    }
+    if (m_patchUpdates)
+    {
+        m_tenant->graphs[device.id] = std::move(device.graph);
+    }
+    IndexLocation(device.id, device.text);
+    // a tabela sempre sabe quem está ligado, as consultas permanentes
+    // dependem disso mesmo sem a camada quente
+    m_tenant->stateTable.Load(device.id,
+                              "turnedOn",
+                              ProfileTurnedOn(device.text),
+                              Simulator::Now().GetSeconds());
+}
+
+CotasTask
+CoTaS::IndexObject(int32_t id, std::string text)
+{
+    // o resumo da federação sai do índice de categorias
+    if (m_bitmapIndex || InetSocketAddress::IsMatchingType(m_upstream))
+    {
+        co_await IndexCategories(id, text);
+    }
+    if (!m_tenant->rangeIndex.Keys().empty())
+    {
+        co_await IndexRanges(id);
+    }
+    co_await RefreshStandingQueries(id, nullptr);
+    co_return nullptr;
+}
+
+CotasTask
+CoTaS::Subscribe(Address from, std::string payload, std::string* profile)
+{
+    NewDevice dispositivo;
+    dispositivo.payload = payload;
+    dispositivo.ip = InetSocketAddress::ConvertFrom(from).GetIpv4().Get();
+
+    // por referência: o perfil estático do modelo fica uma vez só no
+    // banco e cada instância aponta para ele
+    if (CotasQuery::IsStructured(payload))
+    {
+        nlohmann::json modelo = co_await ResolveModel(payload);
+        if (modelo.contains("status"))
+        {
+            co_return modelo;
+        }
+        dispositivo.model = modelo["model"];
+        dispositivo.overrides = modelo["overrides"];
+        dispositivo.classes = modelo["classes"].get<std::vector<std::string>>();
+    }
+
+    // consulta e inserção numa operação só no banco, mais a releitura
+    for (uint32_t tentativa = 0; dispositivo.registered == 0; tentativa++)
+    {
+        if (tentativa == MAX_SORTEIOS_ID)
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE},
+                       {"error", "no free id, try again later"}};
+        }
+        // 0: o id sorteado já existia, sorteia outro depois de uma pausa
+        co_await Backoff{this, PausaSorteio(tentativa), nullptr, Seconds(0)};
+        if (!PrepareDevice(dispositivo))
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                       {"error", "profile syntax not supported"}};
+        }
+        if (!co_await Step([this, &dispositivo] { return RegisterDevices_Q({&dispositivo}); }))
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
+        }
+    }
+
+    if (dispositivo.registered != dispositivo.id)
+    {
+        // ip já inscrito, manda o id novamente.
+        // NS_LOG_INFO("[CoTaS] Id do ip inscrito: " << registrado);
+        co_return {{"status", COAP_RESPONSE_CODE_CREATED}, {"id", dispositivo.registered}};
+    }
+
+    IndexDevice(dispositivo);
+    if (m_stateGraphs)
+    {
+        SeedState({&dispositivo});
+    }
+    if (profile)
+    {
+        *profile = dispositivo.text;
+    }
+
+    // retorna status ok com id ou error sem id
+    nlohmann::json res = {{"status", COAP_RESPONSE_CODE_CREATED}, {"id", dispositivo.id}};
+
+    co_return res;
+}
+
+CotasTask
+CoTaS::SubscribeBulk(Address from, std::string payload)
+{
+    // o corpo pode ter vindo em blocos, remontado no HandleDatagram
+    nlohmann::json lote = nlohmann::json::parse(payload, nullptr, false);
+    if (!lote.is_array() || lote.empty())
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                   {"error", "expected an array of subscriptions"}};
+    }
+    if (lote.size() > MAX_BULK_DEVICES)
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_REQUEST_TOO_LARGE},
+                   {"error", "at most " + std::to_string(MAX_BULK_DEVICES) + " subscriptions"}};
+    }
+
+    // entradas inválidas não derrubam o lote, vão para "errors"
+    std::vector<NewDevice> dispositivos(lote.size());
+    std::vector<NewDevice*> validos;
+    nlohmann::json erros = nlohmann::json::array();
+    static const std::regex enderecoIpv4("(\\d{1,3}\\.){3}\\d{1,3}");
+    for (size_t i = 0; i < lote.size(); i++)
+    {
+        const nlohmann::json& entrada = lote[i];
+        if (!entrada.is_object() || !entrada.contains("address") ||
+            !entrada["address"].is_string() || !entrada.contains("subscription") ||
+            !std::regex_match(entrada["address"].get<std::string>(), enderecoIpv4))
+        {
+            erros.push_back({i, COAP_RESPONSE_CODE_BAD_REQUEST});
+            continue;
+        }
+        NewDevice& dispositivo = dispositivos[i];
+        dispositivo.ip = Ipv4Address(entrada["address"].get<std::string>().c_str()).Get();
+        if (entrada["subscription"].is_string())
+        {
+            dispositivo.payload = entrada["subscription"];
+        }
+        else
+        {
+            nlohmann::json modelo = co_await ResolveModel(entrada["subscription"].dump());
+            if (modelo.contains("status"))
+            {
+                erros.push_back({i, modelo["status"]});
+                continue;
+            }
+            dispositivo.model = modelo["model"];
+            dispositivo.overrides = modelo["overrides"];
+            dispositivo.classes = modelo["classes"].get<std::vector<std::string>>();
+        }
+        if (!PrepareDevice(dispositivo))
+        {
+            erros.push_back({i, COAP_RESPONSE_CODE_BAD_REQUEST});
+            continue;
+        }
+        validos.push_back(&dispositivo);
+    }
+
+    // todos num pedido só ao banco; quem perdeu o id sorteado vai de novo
+    std::vector<NewDevice*> pendentes = validos;
+    for (uint32_t tentativa = 0; !pendentes.empty(); tentativa++)
+    {
+        if (tentativa == MAX_SORTEIOS_ID)
+        {
+            // os que ainda colidem ficam sem id, o resto do lote segue
+            for (NewDevice* dispositivo : pendentes)
+            {
+                erros.push_back(
+                    {dispositivo - dispositivos.data(), COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE});
+            }
+            break;
+        }
+        co_await Backoff{this, PausaSorteio(tentativa), nullptr, Seconds(0)};
+        if (!co_await Step([this, &pendentes] { return RegisterDevices_Q(pendentes); }))
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
+        }
+        std::vector<NewDevice*> colididos;
+        for (NewDevice* dispositivo : pendentes)
+        {
+            // o perfil já passou pelo parser uma vez, passa de novo
+            if (dispositivo->registered == 0 && PrepareDevice(*dispositivo))
+            {
+                colididos.push_back(dispositivo);
+            }
+        }
+        pendentes = std::move(colididos);
+    }
+
+    std::vector<NewDevice*> novos;
+    for (NewDevice* dispositivo : validos)
+    {
+        if (dispositivo->registered == dispositivo->id)
+        {
+            IndexDevice(*dispositivo);
+            novos.push_back(dispositivo);
+        }
+    }
+    if (m_stateGraphs && !novos.empty())
+    {
+        SeedState(novos);
+    }
+    for (NewDevice* dispositivo : novos)
+    {
+        co_await IndexObject(dispositivo->id, dispositivo->text);
+    }
+    m_tenant->subscriptions += validos.size();
+
+    // ids na ordem das entradas, null nas que falharam
+    nlohmann::json ids = nlohmann::json::array();
+    for (auto& dispositivo : dispositivos)
+    {
+        ids.push_back(dispositivo.registered ? nlohmann::json(dispositivo.registered)
+                                             : nlohmann::json(nullptr));
+    }
+    NS_LOG_INFO("[CoTaS] Inscrição em lote de " << validos.size() << " dispositivos vindos de "
+                                                << InetSocketAddress::ConvertFrom(from).GetIpv4());
+    co_return {{"status", COAP_RESPONSE_CODE_CREATED}, {"ids", ids}, {"errors", erros}};
+}
+
+CotasTask
+CoTaS::HandleUpdate([[maybe_unused]] Address from, std::string body)
+{   
+
+    nlohmann::json payload = nlohmann::json::parse(body, nullptr, false);
+    // NS_LOG_INFO("[CoTaS] payload em json que chegou: " << payload.dump() );
+
+    // tipos conferidos antes de qualquer get<>
+    if (!payload.is_object() || !payload.contains("objectId") ||
+        !payload["objectId"].is_number_integer())
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                   {"error", "\"objectId\" must be an integer"}};
+    }
+    for (auto coordenada : {"localization.latitude", "localization.longitude"})
+    {
+        if (payload.contains(coordenada) && !payload[coordenada].is_number())
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                       {"error", std::string("\"") + coordenada + "\" must be a number"}};
+        }
+    }
+    
+    int32_t id = payload["objectId"];
+    if (m_hotKeys > 0)
+    {
+        m_tenant->hotObjects.Add(std::to_string(id));
+    }
+
+    // propriedade que só o modelo tem não é da instância: o banco não
+    // teria o que trocar e o cliente receberia 2.04 sem mudança nenhuma
+    auto instancia = m_tenant->instances.find(id);
+    auto modelo = instancia == m_tenant->instances.end()
+                      ? m_tenant->models.end()
+                      : m_tenant->models.find(instancia->second);
+    if (modelo != m_tenant->models.end())
+    {
+        for (auto& [chave, valor] : payload.items())
+        {
+            if (modelo->second.properties.count(chave.substr(0, chave.find_first_of("./"))))
+            {
+                co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                           {"error", "\"" + chave + "\" is held by " + modelo->first}};
+            }
+        }
+    }
+
+    // updates do mesmo objeto passam um de cada vez, na ordem de chegada:
+    // um que espera o banco não é ultrapassado pelo seguinte
+    co_await UpdateTurn{this, id, nullptr, Seconds(0)};
+    UpdateTurnGuard vez{this, m_tenant, id};
+
+    // dispositivo com linha na tabela quente já foi validado na inscrição
+    bool quente = !m_flushInterval.IsZero() && m_tenant->stateTable.Contains(id);
+
+    if (!quente && !co_await Step([this, id] { return ValidateID_Q(id); }))
+    {
+        // id inválido
+        NS_LOG_INFO("[CoTaS] ID inválido, enviando mensagem de não autorizado");
+        co_return {{"status", COAP_RESPONSE_CODE_UNAUTHORIZED}};
+    }
+
+    // valores numéricos ficam na tabela até o próximo flush,
+    // o resto segue direto para o banco
+    nlohmann::json banco = payload;
+    if (quente)
+    {
+        for (auto& [chave, valor] : payload.items())
+        {
+            if (chave != "objectId" && valor.is_number())
+            {
+                banco.erase(chave);
+            }
+        }
+    }
+    if (!quente || banco.size() > 1)
+    {
+        // os grafos são lidos antes da etapa e mudados depois dela
+        StoreWrite escrita = PrepareUpdate({banco});
+        bool ok = co_await Step([this, &escrita] { return SendUpdate(escrita); });
+        CommitUpdate(escrita);
+        if (!ok)
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}};
+        }
+    }
+
+    // só o que o banco aceitou chega à memória: com a escrita recusada
+    // as buscas, o /history e o índice espacial seguem com o valor antigo
+    double agora = Simulator::Now().GetSeconds();
+    for (auto& [chave, valor] : payload.items())
+    {
+        if (chave == "objectId" || !valor.is_number())
+        {
+            continue;
+        }
+        // o último valor fica na tabela para ir junto nas buscas
+        if (quente)
+        {
+            m_tenant->stateTable.Set(id, chave, valor.get<double>(), agora);
+        }
+        else
+        {
+            m_tenant->stateTable.Load(id, chave, valor.get<double>(), agora);
+        }
+        if (m_bitmapIndex && m_booleanStates.count(chave))
+        {
+            m_tenant->categories.SetState(id, chave, valor.get<double>() != 0);
+        }
+        m_tenant->rangeIndex.Update(id, chave, valor.get<double>());
+        if (m_historyEnabled)
+        {
+            CotasTimeSeries& serie = m_tenant->history[{id, chave}];
+            serie.Append(Simulator::Now().GetMilliSeconds(), valor.get<double>());
+            if (!m_historyRetention.IsZero())
+            {
+                serie.Trim((Simulator::Now() - m_historyRetention).GetMilliSeconds());
+            }
+        }
+    }
+
+    // mantém o índice espacial em dia
+    if (payload.contains("localization.latitude") || payload.contains("localization.longitude"))
+    {
+        double x = 0;
+        double y = 0;
+        bool conhecido = m_tenant->spatialIndex.Get(id, x, y);
+        if (payload.contains("localization.longitude"))
+        {
+            x = payload["localization.longitude"].get<double>();
+        }
+        if (payload.contains("localization.latitude"))
+        {
+            y = payload["localization.latitude"].get<double>();
+        }
+        // só indexa quando as duas coordenadas são conhecidas
+        if (conhecido || (payload.contains("localization.latitude") &&
+                          payload.contains("localization.longitude")))
+        {
+            m_tenant->spatialIndex.Update(id, x, y);
+        }
+    }
+
+    // com a camada quente os valores da tabela só chegam
+    // no banco no flush, que confere as consultas de novo;
+    // turnedOn é lido da tabela e já vale agora
+    nlohmann::json mudou = banco;
+    if (payload.contains("turnedOn"))
+    {
+        mudou["turnedOn"] = payload["turnedOn"];
+    }
+    co_await RefreshStandingQueries(id, mudou);
+
+    co_return {{"status", COAP_RESPONSE_CODE_CHANGED}};
+}
+
+CotasTask
+CoTaS::HandleRequest(Address from, std::string payload)
+{
+    // NS_LOG_INFO("[CoTaS] chegou uma requisição de uma aplicação ");
+
+    nlohmann::json response;
+    std::ostringstream sparql_query;
+    uint32_t limite = 1;
+    // chaves cujo último valor vai junto na resposta
+    std::vector<std::string> projecao;
+    // objectId -> distância, quando a consulta passou pelo índice espacial
+    std::unordered_map<int32_t, double> distancias;
+    // política de escolha entre os objetos encontrados
+    CotasSelectionPolicy::Type politica = PolicyFor(from);
+    std::string chave = payload;
+    uint32_t cliente = InetSocketAddress::ConvertFrom(from).GetIpv4().Get();
+    // restrições resolvidas em memória, conferidas de novo no resultado
+    CotasBitmap filtro;
+    bool porBitmap = false;
+    std::vector<int32_t> faixa;
+    bool porFaixa = false;
+
+    // Prepara a consulta
+    if (CotasQuery::IsStructured(payload))
+    {
+        // {"queryId": N} é respondido pelo resultado mantido em memória
+        nlohmann::json mensagem = nlohmann::json::parse(payload, nullptr, false);
+        if (!mensagem.is_object())
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}, {"error", "invalid JSON"}};
+        }
+        if (mensagem.size() == 1 && mensagem.contains("queryId") &&
+            mensagem["queryId"].is_number_unsigned())
+        {
+            co_return HandleStandingRequest(from, mensagem["queryId"]);
+        }
+
+        // consulta estruturada: valida antes de chegar no fuseki
+        CotasQuery query;
+        std::string erro;
+        if (!CotasQuery::Parse(mensagem, query, erro))
+        {
+            NS_LOG_INFO("[CoTaS] Consulta rejeitada: " << erro);
+            response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}, {"error", erro}};
+            co_return response;
+        }
+        if (m_hotKeys > 0)
+        {
+            m_tenant->hotQueries.Add(query.Shape());
+        }
+        if (query.Cost() > m_maxQueryCost)
+        {
+            NS_LOG_INFO("[CoTaS] Consulta rejeitada por custo: " << query.Cost());
+            response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                        {"error", "query too expensive"}};
+            co_return response;
+        }
+
+        limite = query.m_limit;
+        projecao = query.m_project;
+        chave = query.Key();
+        std::vector<int32_t> candidatos;
+
+        // predicados de faixa saem do índice ordenado
+        porFaixa = RangeFilter(query, faixa);
+        if (porFaixa && faixa.empty())
+        {
+            response = {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+            co_return response;
+        }
+        if (porFaixa && !m_bitmapIndex && !query.IsSpatial() &&
+            faixa.size() <= MAX_CANDIDATOS_BITMAP)
+        {
+            candidatos = faixa;
+        }
+
+        // classe, usedFor e estados booleanos saem dos bitmaps,
+        // o fuseki só vê o que sobrar
+        if (m_bitmapIndex)
+        {
+            porBitmap = true;
+            filtro = BitmapFilter(query);
+            if (porFaixa)
+            {
+                CotasBitmap naFaixa;
+                for (int32_t id : faixa)
+                {
+                    uint32_t ordinal;
+                    if (m_tenant->categories.Ordinal(id, ordinal))
+                    {
+                        naFaixa.Add(ordinal);
+                    }
+                }
+                filtro &= naFaixa;
+            }
+            if (filtro.Empty())
+            {
+                response = {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+                co_return response;
+            }
+            if (!query.IsSpatial() && query.m_predicates.empty())
+            {
+                co_return AnswerFromBitmap(filtro,
+                                        politica,
+                                        chave,
+                                        cliente,
+                                        limite,
+                                        query.m_project);
+            }
+            if (!query.IsSpatial() && filtro.Cardinality() <= MAX_CANDIDATOS_BITMAP)
+            {
+                for (uint32_t ordinal : filtro.ToVector())
+                {
+                    candidatos.push_back(m_tenant->categories.Get(ordinal).id);
+                }
+            }
+        }
+
+        if (query.IsSpatial())
+        {
+            // o índice resolve a parte espacial, o fuseki
+            // só confere os candidatos
+            CotasSpatialIndex::Result proximos;
+            if (!SpatialCandidates(query, proximos))
+            {
+                response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                            {"error", "unknown zone: " + query.m_zone}};
+                co_return response;
+            }
+            if (proximos.empty())
+            {
+                response = {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+                co_return response;
+            }
+            for (auto& [id, distancia] : proximos)
+            {
+                if (!Allowed(id, porBitmap ? &filtro : nullptr, porFaixa ? &faixa : nullptr))
+                {
+                    continue;
+                }
+                candidatos.push_back(id);
+                distancias[id] = distancia;
+            }
+            if (candidatos.empty())
+            {
+                response = {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+                co_return response;
+            }
+        }
+
+        sparql_query << "SELECT DISTINCT ?id ?ip ?port "
+                     << "WHERE { "
+                     << query.ToSparqlWhere(candidatos, m_stateGraphs)
+                     << " " << TurnedOnPattern()
+                     << "}";
+        // com índice espacial a ordem é por distância, então o
+        // limite só é aplicado depois de ordenar; as outras políticas
+        // precisam de mais opções que o limite para escolher. Sem
+        // VALUES o que veio dos índices só é conferido no resultado,
+        // então o fuseki não pode cortar. Com a tabela quente o
+        // turnedOn também só é conferido no resultado: qualquer corte
+        // podia deixar só desligados
+        if (candidatos.empty() && !porBitmap && !porFaixa && m_flushInterval.IsZero())
+        {
+            sparql_query << " LIMIT "
+                         << (politica == CotasSelectionPolicy::FIRST
+                                 ? limite
+                                 : std::max(limite, MAX_OPCOES_POLITICA));
+        }
+    }
+    else
+    {
+        if (m_hotKeys > 0)
+        {
+            m_tenant->hotQueries.Add(CotasQuery::FragmentShape(payload));
+        }
+        sparql_query << "SELECT ?id ?ip ?port "
+                     << "WHERE { "
+                     << "?device cot:objectId ?id . "
+                     << "?device cot:ipAddress ?ip . "
+                     << "?device cot:instanceOf?/cot:port ?port . "
+                     << TurnedOnPattern()
+                     << payload 
+                     << " }";
+    }
+
+    PendingSearch busca;
+    busca.select = sparql_query.str();
+    busca.limit = limite;
+    busca.project = std::move(projecao);
+    busca.distances = std::move(distancias);
+    busca.policy = politica;
+    busca.key = chave;
+    busca.client = cliente;
+    busca.bitmap = std::move(filtro);
+    busca.byBitmap = porBitmap;
+    busca.range = std::move(faixa);
+    busca.byRange = porFaixa;
+
+    // no lote a resposta sai depois, quando a consulta combinada voltar
+    if (!m_batchWindow.IsZero())
+    {
+        busca.request = m_request;
+        busca.token = m_requestToken;
+        busca.deadline = m_requestDeadline;
+        EnqueueSearch(std::move(busca));
+        co_return nullptr;
+    }
+
+    // envia a query para o fuseki, buscas iguais em andamento
+    // dividem a mesma execução
+    nlohmann::json linhas = co_await SharedSelect(SparqlPrefix() + busca.select);
+    if (linhas.is_null())
+    {
+        response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}};
+        co_return response;
+    }
+    co_return AnswerSearch(busca, linhas);
+}
+
+nlohmann::json
+CoTaS::AnswerSearch(const PendingSearch& busca, const nlohmann::json& bindings)
+{
+    if (bindings.empty()) 
+    {
+        // NS_LOG_INFO("[CoTaS] Nenhum objeto encontrado");
+        return {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+    }
+
+    // NS_LOG_INFO("[CoTaS] bindings " << bindings.dump());
+
+    // Itera sobre cada "linha" de resultado
+    std::vector<nlohmann::json> objetos;
+    std::vector<CotasSelectionPolicy::Candidate> opcoes;
+    for (const auto& item : bindings) 
+    {
+        // Pega o valor da variável "?device"
+        std::string raw_ip = item["ip"]["value"];
+        uint32_t ip = std::stoi(raw_ip);
+        
+        std::string raw_port = item["port"]["value"];
+        uint32_t port = std::stoi(raw_port);
+        
+        int32_t id = std::stoi(item["id"]["value"].get<std::string>());
+        if (!m_flushInterval.IsZero() && !m_tenant->stateTable.Matches(id, "turnedOn", 1))
+        {
+            continue; // desligado segundo a tabela quente
+        }
+        if (!Allowed(id,
+                     busca.byBitmap ? &busca.bitmap : nullptr,
+                     busca.byRange ? &busca.range : nullptr))
+        {
+            continue; // fora do que os índices aceitaram
+        }
+        nlohmann::json objeto = {{"ip", ip}, {"port", port}};
+        auto distancia = busca.distances.find(id);
+        if (distancia != busca.distances.end())
+        {
+            objeto["distance"] = distancia->second;
+        }
+        objetos.push_back(objeto);
+        opcoes.push_back({id, ip, opcoes.size()});
+
+        // NS_LOG_INFO("[CoTaS] Dispositivo de IP: " << ip 
+        //             << " e de porta " << port 
+        //             << " sendo enviado para aplicação");
+        if (busca.limit == 1 && busca.distances.empty() &&
+            busca.policy == CotasSelectionPolicy::FIRST)
+        {
+            break; // retorna só o primeiro
+        }
+    }
+
+    return SelectResults(objetos,
+                         opcoes,
+                         busca.policy,
+                         busca.key,
+                         busca.client,
+                         busca.limit,
+                         !busca.distances.empty(),
+                         busca.project);
+}
+
+void
+CoTaS::EnqueueSearch(PendingSearch busca)
+{
+    m_tenant->batch.push_back(std::move(busca));
+    if (m_tenant->batch.size() >= m_maxBatchSize)
+    {
+        m_tenant->batchEvent.Cancel();
+        RunBatch(m_tenant->name);
+    }
+    else if (m_tenant->batch.size() == 1)
+    {
+        // a janela começa com a primeira busca do lote
+        m_tenant->batchEvent =
+            Simulator::Schedule(m_batchWindow, [this, nome = m_tenant->name]() {
+                RunBatch(nome);
+            });
+    }
+}
+
+// uma consulta só para o lote todo: cada busca vira um ramo do UNION
+// marcado por ?qid, e as linhas voltam para quem pediu pelo ?qid
+CotasTask
+CoTaS::RunBatch(std::string tenant)
+{
+    // o lote não herda o prazo da busca que o completou
+    m_tenant = &m_tenants[tenant];
+    m_requestDeadline = Seconds(0);
+    std::vector<PendingSearch> lote;
+    lote.swap(m_tenant->batch);
+
+    // buscas cujo cliente desistiu na janela saem antes da consulta
+    auto vencidas = std::remove_if(lote.begin(), lote.end(), [this](const PendingSearch& busca) {
+        return Expired(busca.deadline);
+    });
+    m_tenant->expired += lote.end() - vencidas;
+    lote.erase(vencidas, lote.end());
+    if (lote.empty())
+    {
+        co_return nullptr;
+    }
+
+    std::vector<nlohmann::json> respostas(lote.size());
+    std::vector<nlohmann::json> grupos(lote.size(), nlohmann::json::array());
+    bool combinada = false;
+    if (lote.size() > 1)
+    {
+        std::ostringstream sparql;
+        sparql << SparqlPrefix() << "SELECT ?qid ?id ?ip ?port WHERE { ";
+        for (size_t qid = 0; qid < lote.size(); qid++)
+        {
+            sparql << (qid ? " UNION " : "") << "{ VALUES ?qid { " << qid << " } { "
+                   << lote[qid].select << " } }";
+        }
+        sparql << " }";
+
+        nlohmann::json linhas = co_await SharedSelect(sparql.str());
+        if (!linhas.is_null())
+        {
+            for (const auto& item : linhas)
+            {
+                size_t qid = std::stoul(item["qid"]["value"].get<std::string>());
+                if (qid < grupos.size())
+                {
+                    grupos[qid].push_back(item);
+                }
+            }
+            combinada = true;
+            m_tenant->batches++;
+        }
+    }
+
+    for (size_t qid = 0; qid < lote.size(); qid++)
+    {
+        if (!combinada)
+        {
+            // sozinha ou o lote falhou: um fragmento ruim não
+            // derruba as outras buscas
+            nlohmann::json linhas = co_await SharedSelect(SparqlPrefix() + lote[qid].select);
+            if (linhas.is_null())
+            {
+                respostas[qid] = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}};
+                continue;
+            }
+            grupos[qid] = std::move(linhas);
+        }
+        respostas[qid] = AnswerSearch(lote[qid], grupos[qid]);
+    }
+
+    // as etapas do banco já passaram o tempo que levaram
+    for (size_t qid = 0; qid < lote.size(); qid++)
+    {
+        PendingSearch& busca = lote[qid];
+        if (Expired(busca.deadline))
+        {
+            m_tenant->expired++;
+            continue;
+        }
+        SendReply(busca.request, EncodeReply(respostas[qid], busca.token), Seconds(0));
+    }
+    co_return nullptr;
+}
+
+CotasTask
+CoTaS::SharedSelect(std::string sparql)
+{
+    // já há uma execução igual no banco: espera por ela
+    auto voo = m_tenant->flights.find(sparql);
+    if (m_singleFlight && voo != m_tenant->flights.end())
+    {
+        m_tenant->collapsed++;
+        co_return co_await FlightWait{this, voo->second};
+    }
+
+    // registrada antes da chamada, para quem chegar enquanto ela roda
+    std::shared_ptr<Flight> proprio;
+    if (m_singleFlight && m_tenant->flights.size() < MAX_VOOS)
+    {
+        proprio = std::make_shared<Flight>();
+        m_tenant->flights[sparql] = proprio;
+    }
+    Tenant* tenant = m_tenant;
+    nlohmann::json linhas =
+        co_await Step([this, sparql] { return StoreSelect(sparql); }, proprio != nullptr);
+
+    if (proprio)
+    {
+        // uma escrita pode ter tirado o voo do mapa, e outro igual já
+        // pode ter entrado no lugar
+        auto atual = tenant->flights.find(sparql);
+        if (atual != tenant->flights.end() && atual->second == proprio)
+        {
+            tenant->flights.erase(atual);
+        }
+        proprio->bindings = linhas;
+        for (std::coroutine_handle<> handle : proprio->waiters)
+        {
+            Resume(handle, Seconds(0));
+        }
+    }
+    co_return linhas;
+}
+
+nlohmann::json
+CoTaS::StoreSelect(const std::string& sparql)
+{
+    httplib::Params params;
+    params.emplace("query", sparql);
+    httplib::Headers headers = {{"Accept", "application/sparql-results+json"}};
+    auto res = StorePost(StorePath("query"), headers, params);
+    if (!res || res->status != httplib::OK_200)
+    {
+        return nullptr;
+    }
+    nlohmann::json j = nlohmann::json::parse(res->body, nullptr, false);
+    if (!j.contains("results") || !j["results"].contains("bindings") ||
+        !j["results"]["bindings"].is_array())
+    {
+        return nullptr;
+    }
+    return std::move(j["results"]["bindings"]);
+}
+
+httplib::Result
+CoTaS::StorePost(const std::string& path, const std::string& body, const std::string& contentType)
+{
+    return StoreSend(false, path, {}, body, contentType, true);
+}
+
+httplib::Result
+CoTaS::StorePost(const std::string& path,
+                 const httplib::Headers& headers,
+                 const httplib::Params& params)
+{
+    return StoreSend(false,
+                     path,
+                     headers,
+                     httplib::detail::params_to_query_str(params),
+                     "application/x-www-form-urlencoded",
+                     false);
+}
+
+httplib::Result
+CoTaS::StorePut(const std::string& path, const std::string& body, const std::string& contentType)
+{
+    return StoreSend(true, path, {}, body, contentType, true);
+}
+
+httplib::Result
+CoTaS::StoreSend(bool put,
+                 const std::string& path,
+                 httplib::Headers headers,
+                 std::string body,
+                 const std::string& contentType,
+                 bool compressible)
+{
+    auto juntar = [](std::string& destino) {
+        return [&destino](const char* dados, size_t tamanho) {
+            destino.append(dados, tamanho);
+            return true;
+        };
+    };
+
+    m_storeTraffic.sent += body.size();
+    if (m_storeCompression)
+    {
+        headers.emplace("Accept-Encoding", "gzip, deflate");
+        // atualizações pequenas custam mais para comprimir do que economizam
+        std::string comprimido;
+        httplib::detail::gzip_compressor compressor;
+        if (compressible && body.size() >= m_storeCompressionMin &&
+            compressor.compress(body.data(), body.size(), true, juntar(comprimido)) &&
+            comprimido.size() < body.size())
+        {
+            body = std::move(comprimido);
+            headers.emplace("Content-Encoding", "gzip");
+        }
+    }
+    m_storeTraffic.sentWire += body.size();
+
+    httplib::Client& cliente = s_storeClient ? *s_storeClient : *m_cli;
+    auto res = put ? cliente.Put(path, headers, body, contentType)
+                   : cliente.Post(path, headers, body, contentType);
+    if (!res)
+    {
+        return res;
+    }
+
+    m_storeTraffic.receivedWire += res->body.size();
+    std::string codificacao = res->get_header_value("Content-Encoding");
+    if (codificacao == "gzip" || codificacao == "deflate")
+    {
+        // o zlib reconhece os dois formatos pelo cabeçalho do corpo
+        std::string descomprimido;
+        httplib::detail::gzip_decompressor descompressor;
+        if (descompressor.is_valid() &&
+            descompressor.decompress(res->body.data(), res->body.size(), juntar(descomprimido)))
+        {
+            res->body = std::move(descomprimido);
+            res->headers.erase("Content-Encoding");
+        }
+        else
+        {
+            NS_LOG_INFO("[CoTaS] Resposta do banco em " << codificacao << " corrompida");
+        }
+    }
+    m_storeTraffic.received += res->body.size();
+    return res;
+}
+
+nlohmann::json
+CoTaS::SelectResults(std::vector<nlohmann::json> objetos,
+                     std::vector<CotasSelectionPolicy::Candidate> opcoes,
+                     CotasSelectionPolicy::Type politica,
+                     const std::string& chave,
+                     uint32_t cliente,
+                     uint32_t limite,
+                     bool espacial,
+                     const std::vector<std::string>& projecao)
+{
+    nlohmann::json response;
+
+    if (opcoes.empty())
+    {
+        // nenhum dos encontrados está ligado
+        return {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+    }
+
+    if (espacial)
+    {
+        // a distância manda, a política não reordena
+        std::stable_sort(opcoes.begin(),
+                         opcoes.end(),
+                         [&objetos](const CotasSelectionPolicy::Candidate& a,
+                                    const CotasSelectionPolicy::Candidate& b) {
+                             return objetos[a.index]["distance"].get<double>() <
+                                    objetos[b.index]["distance"].get<double>();
+                         });
+    }
+    else
+    {
+        m_tenant->selection.Order(politica, chave, cliente, opcoes);
+    }
+    if (opcoes.size() > limite)
+    {
+        opcoes.resize(limite);
+    }
+
+    std::vector<nlohmann::json> escolhidos;
+    for (auto& opcao : opcoes)
+    {
+        escolhidos.push_back(objetos[opcao.index]);
+        // com os valores na resposta o cliente não precisa ir ao objeto
+        if (!projecao.empty())
+        {
+            escolhidos.back()["context"] = m_tenant->stateTable.Project(opcao.id, projecao);
+        }
+    }
+    objetos.swap(escolhidos);
+
+    // o cliente passa a usar o primeiro
+    m_tenant->selection.Assign(cliente,
+                       chave,
+                       opcoes.front().id,
+                       Simulator::Now().GetSeconds());
+
+    response = {{"status", COAP_RESPONSE_CODE_CONTENT}};
+    PackResults(response, objetos, limite);
+    return response;
+}
+
+void
+CoTaS::PackResults(nlohmann::json& response, std::vector<nlohmann::json>& objetos, uint32_t limite)
+{
+    if (limite == 1)
+    {
+        response["response"] = std::move(objetos.front());
+        return;
+    }
+
+    // a lista vai até onde a pdu deixa; o tamanho de cada item é o que
+    // ele ocupa no dump final, mais a vírgula
+    response["results"] = nlohmann::json::array();
+    size_t tamanho = response.dump().size() + std::string(",\"truncated\":true").size();
+    for (auto& objeto : objetos)
+    {
+        size_t item = objeto.dump().size() + 1;
+        if (tamanho + item > MAX_PAYLOAD)
+        {
+            response["truncated"] = true;
+            return;
+        }
+        tamanho += item;
+        response["results"].push_back(std::move(objeto));
+    }
+}
+
+CotasTask
+CoTaS::RegisterStandingQuery(nlohmann::json consulta)
+{
+    StandingQuery view;
+    std::string erro;
+    if (consulta.is_object())
+    {
+        view.structured = true;
+        if (!CotasQuery::Parse(consulta, view.query, erro))
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}, {"error", erro}};
+        }
+        if (view.query.IsSpatial())
+        {
+            // a posição muda a todo momento, fica com a busca normal
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                       {"error", "spatial queries can not be registered"}};
+        }
+        if (view.query.Cost() > m_maxQueryCost)
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                       {"error", "query too expensive"}};
+        }
+        view.key = view.query.Key();
+    }
+    else if (consulta.is_string())
+    {
+        view.fragment = consulta.get<std::string>();
+        view.key = view.fragment;
+    }
+    else
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                   {"error", "\"query\" must be a structured query or a SPARQL fragment"}};
+    }
+
+    // aplicações com a mesma consulta dividem o resultado
+    ExpireStandingQueries();
+    auto existente = m_tenant->standingIds.find(view.key);
+    if (existente != m_tenant->standingIds.end())
+    {
+        m_tenant->standingQueries[existente->second].used = Simulator::Now();
+        co_return {{"queryId", existente->second}};
+    }
+    if (m_tenant->standingQueries.size() >= MAX_STANDING_QUERIES)
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE},
+                   {"error", "too many standing queries"}};
+    }
+
+    std::string sparql = StandingSparql(view, {});
+    nlohmann::json linhas = co_await Step([this, sparql] { return StoreSelect(sparql); });
+    if (linhas.is_null())
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR}, {"error", "store error"}};
+    }
+
+    // quem registrou a mesma consulta enquanto esta esperava já criou o id
+    existente = m_tenant->standingIds.find(view.key);
+    if (existente != m_tenant->standingIds.end())
+    {
+        m_tenant->standingQueries[existente->second].used = Simulator::Now();
+        co_return {{"queryId", existente->second}};
+    }
+    if (m_tenant->standingQueries.size() >= MAX_STANDING_QUERIES)
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE},
+                   {"error", "too many standing queries"}};
+    }
+    ApplyStandingResults(view, linhas, {});
+    view.used = Simulator::Now();
+    uint32_t queryId = m_tenant->nextQueryId++;
+    m_tenant->standingIds[view.key] = queryId;
+    m_tenant->standingQueries[queryId] = std::move(view);
+    co_return {{"queryId", queryId}};
+}
+
+void
+CoTaS::ExpireStandingQueries()
+{
+    // sem cancelamento de inscrição, o desuso é o que libera a consulta
+    for (auto it = m_tenant->standingQueries.begin(); it != m_tenant->standingQueries.end();)
+    {
+        if (Simulator::Now() - it->second.used > m_standingTimeout)
+        {
+            m_tenant->standingIds.erase(it->second.key);
+            it = m_tenant->standingQueries.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+std::string
+CoTaS::StandingSparql(const StandingQuery& view, const std::vector<int32_t>& ids)
+{
+    std::ostringstream sparql_query;
+    sparql_query << SparqlPrefix() << "SELECT DISTINCT ?id ?ip ?port WHERE { ";
+    if (view.structured)
+    {
+        sparql_query << view.query.ToSparqlWhere(ids, m_stateGraphs);
+    }
+    else
+    {
+        if (!ids.empty())
+        {
+            sparql_query << "VALUES ?id {";
+            for (int32_t id : ids)
+            {
+                sparql_query << " " << id;
+            }
+            sparql_query << " } ";
+        }
+        sparql_query << "?device cot:objectId ?id . "
+                     << "?device cot:ipAddress ?ip . "
+                     << "?device cot:instanceOf?/cot:port ?port . " << view.fragment;
+    }
+    // cot:turnedOn fica de fora, é conferido na tabela ao guardar e ao responder
+    sparql_query << " }";
+    return sparql_query.str();
+}
+
+void
+CoTaS::ApplyStandingResults(StandingQuery& view,
+                            const nlohmann::json& bindings,
+                            const std::vector<int32_t>& ids)
+{
+    // só os ids conferidos podem entrar ou sair
+    if (ids.empty())
+    {
+        view.results.clear();
+    }
+    for (int32_t id : ids)
+    {
+        view.results.erase(id);
+    }
+    for (const auto& item : bindings)
+    {
+        int32_t id = std::stoi(item["id"]["value"].get<std::string>());
+        if (!m_tenant->stateTable.Matches(id, "turnedOn", 1))
+        {
+            continue; // desligado segundo a tabela
+        }
+        uint32_t ip = std::stoi(item["ip"]["value"].get<std::string>());
+        uint32_t port = std::stoi(item["port"]["value"].get<std::string>());
+        view.results[id] = {{"ip", ip}, {"port", port}};
+    }
+}
+
+CotasTask
+CoTaS::RefreshStandingQueries(int32_t id, nlohmann::json changed)
+{
+    // as consultas podem mudar enquanto uma espera o banco, então
+    // guarda só os ids e procura de novo depois de cada etapa
+    ExpireStandingQueries();
+    // ligar ou desligar mexe em todas as consultas; desligado sai sem
+    // passar pelo banco, ligado precisa ser conferido de novo
+    bool ligou = false;
+    if (changed.is_object() && changed.contains("turnedOn"))
+    {
+        ligou = m_tenant->stateTable.Matches(id, "turnedOn", 1);
+    }
+    std::vector<uint32_t> afetadas;
+    for (auto& [queryId, view] : m_tenant->standingQueries)
+    {
+        // sem chaves é objeto novo, confere todas as consultas
+        bool afetada = changed.is_null();
+        for (auto& [chave, valor] : changed.items())
+        {
+            if (afetada || chave == "objectId")
+            {
+                continue;
+            }
+            if (chave == "turnedOn")
+            {
+                afetada = ligou;
+                if (!ligou)
+                {
+                    view.results.erase(id);
+                }
+                continue;
+            }
+            if (!view.structured)
+            {
+                afetada = true; // fragmento pode depender de qualquer chave
+            }
+            for (auto& predicado : view.query.m_predicates)
+            {
+                afetada = afetada || predicado.path == chave;
+            }
+        }
+        if (afetada)
+        {
+            afetadas.push_back(queryId);
+        }
+    }
+
+    for (uint32_t queryId : afetadas)
+    {
+        auto view = m_tenant->standingQueries.find(queryId);
+        if (view == m_tenant->standingQueries.end())
+        {
+            continue;
+        }
+        // a escrita já foi feita: o resultado acompanha mesmo com o prazo vencido
+        std::string sparql = StandingSparql(view->second, {id});
+        nlohmann::json linhas =
+            co_await Step([this, sparql] { return StoreSelect(sparql); }, true);
+        view = m_tenant->standingQueries.find(queryId);
+        if (linhas.is_null())
+        {
+            NS_LOG_INFO("[CoTaS] Erro ao avaliar consulta permanente " << queryId);
+        }
+        else if (view != m_tenant->standingQueries.end())
+        {
+            ApplyStandingResults(view->second, linhas, {id});
+        }
+    }
+    co_return nullptr;
+}
+
+nlohmann::json
+CoTaS::HandleStandingRequest(Address from, uint32_t queryId)
+{
+    auto it = m_tenant->standingQueries.find(queryId);
+    if (it == m_tenant->standingQueries.end())
+    {
+        return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}, {"error", "unknown queryId"}};
+    }
+    StandingQuery& view = it->second;
+    view.used = Simulator::Now();
+
+    std::vector<nlohmann::json> objetos;
+    std::vector<CotasSelectionPolicy::Candidate> opcoes;
+    for (auto& [id, objeto] : view.results)
+    {
+        if (m_tenant->stateTable.Matches(id, "turnedOn", 1))
+        {
+            opcoes.push_back({id, objeto["ip"].get<uint32_t>(), objetos.size()});
+            objetos.push_back(objeto);
+        }
+    }
+    return SelectResults(objetos,
+                         opcoes,
+                         PolicyFor(from),
+                         view.key,
+                         InetSocketAddress::ConvertFrom(from).GetIpv4().Get(),
+                         view.structured ? view.query.m_limit : 1,
+                         false,
+                         view.query.m_project);
+}
+
+// {"objectId": 3, "key": "temperature", "from": 0, "to": 60, "step": 10},
+// tempos em segundos; sem "step" devolve as amostras
+nlohmann::json
+CoTaS::HandleHistory([[maybe_unused]] Address from, const std::string& body)
+{
+    nlohmann::json payload = nlohmann::json::parse(body, nullptr, false);
+    if (!payload.is_object() || !payload.contains("objectId") ||
+        !payload["objectId"].is_number_integer() || !payload.contains("key") ||
+        !payload["key"].is_string())
+    {
+        return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                {"error", "\"objectId\" and \"key\" are required"}};
+    }
+    for (auto campo : {"from", "to", "step"})
+    {
+        if (payload.contains(campo) && !payload[campo].is_number())
+        {
+            return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST},
+                    {"error", std::string("\"") + campo + "\" must be a number"}};
+        }
+    }
+
+    auto it = m_tenant->history.find({payload["objectId"].get<int32_t>(),
+                              payload["key"].get<std::string>()});
+    if (it == m_tenant->history.end())
+    {
+        return {{"status", COAP_RESPONSE_CODE_NOT_FOUND}};
+    }
+
+    int64_t inicio = Seconds(payload.value("from", 0.0)).GetMilliSeconds();
+    int64_t fim = payload.contains("to") ? Seconds(payload["to"].get<double>()).GetMilliSeconds()
+                                         : Simulator::Now().GetMilliSeconds();
+    int64_t passo = Seconds(payload.value("step", 0.0)).GetMilliSeconds();
+
+    // rollup: [início, amostras, mínimo, máximo, média]; amostras: [tempo, valor]
+    const char* campo = passo > 0 ? "rollup" : "samples";
+    nlohmann::json response = {{"status", COAP_RESPONSE_CODE_CONTENT}};
+    response[campo] = nlohmann::json::array();
+
+    // a resposta cabe num pacote, o cliente continua a partir do último
+    // ponto; o tamanho de cada ponto é o do dump final, mais a vírgula
+    size_t tamanho = response.dump().size() + std::string(",\"truncated\":true").size();
+    auto cabe = [&tamanho](const nlohmann::json& ponto) {
+        size_t item = ponto.dump().size() + 1;
+        if (tamanho + item > MAX_PAYLOAD)
+        {
+            return false;
+        }
+        tamanho += item;
+        return true;
+    };
+
+    nlohmann::json& pontos = response[campo];
+    bool truncado = false;
+    if (passo > 0)
+    {
+        for (auto& b : it->second.Rollup(inicio, fim, passo))
+        {
+            nlohmann::json ponto = {b.start / 1000.0, b.count, b.min, b.max, b.sum / b.count};
+            if (!cabe(ponto))
+            {
+                truncado = true;
+                break;
+            }
+            pontos.push_back(std::move(ponto));
+        }
+    }
+    else
+    {
+        for (auto& [instante, valor] : it->second.Range(inicio, fim))
+        {
+            nlohmann::json ponto = {instante / 1000.0, valor};
+            if (!cabe(ponto))
+            {
+                truncado = true;
+                break;
+            }
+            pontos.push_back(std::move(ponto));
+        }
+    }
+
+    if (truncado)
+    {
+        response["truncated"] = true;
+    }
+    return response;
+}
+
+// classes e contextos vem do grafo com inferência, uma vez por inscrição
+CotasTask
+CoTaS::IndexCategories(int id, std::string payload)
+{
+    if (m_tenant->categories.Contains(id))
+    {
+        co_return nullptr;
+    }
+
+    std::ostringstream sparql_query;
+    sparql_query << SparqlPrefix()
+                 << "SELECT DISTINCT ?ip ?port ?class ?context WHERE { "
+                 << "?device cot:objectId " << id << " . "
+                 << "?device cot:ipAddress ?ip . "
+                 << "?device cot:instanceOf?/cot:port ?port . "
+                 << "?device a ?class . FILTER (isIRI(?class)) "
+                 << "OPTIONAL { ?class cot:usedFor ?context . } }";
+
+    // a inscrição já está no banco: o índice acompanha mesmo com o prazo vencido
+    std::string sparql = sparql_query.str();
+    nlohmann::json linhas = co_await Step([this, sparql] { return StoreSelect(sparql); }, true);
+    if (linhas.is_null())
+    {
+        NS_LOG_INFO("[CoTaS] Erro ao indexar categorias de " << id);
+        co_return nullptr;
+    }
+    // outro pedido pode ter indexado o objeto enquanto este esperava
+    if (linhas.empty() || m_tenant->categories.Contains(id))
+    {
+        co_return nullptr;
+    }
+
+    auto nome = [](const nlohmann::json& termo) -> std::string {
+        std::string iri = termo["value"];
+        return iri.rfind(COT_NS, 0) == 0 ? "cot:" + iri.substr(COT_NS.size()) : "";
+    };
+
+    for (const auto& item : linhas)
+    {
+        m_tenant->categories.Add(id,
+                         std::stoul(item["ip"]["value"].get<std::string>()),
+                         std::stoul(item["port"]["value"].get<std::string>()));
+        std::string classe = nome(item["class"]);
+        if (!classe.empty())
+        {
+            m_tenant->categories.AddClass(id, classe);
+        }
+        if (item.contains("context"))
+        {
+            std::string contexto = nome(item["context"]);
+            if (!contexto.empty())
+            {
+                m_tenant->categories.AddUsedFor(id, contexto);
+            }
+        }
+    }
+
+    // estados booleanos que o perfil já traz
+    m_tenant->categories.SetState(id, "turnedOn", ProfileTurnedOn(payload));
+    for (auto& chave : m_booleanStates)
+    {
+        std::smatch encontrado;
+        if (chave != "turnedOn" &&
+            std::regex_search(payload, encontrado, std::regex("cot:" + chave + "\\s+([01])\\b")))
+        {
+            m_tenant->categories.SetState(id, chave, encontrado[1].str() == "1");
+        }
+    }
+    co_return nullptr;
+}
+
+CotasBitmap
+CoTaS::BitmapFilter(CotasQuery& query)
+{
+    CotasBitmap filtro = m_tenant->categories.State("turnedOn", true);
+    if (!query.m_classes.empty())
+    {
+        filtro &= m_tenant->categories.Classes(query.m_classes);
+    }
+    if (!query.m_usedFor.empty())
+    {
+        filtro &= m_tenant->categories.UsedFor(query.m_usedFor);
+    }
+
+    // igualdade em estado booleano também sai do bitmap
+    auto& predicados = query.m_predicates;
+    for (auto it = predicados.begin(); it != predicados.end();)
+    {
+        bool booleano = m_booleanStates.count(it->path) &&
+                        (it->op == CotasQuery::EQ || it->op == CotasQuery::NE) &&
+                        it->value.is_number_integer() && (it->value == 0 || it->value == 1);
+        if (!booleano)
+        {
+            it++;
+            continue;
+        }
+        bool valor = (it->value == 1) == (it->op == CotasQuery::EQ);
+        filtro &= m_tenant->categories.State(it->path, valor);
+        it = predicados.erase(it);
+    }
+    return filtro;
+}
+
+nlohmann::json
+CoTaS::AnswerFromBitmap(const CotasBitmap& filtro,
+                        CotasSelectionPolicy::Type politica,
+                        const std::string& chave,
+                        uint32_t cliente,
+                        uint32_t limite,
+                        const std::vector<std::string>& projecao)
+{
+    // a política só precisa de algumas opções
+    size_t maximo =
+        politica == CotasSelectionPolicy::FIRST ? limite : std::max(limite, MAX_OPCOES_POLITICA);
+
+    std::vector<nlohmann::json> objetos;
+    std::vector<CotasSelectionPolicy::Candidate> opcoes;
+    for (uint32_t ordinal : filtro.ToVector())
+    {
+        if (opcoes.size() >= maximo)
+        {
+            break;
+        }
+        const CotasCategoryIndex::Device& objeto = m_tenant->categories.Get(ordinal);
+        opcoes.push_back({objeto.id, objeto.ip, objetos.size()});
+        objetos.push_back({{"ip", objeto.ip}, {"port", objeto.port}});
+    }
+    return SelectResults(objetos, opcoes, politica, chave, cliente, limite, false, projecao);
+}
+
+// valores iniciais das propriedades indexadas vem do perfil no banco
+CotasTask
+CoTaS::IndexRanges(int id)
+{
+    std::vector<std::string> chaves = m_tenant->rangeIndex.Keys();
+
+    std::ostringstream sparql_query;
+    sparql_query << SparqlPrefix() << "SELECT * WHERE { ?device cot:objectId " << id << " . ";
+    std::vector<std::string> variaveis;
+    for (size_t i = 0; i < chaves.size(); i++)
+    {
+        std::string padrao;
+        variaveis.push_back(
+            CotasQuery::PathPattern(chaves[i], "?device", "?r" + std::to_string(i), padrao));
+        sparql_query << "OPTIONAL { " << padrao << "} ";
+    }
+    sparql_query << "} LIMIT 1";
+
+    std::string sparql = sparql_query.str();
+    nlohmann::json linhas = co_await Step([this, sparql] { return StoreSelect(sparql); }, true);
+    if (linhas.is_null())
+    {
+        NS_LOG_INFO("[CoTaS] Erro ao indexar faixas de " << id);
+        co_return nullptr;
+    }
+    if (linhas.empty())
+    {
+        co_return nullptr;
+    }
+
+    const auto& linha = linhas[0];
+    for (size_t i = 0; i < chaves.size(); i++)
+    {
+        std::string variavel = variaveis[i].substr(1);
+        if (!linha.contains(variavel))
+        {
+            continue;
+        }
+        try
+        {
+            std::string valor = linha[variavel]["value"];
+            m_tenant->rangeIndex.Update(id, chaves[i], std::stod(valor));
+        }
+        catch (const std::exception&)
+        {
+            // valor não numérico, fica fora do índice
+        }
+    }
+    co_return nullptr;
+}
+
+bool
+CoTaS::RangeFilter(CotasQuery& query, std::vector<int32_t>& ids)
+{
+    bool usado = false;
+    auto& predicados = query.m_predicates;
+    for (auto it = predicados.begin(); it != predicados.end();)
+    {
+        if (!m_tenant->rangeIndex.Indexes(it->path) || !it->value.is_number())
+        {
+            it++;
+            continue;
+        }
+        std::vector<int32_t> faixa =
+            m_tenant->rangeIndex.Range(it->path, it->op, it->value.get<double>());
+        if (!usado)
+        {
+            ids = std::move(faixa);
+        }
+        else
+        {
+            std::vector<int32_t> intersecao;
+            std::set_intersection(ids.begin(),
+                                  ids.end(),
+                                  faixa.begin(),
+                                  faixa.end(),
+                                  std::back_inserter(intersecao));
+            ids.swap(intersecao);
+        }
+        usado = true;
+        it = predicados.erase(it);
+    }
+    return usado;
+}
+
+bool
+CoTaS::Allowed(int32_t id, const CotasBitmap* filtro, const std::vector<int32_t>* faixa)
+{
+    uint32_t ordinal;
+    if (filtro && !(m_tenant->categories.Ordinal(id, ordinal) && filtro->Contains(ordinal)))
+    {
+        return false;
+    }
+    return !faixa || std::binary_search(faixa->begin(), faixa->end(), id);
+}
+
+nlohmann::json
+CoTaS::HandleBadRequest()
+{
+    nlohmann::json response;
+    response = {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}};
+    return response;
+}
+
+void
+CoTaS::SetupDatabase(){
+
+    // le os dados do primeiro arquivo
+    std::string payload;
+    std::vector<std::string> arquivos;
+
+    payload = ReadFile("definition.ttl");
+    
+    // primeiro arquivo
+    if (auto res = StorePut(StorePath("data?default"), payload, "text/turtle;charset=utf-8")) 
+    {
+        NS_LOG_INFO("[CoTaS] Arquivo definition.ttl" << res->status << "\n" 
+                    << res->get_header_value("Content-Type") << "\n" 
+                    << res->body);
+    } else 
+    {
+        NS_LOG_INFO("[CoTaS] error code: " << res.error());
+    }
+
+    // restante dos arquivos
+    arquivos = {"application.ttl", "context.ttl",
+                "object.ttl", "unit.ttl"}; 
+    
+    for(auto nome_arquivo : arquivos){
+        payload = ReadFile(nome_arquivo);
+        if (auto res = StorePost(StorePath("data?default"), payload, "text/turtle;charset=utf-8")) 
+        {
+            NS_LOG_INFO("[CoTaS] Arquivo" << nome_arquivo << res->status << "\n" 
+                        << res->get_header_value("Content-Type") << "\n" 
+                        << res->body);
+        } else 
+        {
+            NS_LOG_INFO("[CoTaS] error code: " << res.error());
+        }
     }
 }
 
@@ -520,7 +2639,7 @@ CoTaS::Simple_Q()
         };
 
         // envia a query para o fuseki
-        auto res = m_cli.Post("/dataset/query", headers, params);
+        auto res = StorePost(StorePath("query"), headers, params);
         
         if (res && res->status == httplib::OK_200) 
         {
@@ -555,37 +2674,38 @@ CoTaS::Simple_Q()
             }
         } else 
         {
-            NS_LOG_INFO("[CoTaS] Erro na requisição, status:" << res->status << 
-                "\n cabeçalho:" << res->get_header_value("Content-Type") << 
-                "\n corpo:" << res->body);
+            // sem resposta (erro de conexão) não há status nem corpo
+            if (res)
+            {
+                NS_LOG_INFO("[CoTaS] Erro na requisição, status:" << res->status << 
+                    "\n cabeçalho:" << res->get_header_value("Content-Type") << 
+                    "\n corpo:" << res->body);
+            }
             NS_LOG_INFO("[CoTaS] error code: " << res.error());
         }
     }
     catch (const std::exception& e)
     {
+        // o daemon segue servindo: a falha vira "id não encontrado"
         NS_LOG_INFO("[CoTaS] Exceção: " << e.what());
-        abort();
         return 0;
     }
     return 0;
 }
 
-// se não existe ip com isso no banco retorna 0
-// se existe retorna id
+// se o id já existe, ele retorna o próprio id
+// se não, retorna 0
 int
-CoTaS::ValidateIP_Q(Address ip)
-{
+CoTaS::ValidateID_Q(int id)
+{   
     try
     {
         // fazer requisição de dados no fuseki
 
-        uint32_t ip_num = InetSocketAddress::ConvertFrom(ip).GetIpv4().Get();
-
         std::ostringstream sparql_stream;
         sparql_stream << SparqlPrefix()
-                      << "SELECT ?device ?id WHERE { "
-                      << "  ?device cot:ipAddress " << ip_num << " . "
-                      << "  ?device cot:objectId ?id ."
+                      << "SELECT ?device WHERE { "
+                      << "  ?device cot:objectId " << id << " . "
                       << "}";
         std::string sparql_query = sparql_stream.str();
 
@@ -597,7 +2717,7 @@ CoTaS::ValidateIP_Q(Address ip)
         };
 
         // envia a query para o fuseki
-        auto res = m_cli.Post("/dataset/query", headers, params);
+        auto res = StorePost(StorePath("query"), headers, params);
         
         if (res && res->status == httplib::OK_200) 
         {
@@ -605,31 +2725,18 @@ CoTaS::ValidateIP_Q(Address ip)
             {
                 // Parse da string da resposta para um objeto JSON
                 nlohmann::json j = nlohmann::json::parse(res->body);
+                // NS_LOG_INFO("[CoTaS] json que chegou do fuseki: (ID)" << j.dump());
 
                 const auto& bindings = j["results"]["bindings"];
 
                 if (bindings.empty()) 
                 {
-                    // NS_LOG_INFO("[CoTaS] Nenhum resultado encontrado para o IP: " << ip_num );
+                    // NS_LOG_INFO("[CoTaS] Nenhum resultado encontrado para o ID: " << id );
                     return 0;
                 } else 
                 {
-                    // NS_LOG_INFO("[CoTaS] Resultados encontrados: ");
-                    // NS_LOG_INFO("[CoTaS] bindings " << bindings.dump());
-                    // Itera sobre cada "linha" de resultado
-                    // aqui é pra ter só um 
-                    // não há iteração
-                    for (const auto& item : bindings) 
-                    {
-                        // Pega o valor da variável "?device"
-                        std::string raw_id = item["id"]["value"];
-                        int id = std::stoi(raw_id);
-
-                        // NS_LOG_INFO("[CoTaS] Dispositivo de IP: " << ip_num 
-                        //             << "já cadastrado com id" << id 
-                        //             << ", reenviando");
-                        return id;
-                    }
+                    // NS_LOG_INFO("[CoTaS] Dispositivo já registrado " << bindings.dump());
+                    return id;
                 }
             } catch (const nlohmann::json::parse_error& e) 
             {
@@ -639,155 +2746,745 @@ CoTaS::ValidateIP_Q(Address ip)
             }
         } else 
         {
-            NS_LOG_INFO("[CoTaS] Erro na requisição, status:" << res->status << 
-                "\n cabeçalho:" << res->get_header_value("Content-Type") << 
-                "\n corpo:" << res->body);
+            // sem resposta (erro de conexão) não há status nem corpo
+            if (res)
+            {
+                NS_LOG_INFO("[CoTaS] Erro na requisição, status:" << res->status << 
+                    "\n cabeçalho:" << res->get_header_value("Content-Type") << 
+                    "\n corpo:" << res->body);
+            }
             NS_LOG_INFO("[CoTaS] error code: " << res.error());
         }
     }
     catch (const std::exception& e)
     {
+        // o daemon segue servindo: a falha vira "id não encontrado"
         NS_LOG_INFO("[CoTaS] Exceção: " << e.what());
-        abort();
         return 0;
     }
-
     return 0;
 }
 
-// se o id já existe, ele retorna o próprio id
-// se não, retorna 0
-int
-CoTaS::ValidateID_Q(int id)
-{   
-    try
+bool
+CoTaS::RegisterDevices_Q(const std::vector<NewDevice*>& devices)
+{
+    // só insere se o ip ainda não tem dispositivo e o id está livre;
+    // o fuseki avalia e insere na mesma transação, então retransmissões
+    // e inscrições simultâneas não duplicam o dispositivo. As operações
+    // de um pedido rodam em ordem numa transação só, então um ip repetido
+    // no lote também fica com um dispositivo
+    std::ostringstream sparql;
+    std::ostringstream ips;
+    sparql << SparqlPrefix();
+    for (size_t i = 0; i < devices.size(); i++)
     {
-        // fazer requisição de dados no fuseki
+        const NewDevice& dispositivo = *devices[i];
 
-        std::ostringstream sparql_stream;
-        sparql_stream << SparqlPrefix()
-                      << "SELECT ?device WHERE { "
-                      << "  ?device cot:objectId " << id << " . "
-                      << "}";
-        std::string sparql_query = sparql_stream.str();
+        // triplas do grafo já analisado mais o id e o ip, em N-Triples:
+        // nada do texto do cliente entra na atualização
+        const std::string& sujeito = dispositivo.graph.Subject();
+        std::string triplas = dispositivo.graph.NTriples();
+        for (auto [nome, valor] : {std::pair<const char*, int64_t>{"objectId", dispositivo.id},
+                                   {"ipAddress", dispositivo.ip}})
+        {
+            triplas += sujeito + " <" + COT_NS + nome + "> \"" + std::to_string(valor) +
+                       "\"^^<http://www.w3.org/2001/XMLSchema#integer> .\n";
+        }
 
-        httplib::Params params;
-        params.emplace("query", sparql_query);
+        sparql << (i ? " ;\n" : "") << "INSERT { " << triplas << "} WHERE { "
+               << "FILTER NOT EXISTS { ?outro cot:ipAddress " << dispositivo.ip << " } "
+               << "FILTER NOT EXISTS { ?outro cot:objectId " << dispositivo.id << " } }";
+        ips << dispositivo.ip << " ";
+    }
 
-        httplib::Headers headers = {
-            { "Accept", "application/sparql-results+json" }
-        };
+    // NS_LOG_INFO("[CoTaS] Payload pós tratamento: " << sparql.str());
 
-        // envia a query para o fuseki
-        auto res = m_cli.Post("/dataset/query", headers, params);
-        
-        if (res && res->status == httplib::OK_200) 
+    auto res = StorePost(StorePath("update"), sparql.str(), "application/sparql-update");
+    if (!res || (res->status != 200 && res->status != 204))
+    {
+        NS_LOG_INFO("[CoTaS] Erro na inscrição no fuseki");
+        if (res)
         {
-            try 
+            NS_LOG_INFO("[CoTaS] status: " << res->status << "\n" << res->body);
+        }
+        return false;
+    }
+
+    // lê de volta quem ficou com cada ip, fora do single-flight:
+    // uma leitura anterior ao insert não serve
+    std::ostringstream leitura;
+    leitura << SparqlPrefix() << "SELECT ?id ?ip WHERE { VALUES ?ip { " << ips.str() << "} "
+            << "?device cot:ipAddress ?ip . "
+            << "?device cot:objectId ?id . }";
+    httplib::Params params;
+    params.emplace("query", leitura.str());
+    httplib::Headers headers = {{"Accept", "application/sparql-results+json"}};
+    res = StorePost(StorePath("query"), headers, params);
+    if (!res || res->status != httplib::OK_200)
+    {
+        NS_LOG_INFO("[CoTaS] Erro na leitura da inscrição");
+        return false;
+    }
+    nlohmann::json j = nlohmann::json::parse(res->body, nullptr, false);
+    if (j.is_discarded())
+    {
+        NS_LOG_ERROR("Resposta recebida: " << res->body);
+        return false;
+    }
+
+    std::unordered_map<uint32_t, std::vector<int32_t>> porIp;
+    for (const auto& item : j["results"]["bindings"])
+    {
+        porIp[std::stoul(item["ip"]["value"].get<std::string>())].push_back(
+            std::stoi(item["id"]["value"].get<std::string>()));
+    }
+
+    // o nosso id na resposta quer dizer que o insert aconteceu; sem ele
+    // o ip já estava inscrito (ou o id colidiu, e a resposta vem vazia)
+    for (NewDevice* dispositivo : devices)
+    {
+        const std::vector<int32_t>& encontrados = porIp[dispositivo->ip];
+        dispositivo->registered = 0;
+        for (int32_t encontrado : encontrados)
+        {
+            if (encontrado == dispositivo->id || !dispositivo->registered)
             {
-                // Parse da string da resposta para um objeto JSON
-                nlohmann::json j = nlohmann::json::parse(res->body);
-                // NS_LOG_INFO("[CoTaS] json que chegou do fuseki: (ID)" << j.dump());
+                dispositivo->registered = encontrado;
+            }
+        }
+    }
+    return true;
+}
 
-                const auto& bindings = j["results"]["bindings"];
+bool
+CoTaS::ModelInfo_Q(const std::string& model, Model& info)
+{
+    std::ostringstream sparql;
+    sparql << SparqlPrefix() << "SELECT DISTINCT ?class ?property WHERE { { " << model
+           << " a ?class . FILTER (STRSTARTS(STR(?class), \"" << COT_NS << "\")) } UNION { "
+           << model << " ?property ?valor . "
+           << "FILTER (STRSTARTS(STR(?property), \"" << COT_NS << "\")) } }";
+    httplib::Params params;
+    params.emplace("query", sparql.str());
+    httplib::Headers headers = {{"Accept", "application/sparql-results+json"}};
+    auto res = StorePost(StorePath("query"), headers, params);
+    if (!res || res->status != httplib::OK_200)
+    {
+        NS_LOG_INFO("[CoTaS] Erro ao ler as classes do modelo " << model);
+        return false;
+    }
+    nlohmann::json j = nlohmann::json::parse(res->body, nullptr, false);
+    if (j.is_discarded())
+    {
+        NS_LOG_ERROR("Resposta recebida: " << res->body);
+        return false;
+    }
+    info = Model{};
+    for (const auto& item : j["results"]["bindings"])
+    {
+        if (item.contains("class"))
+        {
+            std::string iri = item["class"]["value"];
+            info.classes.push_back("cot:" + iri.substr(COT_NS.size()));
+        }
+        if (item.contains("property"))
+        {
+            std::string iri = item["property"]["value"];
+            info.properties.insert(iri.substr(COT_NS.size()));
+        }
+    }
+    return true;
+}
 
-                if (bindings.empty()) 
-                {
-                    // NS_LOG_INFO("[CoTaS] Nenhum resultado encontrado para o ID: " << id );
-                    return 0;
-                } else 
+bool
+CoTaS::RegisterModel_Q(const std::string& model, const std::string& turtle)
+{
+    // duas primeiras unidades ao mesmo tempo não duplicam o modelo
+    std::ostringstream sparql;
+    sparql << SparqlPrefix() << "INSERT { " << turtle << " } WHERE { "
+           << "FILTER NOT EXISTS { " << model << " a ?classe } }";
+    auto res = StorePost(StorePath("update"), sparql.str(), "application/sparql-update");
+    if (!res || (res->status != 200 && res->status != 204))
+    {
+        NS_LOG_INFO("[CoTaS] Erro ao guardar o modelo " << model);
+        return false;
+    }
+    return true;
+}
+
+int
+CoTaS::RandomInt(int min, int max)
+{
+    static std::random_device rd;
+    static std::mt19937 gen(rd());
+
+    std::uniform_int_distribution<> distrib(min, max);
+
+    return distrib(gen);
+}
+
+void
+CoTaS::StartHandlerDict(){
+    // os handlers são corrotinas membro: a lambda só as chama,
+    // nada dela precisa viver até o handler terminar
+    m_handlerDict["/subscribe/object"] = [this](Address from, std::string payload) {
+        return this->SubscribeObject(from, std::move(payload));
+    };
+
+    m_handlerDict["/subscribe/bulk"] = [this](Address from, std::string payload) {
+        return this->SubscribeBulk(from, std::move(payload));
+    };
+
+    m_handlerDict["/subscribe/application"] = [this](Address from, std::string payload) {
+        return this->HandleApplicationSubscription(from, std::move(payload));
+    };
+
+    m_handlerDict["/update/object"] = [this](Address from, std::string payload) {
+        m_tenant->updates++;
+        return this->HandleUpdate(from, std::move(payload));
+    };
+
+    m_handlerDict["/search"] = [this](Address from, std::string payload) {
+        m_tenant->searches++;
+        return this->HandleRequest(from, std::move(payload));
+    };
+
+    m_handlerDict["/history"] = [this](Address from, std::string payload) {
+        return CotasTask::Ready(this->HandleHistory(from, payload));
+    };
+
+    m_handlerDict["/federation/digest"] = [this](Address from, std::string payload) {
+        return CotasTask::Ready(this->HandleDigest(from, payload));
+    };
+
+    m_handlerDict["/search/federated"] = [this](Address from, std::string payload) {
+        m_tenant->federated++;
+        return this->HandleFederatedSearch(from, std::move(payload));
+    };
+}
+
+void
+CoTaS::EndUpdate(Tenant* tenant, int32_t id)
+{
+    auto fila = tenant->updating.find(id);
+    if (fila == tenant->updating.end())
+    {
+        return;
+    }
+    if (fila->second.empty())
+    {
+        tenant->updating.erase(fila);
+        return;
+    }
+    // a vez passa ao próximo update do objeto, que segue num evento
+    std::coroutine_handle<> proximo = fila->second.front();
+    fila->second.pop_front();
+    Resume(proximo, Seconds(0));
+}
+
+void
+CoTaS::Resume(std::coroutine_handle<> handle, Time delay, bool measured)
+{
+    Simulator::Schedule(measured ? ModelledDelay(delay) : delay, [this, handle]() {
+        handle.resume();
+        // o prazo era do handler que rodou, não de quem vem depois
+        m_requestDeadline = Seconds(0);
+    });
+}
+
+void
+CoTaS::SubmitStep(Tenant* tenant, std::function<void()> work, std::coroutine_handle<> handle)
+{
+    m_storePool.Submit([this, tenant, work = std::move(work), handle](httplib::Client& cliente) {
+        s_storeTenant = tenant;
+        s_storeClient = &cliente;
+        try
+        {
+            work();
+        }
+        catch (const std::exception& e)
+        {
+            // o resultado fica vazio, que o handler trata como falha
+            NS_LOG_INFO("[CoTaS] Exceção na chamada ao banco: " << e.what());
+        }
+        s_storeTenant = nullptr;
+        s_storeClient = nullptr;
+        // o handler só volta a rodar na thread do simulador
+        Simulator::ScheduleWithContext(Simulator::NO_CONTEXT, Seconds(0), [this, handle]() {
+            Resume(handle, Seconds(0));
+        });
+    });
+}
+
+bool
+CoTaS::Expired(Time deadline) const
+{
+    return !deadline.IsZero() && Simulator::Now() >= deadline;
+}
+
+CoTaS::StoreWrite
+CoTaS::PrepareUpdate(const std::vector<nlohmann::json>& payloads)
+{
+    // constroi mensagem, várias atualizações vão numa requisição só
+    // com grafos de estado o raciocinador não roda a cada atualização
+    StoreWrite escrita;
+    escrita.state = m_stateGraphs;
+    // valores com nó conhecido viram troca de triplas no patch,
+    // o resto segue no SPARQL
+    for (auto& payload : payloads)
+    {
+        escrita.state = escrita.state && payload.contains("objectId");
+        nlohmann::json resto = payload;
+        auto grafo = m_tenant->graphs.end();
+        if (!escrita.state && m_patchUpdates && payload.contains("objectId"))
+        {
+            grafo = m_tenant->graphs.find(payload["objectId"].get<int32_t>());
+        }
+        if (grafo != m_tenant->graphs.end())
+        {
+            for (auto& [chave, valor] : payload.items())
+            {
+                CotasDeviceGraph::Change troca;
+                if (chave != "objectId" &&
+                    grafo->second.Patch(chave, valor, escrita.patch, troca))
                 {
-                    // NS_LOG_INFO("[CoTaS] Dispositivo já registrado " << bindings.dump());
-                    return id;
+                    escrita.changes.emplace_back(grafo->first, std::move(troca));
+                    resto.erase(chave);
                 }
-            } catch (const nlohmann::json::parse_error& e) 
+            }
+            if (resto.size() <= 1)
             {
-                NS_LOG_ERROR("Erro no parse da resposta JSON: " << e.what());
-                NS_LOG_ERROR("Resposta recebida: " << res->body);
-                return 0;
+                continue;
             }
-        } else 
+        }
+        if (!escrita.sparql.empty())
+        {
+            escrita.sparql += " ;\n";
+        }
+        escrita.sparql +=
+            escrita.state ? JsonToStateUpdate(resto) : JsonToSparqlUpdateParser(resto);
+    }
+    return escrita;
+}
+
+bool
+CoTaS::SendUpdate(StoreWrite& write)
+{
+    if (!write.patch.empty())
+    {
+        auto res = StorePost(StorePath("patch"), "TX .\n" + write.patch + "TC .\n",
+                             "application/rdf-patch");
+        if (!res || (res->status != 200 && res->status != 204))
+        {
+            NS_LOG_INFO("[CoTaS] Erro no patch");
+            if (res)
+            {
+                NS_LOG_INFO("[CoTaS] Status: " << res->status << " Body: " << res->body);
+            }
+            return false;
+        }
+        write.patched = true;
+    }
+    if (write.sparql.empty())
+    {
+        return true;
+    }
+    
+    // NS_LOG_INFO("[CoTaS] ultima query obtida: \n" << write.sparql);
+
+    // envia consulta para o fuseki
+    auto res = StorePost(write.state ? StorePath("update", true) : StorePath("update"),
+                         write.sparql,
+                         "application/sparql-update");
+
+    if (res && (res->status == 200 || res->status == 204)) {
+        // NS_LOG_INFO("[CoTaS] DADOS ATUALIZADOS COM SUCESSO!");
+        return true;
+    }
+
+    // se deu erro
+    NS_LOG_INFO("[CoTaS] Erro na atualizacao");
+    if (res) {
+        NS_LOG_INFO("[CoTaS] Status: " << res->status << " Body: " << res->body);
+        
+    } else {
+        NS_LOG_INFO("[CoTaS] Erro de conexao: " << httplib::to_string(res.error()));
+    }
+    return false;
+}
+
+void
+CoTaS::CommitUpdate(const StoreWrite& write)
+{
+    // o patch já está no banco mesmo que o SPARQL tenha falhado depois
+    if (!write.patched)
+    {
+        return;
+    }
+    for (auto& [id, troca] : write.changes)
+    {
+        auto grafo = m_tenant->graphs.find(id);
+        if (grafo != m_tenant->graphs.end())
+        {
+            grafo->second.Commit(troca);
+        }
+    }
+}
+
+CotasTask
+CoTaS::FlushState()
+{
+    // um flush por casa de cada vez: o seguinte montaria o patch sobre
+    // grafos que este ainda não atualizou
+    if (m_tenant->flushing)
+    {
+        co_return nullptr;
+    }
+    CotasStateTable::Batch lote = m_tenant->stateTable.TakeDirty();
+    if (lote.empty())
+    {
+        co_return nullptr;
+    }
+
+    std::vector<nlohmann::json> payloads;
+    for (auto& [id, payload] : lote)
+    {
+        payloads.push_back(payload);
+    }
+    m_tenant->flushing = true;
+    StoreWrite escrita = PrepareUpdate(payloads);
+    bool ok = co_await Step([this, &escrita] { return SendUpdate(escrita); }, true);
+    m_tenant->flushing = false;
+    CommitUpdate(escrita);
+    if (ok)
+    {
+        m_tenant->flights.clear();
+        for (auto& [id, payload] : lote)
+        {
+            // roda em segundo plano, o flush não espera o banco
+            RefreshStandingQueries(id, payload);
+        }
+    }
+    else
+    {
+        // volta a marcar para tentar no próximo flush
+        for (auto& [id, payload] : lote)
+        {
+            for (auto& [chave, valor] : payload.items())
+            {
+                double v;
+                double instante;
+                if (chave != "objectId" && m_tenant->stateTable.Get(id, chave, v, instante))
+                {
+                    m_tenant->stateTable.Set(id, chave, v, instante);
+                }
+            }
+        }
+    }
+    co_return nullptr;
+}
+
+void
+CoTaS::ScheduleFlush()
+{
+    for (auto& [nome, tenant] : m_tenants)
+    {
+        m_tenant = &tenant;
+        FlushState();
+    }
+    m_flushEvent = Simulator::Schedule(m_flushInterval, &CoTaS::ScheduleFlush, this);
+}
+
+void
+CoTaS::SendDigests()
+{
+    for (auto& [nome, tenant] : m_tenants)
+    {
+        // as classes já vêm inferidas do banco, então a busca por uma
+        // superclasse também passa pelo resumo
+        CotasBloomFilter resumo(m_digestBits);
+        for (auto& classe : tenant.categories.ClassNames())
+        {
+            resumo.Add(classe);
+        }
+        for (auto& contexto : tenant.categories.UsedForNames())
         {
-            NS_LOG_INFO("[CoTaS] Erro na requisição, status:" << res->status << 
-                "\n cabeçalho:" << res->get_header_value("Content-Type") << 
-                "\n corpo:" << res->body);
-            NS_LOG_INFO("[CoTaS] error code: " << res.error());
+            resumo.Add("usedFor:" + contexto);
         }
+        nlohmann::json mensagem = {{"tenant", nome},
+                                   {"devices", tenant.categories.All().Cardinality()},
+                                   {"hashes", resumo.Hashes()},
+                                   {"digest", resumo.ToHex()}};
+
+        encoded_data data_pdu =
+            EncodePduRequest("/federation/digest", COAP_REQUEST_CODE_POST, mensagem.dump());
+        if (data_pdu.size == 0)
+        {
+            NS_LOG_WARN("[CoTaS] resumo de " << nome << " não coube na pdu");
+            continue;
+        }
+        m_transport->Send(m_upstream,
+                          std::string(reinterpret_cast<const char*>(data_pdu.buffer),
+                                      data_pdu.size));
+        m_send_messages++;
     }
-    catch (const std::exception& e)
-    {
-        NS_LOG_INFO("[CoTaS] Exceção: " << e.what());
-        abort();
-        return 0;
-    }
-    return 0;
+    m_digestEvent = Simulator::Schedule(m_digestInterval, &CoTaS::SendDigests, this);
 }
 
-int
-CoTaS::InsertDataSub_Q(int id, Address ip, std::string payload)
+nlohmann::json
+CoTaS::HandleDigest(Address from, const std::string& payload)
 {
-    uint32_t ip_num = InetSocketAddress::ConvertFrom(ip).GetIpv4().Get();
+    nlohmann::json mensagem = nlohmann::json::parse(payload, nullptr, false);
+    FederatedHome casa;
+    if (!mensagem.is_object() || !mensagem["tenant"].is_string() ||
+        !mensagem["devices"].is_number_unsigned() || !mensagem["hashes"].is_number_unsigned() ||
+        mensagem["hashes"] > 16 || !mensagem["digest"].is_string() ||
+        !CotasBloomFilter::FromHex(mensagem["digest"],
+                                   mensagem["hashes"].get<uint8_t>(),
+                                   casa.digest))
+    {
+        return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}, {"error", "invalid digest"}};
+    }
+    casa.address = from;
+    casa.tenant = mensagem["tenant"];
+    casa.devices = mensagem["devices"];
+    casa.seen = Simulator::Now();
 
-    // trata payload adicionando id e ip
-    std::string idip = " cot:objectId " + std::to_string(id) + 
-                       "; cot:ipAddress " + std::to_string(ip_num) + " ; .";
-    
-    // adiciona os prefixos necessários 
+    std::ostringstream nome;
+    nome << InetSocketAddress::ConvertFrom(from).GetIpv4() << "/" << casa.tenant;
+    m_tenant->homes[nome.str()] = std::move(casa);
+    return {{"status", COAP_RESPONSE_CODE_CHANGED}};
+}
 
-    // junta tudo
-    payload.erase(payload.find_last_of("."));
-    payload = payload+idip;
-    payload = SparqlPrefix()+payload;
+CotasTask
+CoTaS::HandleFederatedSearch([[maybe_unused]] Address from, std::string payload)
+{
+    CotasQuery query;
+    bool estruturada = CotasQuery::IsStructured(payload);
+    if (estruturada)
+    {
+        std::string erro;
+        nlohmann::json mensagem = nlohmann::json::parse(payload, nullptr, false);
+        if (mensagem.is_discarded() || !CotasQuery::Parse(mensagem, query, erro))
+        {
+            co_return {{"status", COAP_RESPONSE_CODE_BAD_REQUEST}, {"error", erro}};
+        }
+    }
 
-    // NS_LOG_INFO("[CoTaS] Payload pós tratamento: " << payload);
+    // só vai às casas que podem ter uma das classes e um dos contextos;
+    // busca em fragmento SPARQL não diz o que procura, vai a todas
+    auto algum = [](const CotasBloomFilter& resumo,
+                    const std::vector<std::string>& nomes,
+                    const std::string& prefixo) {
+        return nomes.empty() || std::any_of(nomes.begin(), nomes.end(), [&](auto& nome) {
+                   return resumo.MayContain(prefixo + nome);
+               });
+    };
+    FederationStep etapa{this, {}, "", {}, nullptr, Seconds(0)};
+    std::vector<std::string> nomes;
+    for (auto& [nome, casa] : m_tenant->homes)
+    {
+        // casa que parou de mandar resumos ficou fora
+        bool ativa = Simulator::Now() - casa.seen <= m_digestInterval * 3 && casa.devices > 0;
+        if (!ativa || (estruturada && (!algum(casa.digest, query.m_classes, "") ||
+                                       !algum(casa.digest, query.m_usedFor, "usedFor:"))))
+        {
+            continue;
+        }
+        etapa.homes.push_back(casa);
+        nomes.push_back(nome);
+    }
+    if (etapa.homes.empty())
+    {
+        co_return {{"status", COAP_RESPONSE_CODE_NOT_FOUND}, {"homes", 0}};
+    }
+    m_tenant->forwarded += etapa.homes.size();
+    etapa.payload = std::move(payload);
+    std::vector<nlohmann::json> respostas = co_await etapa;
 
-    if (auto res = m_cli.Post("/dataset/data?default", payload, "text/turtle;charset=utf-8")) 
+    std::vector<nlohmann::json> objetos;
+    bool truncado = false;
+    for (size_t i = 0; i < respostas.size(); i++)
     {
-        if(res->status != 200){
-            NS_LOG_INFO("\n" << payload << "\n");
-            NS_LOG_INFO("[CoTaS] ======\nDEU PAU AQUI\n======");
-            NS_LOG_INFO("[CoTaS] Inseriu dados no fuseki? " << res->status << "\n" 
-                << res->get_header_value("Content-Type") << "\n" 
-                << res->body);
+        nlohmann::json& resposta = respostas[i];
+        if (!resposta.is_object() || resposta["status"] != COAP_RESPONSE_CODE_CONTENT)
+        {
+            continue;
         }
-    } else 
+        truncado = truncado || resposta.value("truncated", false);
+        nlohmann::json lista = resposta.contains("results")
+                                   ? resposta["results"]
+                                   : nlohmann::json::array({resposta["response"]});
+        for (auto& objeto : lista)
+        {
+            objeto["home"] = nomes[i];
+            objetos.push_back(std::move(objeto));
+        }
+    }
+    if (objetos.empty())
     {
-        NS_LOG_INFO("[CoTaS] ======\nDEU PAU AQUI\n======");
-        NS_LOG_INFO("[CoTaS] Erro na inserção de dados no fuseki");
-        NS_LOG_INFO("[CoTaS] error code: " << res.error());
+        co_return {{"status", COAP_RESPONSE_CODE_NOT_FOUND}, {"homes", respostas.size()}};
     }
 
-    return 0;
+    // cada casa já ordenou as suas; por distância dá para juntar todas
+    uint32_t limite = estruturada ? query.m_limit : 1;
+    if (estruturada && query.m_near)
+    {
+        std::stable_sort(objetos.begin(), objetos.end(), [](auto& a, auto& b) {
+            return a.value("distance", 0.0) < b.value("distance", 0.0);
+        });
+    }
+    if (objetos.size() > limite)
+    {
+        objetos.resize(limite);
+    }
+    nlohmann::json response = {{"status", COAP_RESPONSE_CODE_CONTENT},
+                               {"homes", respostas.size()}};
+    if (truncado)
+    {
+        response["truncated"] = true;
+    }
+    PackResults(response, objetos, limite);
+    co_return response;
 }
 
-int
-CoTaS::RandomInt(int min, int max)
+void
+CoTaS::Forward(FederationStep& step, std::coroutine_handle<> handle)
 {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
+    uint32_t numero = m_nextCall++;
+    FederatedCall& chamada = m_federatedCalls[numero];
+    chamada.handle = handle;
+    chamada.replies = &step.replies;
+    chamada.pending = step.homes.size();
+    step.replies.assign(step.homes.size(), nullptr);
 
-    std::uniform_int_distribution<> distrib(min, max);
+    for (size_t i = 0; i < step.homes.size(); i++)
+    {
+        // token: número da chamada e índice da casa, 4 + 2 bytes
+        std::string token;
+        for (int deslocamento = 24; deslocamento >= 0; deslocamento -= 8)
+        {
+            token += static_cast<char>((numero >> deslocamento) & 0xff);
+        }
+        token += static_cast<char>((i >> 8) & 0xff);
+        token += static_cast<char>(i & 0xff);
 
-    return distrib(gen);
+        std::vector<std::pair<uint16_t, std::string>> opcoes;
+        if (!step.homes[i].tenant.empty())
+        {
+            opcoes.emplace_back(COAP_OPTION_TENANT, step.homes[i].tenant);
+        }
+        encoded_data data_pdu =
+            EncodePduRequest("/search", COAP_REQUEST_CODE_GET, step.payload, opcoes, token);
+        if (data_pdu.size == 0)
+        {
+            // a casa conta como sem resposta até o FederationTimeout
+            continue;
+        }
+        m_transport->Send(step.homes[i].address,
+                          std::string(reinterpret_cast<const char*>(data_pdu.buffer),
+                                      data_pdu.size));
+        m_send_messages++;
+    }
+    chamada.timeout =
+        Simulator::Schedule(m_federationTimeout, &CoTaS::FinishFederatedCall, this, numero);
 }
 
 void
-CoTaS::StartHandlerDict(){
-    m_handlerDict["/subscribe/object"] = [this](Address from, coap_pdu_t* pdu) {
-        return this->HandleSubscription(from, pdu);
-    };
+CoTaS::HandleFederationReply(coap_pdu_t* pdu)
+{
+    // sem o token de 6 bytes é a confirmação de um resumo, nada a fazer
+    std::string token = GetPduToken(pdu);
+    if (token.size() != 6)
+    {
+        return;
+    }
+    uint32_t numero = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        numero = (numero << 8) | static_cast<uint8_t>(token[i]);
+    }
+    size_t indice = (static_cast<uint8_t>(token[4]) << 8) | static_cast<uint8_t>(token[5]);
 
-    m_handlerDict["/subscribe/application"] = [this](Address from, coap_pdu_t* pdu) {
-        return this->HandleSubscription(from, pdu);
-    };
+    auto chamada = m_federatedCalls.find(numero);
+    if (chamada == m_federatedCalls.end() || indice >= chamada->second.replies->size() ||
+        !(*chamada->second.replies)[indice].is_null())
+    {
+        // atrasada, depois do FederationTimeout, ou repetida
+        return;
+    }
+    std::string corpo;
+    GetPduPayloadString(pdu, corpo);
+    (*chamada->second.replies)[indice] = nlohmann::json::parse(corpo, nullptr, false);
+    if (--chamada->second.pending == 0)
+    {
+        FinishFederatedCall(numero);
+    }
+}
 
-    m_handlerDict["/update/object"] = [this](Address from, coap_pdu_t* pdu) {
-        return this->HandleUpdate(from, pdu);
-    };
+void
+CoTaS::FinishFederatedCall(uint32_t call)
+{
+    auto chamada = m_federatedCalls.find(call);
+    if (chamada == m_federatedCalls.end())
+    {
+        return;
+    }
+    chamada->second.timeout.Cancel();
+    std::coroutine_handle<> handle = chamada->second.handle;
+    m_federatedCalls.erase(chamada);
+    Resume(handle, Seconds(0));
+}
 
-    m_handlerDict["/search"] = [this](Address from, coap_pdu_t* pdu) {
-        return this->HandleRequest(from, pdu);
-    };
+void
+CoTaS::DumpHotKeys()
+{
+    if (m_hotKeys == 0)
+    {
+        return;
+    }
+    for (auto& [nome, tenant] : m_tenants)
+    {
+        std::vector<std::pair<std::string, CotasHeavyHitters*>> sketches = {
+            {"objects", &tenant.hotObjects},
+            {"clients", &tenant.hotClients},
+            {"queries", &tenant.hotQueries}};
+        for (auto& [tipo, sketch] : sketches)
+        {
+            if (sketch->Total() == 0)
+            {
+                continue;
+            }
+            std::vector<CotasHeavyHitters::Entry> top = sketch->Top();
+            if (tipo == "clients")
+            {
+                // guardado como número, sai como endereço
+                for (auto& [chave, contagem] : top)
+                {
+                    std::ostringstream endereco;
+                    endereco << Ipv4Address(static_cast<uint32_t>(std::stoul(chave)));
+                    chave = endereco.str();
+                }
+            }
+            m_hotKeysTrace(nome, tipo, top);
+
+            std::ostringstream linha;
+            for (auto& [chave, contagem] : top)
+            {
+                linha << "\n    " << contagem << "  " << chave;
+            }
+            NS_LOG_INFO("[CoTaS] Casa '" << nome << "', " << tipo << " mais frequentes de "
+                                         << sketch->Total() << ":" << linha.str());
+            sketch->Clear();
+        }
+    }
+}
+
+void
+CoTaS::ScheduleHotKeys()
+{
+    DumpHotKeys();
+    m_hotKeysEvent = Simulator::Schedule(m_hotKeysInterval, &CoTaS::ScheduleHotKeys, this);
 }
 
 std::string 
@@ -1012,14 +3709,412 @@ CoTaS::SafeName(std::vector<std::string> tokens,
     return;
 }
 
+// pega cot:localization [ cot:latitude y ; cot:longitude x ] da inscrição
+void
+CoTaS::IndexLocation(int id, const std::string& payload)
+{
+    size_t inicio = payload.find("cot:localization");
+    if (inicio == std::string::npos)
+    {
+        return;
+    }
+    size_t fim = payload.find(']', inicio);
+    std::string bloco = payload.substr(inicio, fim == std::string::npos ? fim : fim - inicio);
+
+    static const std::regex latitude("cot:latitude\\s+(-?[0-9]+(\\.[0-9]+)?)");
+    static const std::regex longitude("cot:longitude\\s+(-?[0-9]+(\\.[0-9]+)?)");
+    std::smatch lat;
+    std::smatch lon;
+    if (std::regex_search(bloco, lat, latitude) && std::regex_search(bloco, lon, longitude))
+    {
+        m_tenant->spatialIndex.Update(id, std::stod(lon[1].str()), std::stod(lat[1].str()));
+    }
+}
+
+bool
+CoTaS::SpatialCandidates(const CotasQuery& query, CotasSpatialIndex::Result& candidates)
+{
+    // limita quantos ids vão no VALUES da consulta
+    static constexpr size_t MAX_CANDIDATOS = 256;
+
+    if (!query.m_zone.empty())
+    {
+        auto zona = m_zones.find(query.m_zone);
+        if (zona == m_zones.end())
+        {
+            return false;
+        }
+        const auto& [minX, minY, maxX, maxY] = zona->second;
+        // sem ponto de referência ordena pelo centro da zona
+        double x = query.m_near ? query.m_longitude : (minX + maxX) / 2;
+        double y = query.m_near ? query.m_latitude : (minY + maxY) / 2;
+        candidates = m_tenant->spatialIndex.Box(minX, minY, maxX, maxY, x, y);
+        if (query.m_radius > 0)
+        {
+            candidates.erase(std::remove_if(candidates.begin(),
+                                            candidates.end(),
+                                            [&query](const std::pair<int32_t, double>& c) {
+                                                return c.second > query.m_radius;
+                                            }),
+                             candidates.end());
+        }
+    }
+    else if (query.m_radius > 0)
+    {
+        candidates = m_tenant->spatialIndex.Radius(query.m_longitude,
+                                                   query.m_latitude,
+                                                   query.m_radius);
+    }
+    else
+    {
+        // k mais próximos: os demais filtros podem descartar alguns,
+        // então manda mais candidatos que o limite
+        candidates = m_tenant->spatialIndex.Nearest(query.m_longitude,
+                                                    query.m_latitude,
+                                                    MAX_CANDIDATOS);
+    }
+
+    if (candidates.size() > MAX_CANDIDATOS)
+    {
+        candidates.resize(MAX_CANDIDATOS);
+    }
+    return true;
+}
+
+// zonas no formato "Nome:minX,minY,maxX,maxY;Outra:..."
+void
+CoTaS::ParseZones()
+{
+    m_zones.clear();
+    std::stringstream zonas(m_zonesConfig);
+    std::string zona;
+    while (std::getline(zonas, zona, ';'))
+    {
+        size_t separador = zona.find(':');
+        if (separador == std::string::npos)
+        {
+            continue;
+        }
+        std::array<double, 4> caixa;
+        char virgula;
+        std::stringstream valores(zona.substr(separador + 1));
+        if (valores >> caixa[0] >> virgula >> caixa[1] >> virgula >> caixa[2] >> virgula >>
+            caixa[3])
+        {
+            m_zones[zona.substr(0, separador)] = caixa;
+        }
+        else
+        {
+            NS_LOG_INFO("[CoTaS] Zona mal formada ignorada: " << zona);
+        }
+    }
+}
+
+// grafo de estado:
+// WITH <urn:cotas:state:ID>
+// DELETE { <urn:cotas:device:ID> cot:turnedOn ?v0 . }
+// INSERT { <urn:cotas:device:ID> cot:turnedOn 1 . }
+// WHERE { OPTIONAL { <urn:cotas:device:ID> cot:turnedOn ?v0 . } }
+std::string
+CoTaS::JsonToStateUpdate(nlohmann::json payload)
+{
+    int id = payload["objectId"];
+    std::string sujeito = CotasQuery::StateSubject(id);
+
+    std::ostringstream sparql_delete;
+    std::ostringstream sparql_insert;
+    std::ostringstream sparql_where;
+    sparql_insert << sujeito << " cot:objectId " << id << " . ";
+
+    size_t n = 0;
+    for (auto& [chave, valor] : payload.items())
+    {
+        if (chave == "objectId")
+        {
+            continue;
+        }
+        std::string propriedade = CotasQuery::StateProperty(chave);
+        if (propriedade.empty())
+        {
+            NS_LOG_INFO("[CoTaS] Chave de estado inválida ignorada: " << chave);
+            continue;
+        }
+        std::string antigo = "?v" + std::to_string(n++);
+        sparql_delete << sujeito << " " << propriedade << " " << antigo << " . ";
+        sparql_insert << sujeito << " " << propriedade << " " << valor.dump() << " . ";
+        sparql_where << "OPTIONAL { " << sujeito << " " << propriedade << " " << antigo
+                     << " . } ";
+    }
+
+    std::ostringstream sparql;
+    sparql << SparqlPrefix() << "WITH " << CotasQuery::StateGraph(id) << " "
+           << "DELETE { " << sparql_delete.str() << "} "
+           << "INSERT { " << sparql_insert.str() << "} "
+           << "WHERE { " << sparql_where.str() << "}";
+    return sparql.str();
+}
+
+// dispositivo sem cot:turnedOn no perfil começa desligado
+int
+CoTaS::ProfileTurnedOn(const std::string& payload)
+{
+    static const std::regex ligado("cot:turnedOn\\s+([01])");
+    std::smatch encontrado;
+    return std::regex_search(payload, encontrado, ligado) ? std::stoi(encontrado[1].str()) : 0;
+}
+
+void
+CoTaS::SeedState(const std::vector<NewDevice*>& devices)
+{
+    std::ostringstream sparql;
+    sparql << SparqlPrefix() << "INSERT DATA { ";
+    for (NewDevice* dispositivo : devices)
+    {
+        int32_t id = dispositivo->id;
+        sparql << "GRAPH " << CotasQuery::StateGraph(id) << " { " << CotasQuery::StateSubject(id)
+               << " cot:objectId " << id << " ; "
+               << "cot:turnedOn " << ProfileTurnedOn(dispositivo->text) << " . } ";
+    }
+    sparql << "}";
+
+    auto res = StorePost(StorePath("update", true), sparql.str(), "application/sparql-update");
+    if (!res || (res->status != 200 && res->status != 204))
+    {
+        NS_LOG_INFO("[CoTaS] Erro ao criar os grafos de estado de " << devices.size()
+                                                                    << " dispositivos");
+    }
+}
+
+std::string
+CoTaS::TurnedOnPattern()
+{
+    // com a tabela quente o filtro é feito no próprio CoTaS
+    if (!m_flushInterval.IsZero())
+    {
+        return "";
+    }
+    if (m_stateGraphs)
+    {
+        return std::string("GRAPH ") + CotasQuery::STATE_GRAPH +
+               " { ?estado cot:objectId ?id ; cot:turnedOn 1 . } ";
+    }
+    return "?device cot:turnedOn 1 . ";
+}
+
+// tipo da aplicação vem da inscrição: "cot:Application0 a cot:FallDetection, ..."
+void
+CoTaS::RecordApplicationType(Address from, const std::string& payload)
+{
+    static const std::regex tipo("\\sa\\s+cot:(\\w+)");
+    std::smatch encontrado;
+    if (std::regex_search(payload, encontrado, tipo))
+    {
+        // cada casa tem suas aplicações: o mesmo ip pode ser outra coisa noutra casa
+        uint32_t cliente = InetSocketAddress::ConvertFrom(from).GetIpv4().Get();
+        m_tenant->applicationTypes[cliente] = encontrado[1].str();
+    }
+}
+
+CotasSelectionPolicy::Type
+CoTaS::PolicyFor(Address from)
+{
+    auto tipo =
+        m_tenant->applicationTypes.find(InetSocketAddress::ConvertFrom(from).GetIpv4().Get());
+    if (tipo != m_tenant->applicationTypes.end())
+    {
+        auto politica = m_policies.find(tipo->second);
+        if (politica != m_policies.end())
+        {
+            return politica->second;
+        }
+    }
+    return m_defaultPolicy;
+}
+
+// políticas no formato "FallDetection=round-robin;*=least-loaded"
+// "home1=10.1.1.0/24,10.1.2.0/24;home2=10.2.0.0/16", cada casa usa o
+// dataset de mesmo nome e o serviço "<nome>-state" do fuseki
+void
+CoTaS::ParseTenants()
+{
+    m_tenants.clear();
+    m_tenantSubnets.clear();
+    m_tenant = nullptr;
+    m_tenants[""].dataset = "dataset";
+    m_tenants[""].stateService = "state";
+
+    std::stringstream entradas(m_tenantsConfig);
+    std::string entrada;
+    while (std::getline(entradas, entrada, ';'))
+    {
+        size_t separador = entrada.find('=');
+        std::string nome = entrada.substr(0, separador);
+        bool valido = !nome.empty() && separador != std::string::npos;
+        for (char c : nome)
+        {
+            // o nome vira caminho no fuseki
+            valido = valido && (std::isalnum(static_cast<unsigned char>(c)) || c == '_');
+        }
+        if (!valido)
+        {
+            NS_LOG_INFO("[CoTaS] Casa mal formada ignorada: " << entrada);
+            continue;
+        }
+        Tenant& tenant = m_tenants[nome];
+        tenant.name = nome;
+        tenant.dataset = nome;
+        tenant.stateService = nome + "-state";
+
+        std::stringstream redes(entrada.substr(separador + 1));
+        std::string rede;
+        while (std::getline(redes, rede, ','))
+        {
+            size_t barra = rede.find('/');
+            int prefixo = barra == std::string::npos ? 32 : std::atoi(rede.c_str() + barra + 1);
+            if (prefixo < 0 || prefixo > 32)
+            {
+                NS_LOG_INFO("[CoTaS] Sub-rede mal formada ignorada: " << rede);
+                continue;
+            }
+            uint32_t mascara = prefixo == 0 ? 0 : ~uint32_t{0} << (32 - prefixo);
+            uint32_t endereco = Ipv4Address(rede.substr(0, barra).c_str()).Get();
+            m_tenantSubnets.push_back({endereco & mascara, mascara, nome});
+        }
+    }
+    m_tenant = &m_tenants[""];
+}
+
+CoTaS::Tenant*
+CoTaS::ResolveTenant(Address from, coap_pdu_t* pdu)
+{
+    std::string nome;
+    if (GetPduOption(pdu, COAP_OPTION_TENANT, nome))
+    {
+        auto it = m_tenants.find(nome);
+        return it == m_tenants.end() ? nullptr : &it->second;
+    }
+
+    // a sub-rede mais específica ganha
+    uint32_t ip = InetSocketAddress::ConvertFrom(from).GetIpv4().Get();
+    const TenantSubnet* melhor = nullptr;
+    for (auto& rede : m_tenantSubnets)
+    {
+        if ((ip & rede.mask) == rede.network && (!melhor || rede.mask > melhor->mask))
+        {
+            melhor = &rede;
+        }
+    }
+    return &m_tenants[melhor ? melhor->name : ""];
+}
+
+std::string
+CoTaS::StorePath(const std::string& operacao, bool estado) const
+{
+    const Tenant* tenant = s_storeTenant ? s_storeTenant : m_tenant;
+    return "/" + (estado ? tenant->stateService : tenant->dataset) + "/" + operacao;
+}
+
+void
+CoTaS::ParseSelectionPolicies()
+{
+    m_policies.clear();
+    m_defaultPolicy = CotasSelectionPolicy::FIRST;
+    std::stringstream entradas(m_selectionConfig);
+    std::string entrada;
+    while (std::getline(entradas, entrada, ';'))
+    {
+        size_t separador = entrada.find('=');
+        CotasSelectionPolicy::Type politica;
+        if (separador == std::string::npos ||
+            !CotasSelectionPolicy::FromString(entrada.substr(separador + 1), politica))
+        {
+            NS_LOG_INFO("[CoTaS] Política mal formada ignorada: " << entrada);
+            continue;
+        }
+        std::string tipo = entrada.substr(0, separador);
+        if (tipo == "*")
+        {
+            m_defaultPolicy = politica;
+        }
+        else
+        {
+            m_policies[tipo] = politica;
+        }
+    }
+}
+
+encoded_data
+CoTaS::EncodeReply(const nlohmann::json& response,
+                   const std::string& token,
+                   const std::vector<std::pair<uint16_t, std::string>>& options)
+{
+    coap_pdu_code_t codigo = response.contains("status")
+                                 ? response["status"].get<coap_pdu_code_t>()
+                                 : COAP_RESPONSE_CODE_INTERNAL_ERROR;
+    encoded_data dados = EncodePduResponse(codigo, response.dump(), token, options);
+    if (dados.size == 0)
+    {
+        // o cliente recebe o erro em vez de esperar até desistir
+        nlohmann::json erro = {{"status", COAP_RESPONSE_CODE_INTERNAL_ERROR},
+                               {"error", "response does not fit a packet"}};
+        dados = EncodePduResponse(COAP_RESPONSE_CODE_INTERNAL_ERROR, erro.dump(), token, options);
+    }
+    return dados;
+}
+
 void 
-CoTaS::SendReply(Ptr<Socket> socket, Ptr<Packet> response, Address from)
+CoTaS::SendReply(const CotasTransport::Request& request, const encoded_data& data, Time delay)
 {
     // coletando dados para analise
     m_send_messages++;
 
+    m_transport->Reply(request,
+                       std::string(reinterpret_cast<const char*>(data.buffer), data.size),
+                       delay);
+}
+
+void
+CoTaS::Reply(const Request& request, const std::string& datagram, Time delay)
+{
+    auto link = std::static_pointer_cast<const SocketLink>(request.link);
+    Ptr<Packet> response =
+        Create<Packet>(reinterpret_cast<const uint8_t*>(datagram.data()), datagram.size());
+    TimestampTag timestampTag;
+    if (link->packet->PeekPacketTag(timestampTag))
+    {
+        response->AddPacketTag(timestampTag);
+    }
     // NS_LOG_INFO("[CoTaS] Enviando resposta agendada no tempo: " << Simulator::Now().GetSeconds());
-    socket->SendTo(response, 0, from);
+    Simulator::Schedule(delay, [link, response, from = request.from]() {
+        link->socket->SendTo(response, 0, from);
+    });
+}
+
+void
+CoTaS::Send(const Address& to, const std::string& datagram)
+{
+    m_socket->SendTo(
+        Create<Packet>(reinterpret_cast<const uint8_t*>(datagram.data()), datagram.size()),
+        0,
+        to);
+}
+
+bool
+CoTaS::WallClock() const
+{
+    return false;
+}
+
+Time
+CoTaS::ModelledDelay(Time delay) const
+{
+    return m_transport->WallClock() ? Seconds(0) : delay;
+}
+
+void
+CoTaS::SetTransport(CotasTransport* transport)
+{
+    m_transport = transport;
 }
 
 } // Namespace ns3
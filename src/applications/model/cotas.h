@@ -18,12 +18,32 @@
 #include "sink-application.h"
 
 #include "ns3/event-id.h"
+#include "ns3/nstime.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "json.hpp"
 #include "encapsulated-coap.h"
+#include "cotas-block-assembler.h"
+#include "cotas-bloom-filter.h"
+#include "cotas-category-index.h"
+#include "cotas-device-graph.h"
+#include "cotas-heavy-hitters.h"
+#include "cotas-query.h"
+#include "cotas-range-index.h"
+#include "cotas-selection-policy.h"
+#include "cotas-spatial-index.h"
+#include "cotas-state-table.h"
+#include "cotas-store-pool.h"
+#include "cotas-task.h"
+#include "cotas-time-series.h"
+#include "cotas-transport.h"
 #include "httplib.h"
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <unordered_map>
 #include <unordered_set>
@@ -31,6 +51,8 @@
 #include <vector>
 
 #include <chrono>
+#include <coroutine>
+#include <type_traits>
 
 namespace ns3
 {
@@ -49,10 +71,15 @@ class Packet;
  *
  * Every packet received is sent back.
  */
-class CoTaS : public SinkApplication
+class CoTaS : public SinkApplication, public CotasTransport
 {
   public:
-    static constexpr uint16_t DEFAULT_PORT{9}; //!< default port
+    static constexpr uint16_t DEFAULT_PORT{9};         //!< default port
+    static constexpr size_t MAX_BULK_DEVICES{64};      //!< entries of one /subscribe/bulk
+    static constexpr size_t MAX_BLOCK_BODY{64 * 1024}; //!< bytes of one Block1 request
+    static constexpr size_t MAX_BLOCK_TRANSFERS{64};   //!< Block1 requests open at once
+    static constexpr size_t MAX_BLOCK_BYTES{1 << 20};  //!< bytes of the open Block1 requests
+    static constexpr size_t MAX_STANDING_QUERIES{256}; //!< standing queries of one tenant
 
     /**
      * @brief Get the type ID.
@@ -63,10 +90,66 @@ class CoTaS : public SinkApplication
     CoTaS();
     ~CoTaS() override;
 
+    /**
+     * TracedCallback signature for the most frequent keys of a period.
+     *
+     * @param [in] tenant home the keys belong to, "" for the default
+     * @param [in] sketch "objects", "clients" or "queries"
+     * @param [in] top keys and estimated counts, most frequent first
+     */
+    typedef void (*HotKeysCallback)(const std::string& tenant,
+                                    const std::string& sketch,
+                                    const std::vector<CotasHeavyHitters::Entry>& top);
+
+    /**
+     * @brief Makes the datagrams go through another transport than the
+     *        ns-3 sockets; the application is then not started by a node.
+     */
+    void SetTransport(CotasTransport* transport);
+
+    /**
+     * @brief Starts what does not depend on the transport: the store, the
+     *        handlers, the indexes and the periodic events.
+     * @return false if the store could not be set up
+     */
+    bool StartService();
+
+    /**
+     * @brief Stops the periodic events and writes what is pending.
+     */
+    void StopService();
+
+    /**
+     * @brief Handles one CoAP datagram, a request or a federation reply.
+     */
+    void HandleDatagram(const uint8_t* data, size_t size, const CotasTransport::Request& request);
+
   private:
     void StartApplication() override;
     void StopApplication() override;
 
+    /**
+     * @brief Opens the ns-3 sockets the requests come in.
+     */
+    void StartSockets();
+
+    /// What a reply through the ns-3 sockets needs from its request
+    struct SocketLink
+    {
+        Ptr<Socket> socket; //!< socket the request came in
+        Ptr<Packet> packet; //!< request, for its tags
+    };
+
+    void Reply(const Request& request, const std::string& datagram, Time delay) override;
+    void Send(const Address& to, const std::string& datagram) override;
+    bool WallClock() const override;
+
+    /**
+     * @brief Time a reply or a resume waits for work that took delay; zero
+     *        if the transport runs on the wall clock.
+     */
+    Time ModelledDelay(Time delay) const;
+
     /**
      * @brief Handle a packet reception.
      *
@@ -76,28 +159,754 @@ class CoTaS : public SinkApplication
      */
     void HandleRead(Ptr<Socket> socket);
 
-    nlohmann::json HandleSubscription( 
+    CotasTask HandleSubscription( 
       Address from,
-      coap_pdu_t* pdu
+      std::string payload
     );
 
-    nlohmann::json HandleUpdate( 
+    /**
+     * @brief Handles /subscribe/object: subscribes the object and puts it
+     *        in the in-memory indexes and standing queries.
+     */
+    CotasTask SubscribeObject(Address from, std::string payload);
+
+    /**
+     * @brief Handles /subscribe/application.
+     *
+     * The payload is the application profile or
+     * {"profile": "<turtle>", "query": <search>}; in the second form the
+     * search is registered and its queryId is returned with the id.
+     */
+    CotasTask HandleApplicationSubscription(Address from, std::string payload);
+
+    /**
+     * @brief Subscribes a Turtle profile, or a device by model reference.
+     *
+     * A reference is {"model": "cot:Model", "overrides": {"port": 19,
+     * "localization.latitude": 11, ...}}. The device becomes a node of its
+     * own with cot:instanceOf the model, the model classes and the
+     * overrides; the static profile of the model is stored only once. An
+     * unknown model is answered with 4.04 unless the reference also
+     * carries its "profile", which is then stored without the overridden
+     * properties.
+     *
+     * A profile in syntax the parser does not know is answered with 4.00.
+     * A drawn id already taken is drawn again after a growing pause, and
+     * a few failed draws in a row are answered with 5.03.
+     *
+     * @param profile receives the Turtle of the device, if not null and
+     *        this call inserted it; left alone if the ip was subscribed
+     */
+    CotasTask Subscribe(Address from, std::string payload, std::string* profile = nullptr);
+
+    /**
+     * @brief Handles /subscribe/bulk: subscribes many devices at once.
+     *
+     * The payload, sent with Block1 if it does not fit a packet, is
+     * [{"address": "10.1.1.7", "subscription": <payload of
+     * /subscribe/object>}, ...], at most MAX_BULK_DEVICES entries. All
+     * devices go to the store in one SPARQL Update request, which Fuseki
+     * runs as one transaction. The response has "ids" in the order of the
+     * entries, null for those that failed, whose index and CoAP status
+     * are listed in "errors".
+     */
+    CotasTask SubscribeBulk(Address from, std::string payload);
+
+    /// Device being subscribed
+    struct NewDevice
+    {
+        std::string payload;              //!< Turtle profile, or model reference
+        std::string model;                //!< model of a reference, empty for a profile
+        std::vector<std::string> classes; //!< classes of the model
+        nlohmann::json overrides;         //!< instance values of a reference
+        uint32_t ip{0};                   //!< IPv4 address of the device
+        int32_t id{0};                    //!< drawn id
+        std::string text;                 //!< profile with cot: names, for the indexes
+        CotasDeviceGraph graph;           //!< skolemized profile, sent to the store
+        int32_t registered{0};            //!< id the ip has, 0 if the drawn id was taken
+    };
+
+    /**
+     * @brief Checks a model reference and finds the model classes,
+     *        storing the model profile if the reference carries it.
+     * @return {"model", "overrides", "classes"}, or an error response
+     */
+    CotasTask ResolveModel(std::string payload);
+
+    /**
+     * @brief Draws an id for the device and builds its profile.
+     * @return false if the profile uses syntax the parser does not know
+     */
+    bool PrepareDevice(NewDevice& device);
+
+    /**
+     * @brief Puts a subscribed device in the in-memory state.
+     */
+    void IndexDevice(NewDevice& device);
+
+    /**
+     * @brief Puts a new object in the category and range indexes and the
+     *        standing queries.
+     */
+    CotasTask IndexObject(int32_t id, std::string text);
+
+    /**
+     * @brief Gathers the blocks of a Block1 request, answering all but
+     *        the last one.
+     * @param body receives the whole payload when the last block arrived
+     * @return true when the last block arrived
+     */
+    bool ReceiveBlock(const CotasTransport::Request& request,
+                      const std::string& path,
+                      coap_pdu_t* pdu,
+                      const coap_block_t& block,
+                      std::string& body);
+
+    CotasTask HandleUpdate( 
       Address from,
-      coap_pdu_t* pdu
+      std::string body
     );
 
-    nlohmann::json HandleRequest( 
+    CotasTask HandleRequest( 
       Address from,
-      coap_pdu_t* pdu
+      std::string payload
     );
 
+    /**
+     * @brief Puts the chosen objects in a response: the only one in
+     *        "response" if the limit is 1, else in "results" as many as
+     *        fit MAX_PAYLOAD, with "truncated" if some were left out.
+     */
+    void PackResults(nlohmann::json& response,
+                     std::vector<nlohmann::json>& objetos,
+                     uint32_t limite);
+
+    /**
+     * @brief Applies the selection policy and builds the search response.
+     * @param objetos matching objects, as sent in the response
+     * @param opcoes the same objects, as seen by the selection policy
+     * @param espacial keep the distance order instead of the policy
+     * @param projecao update keys whose last values go in "context"
+     */
+    nlohmann::json SelectResults(std::vector<nlohmann::json> objetos,
+                                 std::vector<CotasSelectionPolicy::Candidate> opcoes,
+                                 CotasSelectionPolicy::Type politica,
+                                 const std::string& chave,
+                                 uint32_t cliente,
+                                 uint32_t limite,
+                                 bool espacial,
+                                 const std::vector<std::string>& projecao = {});
+
+    /// Search registered at subscription, with its result kept up to date
+    struct StandingQuery
+    {
+        std::string key;                              //!< canonical text
+        bool structured{false};                       //!< query or fragment
+        CotasQuery query;                             //!< structured search
+        std::string fragment;                         //!< raw SPARQL fragment
+        std::map<int32_t, nlohmann::json> results;    //!< objectId -> {ip, port}
+        Time used;                                    //!< last registration or request
+    };
+
+    /// Store-bound part of a /search, kept until its bindings arrive
+    struct PendingSearch
+    {
+        std::string select;                               //!< SELECT, without prefixes
+        uint32_t limit{1};                                //!< max results
+        std::vector<std::string> project;                 //!< keys sent in "context"
+        std::unordered_map<int32_t, double> distances;    //!< objectId -> distance
+        CotasSelectionPolicy::Type policy{CotasSelectionPolicy::FIRST}; //!< selection policy
+        std::string key;                                  //!< canonical query text
+        uint32_t client{0};                               //!< client IPv4 address
+        CotasBitmap bitmap;                               //!< ordinals accepted by the bitmaps
+        bool byBitmap{false};                             //!< bitmap is in use
+        std::vector<int32_t> range;                       //!< objectIds accepted by ranges
+        bool byRange{false};                              //!< range is in use
+        CotasTransport::Request request;                  //!< where the reply goes
+        std::string token;                                //!< request token, echoed
+        Time deadline;                                    //!< client gives up, zero for none
+    };
+
+    /**
+     * @brief Builds the search response from the store bindings.
+     */
+    nlohmann::json AnswerSearch(const PendingSearch& busca, const nlohmann::json& bindings);
+
+    /**
+     * @brief Queues a search for the next batch of the current tenant.
+     */
+    void EnqueueSearch(PendingSearch busca);
+
+    /**
+     * @brief Runs the queued searches of a tenant as one SPARQL query and
+     *        sends each requester its reply.
+     */
+    CotasTask RunBatch(std::string tenant);
+
+    /// Store query in progress, shared by identical queries
+    struct Flight
+    {
+        std::vector<std::coroutine_handle<>> waiters; //!< handlers waiting for the result
+        nlohmann::json bindings;                      //!< result, null if the store failed
+    };
+
+    /// Home CoTaS known upstream from its digest
+    struct FederatedHome
+    {
+        Address address;         //!< CoTaS of the home
+        std::string tenant;      //!< tenant of the home in that CoTaS
+        CotasBloomFilter digest; //!< classes and usedFor of its devices
+        uint64_t devices{0};     //!< devices it has indexed
+        Time seen;               //!< when the digest arrived
+    };
+
+    /// Device model known to a tenant
+    struct Model
+    {
+        std::vector<std::string> classes;          //!< cot classes of the model
+        std::unordered_set<std::string> properties; //!< cot properties only the model holds
+    };
+
+    /// One home: its store datasets, in-memory state and statistics
+    struct Tenant
+    {
+        std::string name;                             //!< key in m_tenants, "" for the default
+        std::string dataset;                          //!< Fuseki dataset with the profiles
+        std::string stateService;                     //!< Fuseki service of the state graphs
+        CotasStateTable stateTable;                   //!< current numeric values
+        CotasSpatialIndex spatialIndex;               //!< device positions
+        CotasSelectionPolicy selection;               //!< consumer assignments
+        std::unordered_map<uint32_t, std::string> applicationTypes; //!< client ip -> app class
+        CotasCategoryIndex categories;                //!< class/usedFor/state bitmaps
+        CotasRangeIndex rangeIndex;                   //!< ordered numeric properties
+        std::map<uint32_t, StandingQuery> standingQueries;     //!< queryId -> query
+        std::unordered_map<std::string, uint32_t> standingIds; //!< key -> queryId
+        uint32_t nextQueryId{1};                               //!< next queryId
+        std::map<std::pair<int32_t, std::string>, CotasTimeSeries> history; //!< (id, key) -> series
+        uint64_t subscriptions{0};                    //!< subscriptions received
+        uint64_t updates{0};                          //!< updates received
+        uint64_t searches{0};                         //!< searches received
+        std::unordered_map<std::string, std::shared_ptr<Flight>>
+            flights;                                  //!< SPARQL -> running query
+        uint64_t collapsed{0};                        //!< queries answered by a flight
+        std::vector<PendingSearch> batch;             //!< searches waiting for the store
+        EventId batchEvent;                           //!< next RunBatch
+        uint64_t batches{0};                          //!< merged store queries sent
+        std::unordered_map<int32_t, CotasDeviceGraph> graphs; //!< id -> skolemized profile
+        std::unordered_map<std::string, Model> models;         //!< model -> what it holds
+        std::unordered_map<int32_t, std::string> instances;    //!< id -> model, by reference
+        CotasHeavyHitters hotObjects;                 //!< objectIds of the updates
+        CotasHeavyHitters hotClients;                 //!< client addresses of all requests
+        CotasHeavyHitters hotQueries;                 //!< shapes of the searches
+        std::map<std::string, FederatedHome> homes;   //!< "ip/tenant" -> home, upstream
+        uint64_t federated{0};                        //!< federated searches received
+        uint64_t forwarded{0};                        //!< home searches they turned into
+        uint64_t expired{0};                          //!< replies dropped past the deadline
+        uint64_t skipped{0};                          //!< store steps not run past the deadline
+        bool flushing{false};                         //!< a FlushState waits for the store
+        std::unordered_map<int32_t, std::deque<std::coroutine_handle<>>>
+            updating; //!< object -> updates waiting for the one running
+    };
+
+    /// Client subnet mapped to a tenant
+    struct TenantSubnet
+    {
+        uint32_t network; //!< network address
+        uint32_t mask;    //!< network mask
+        std::string name; //!< tenant
+    };
+
+    /**
+     * @brief Finds the tenant of a request: the Tenant CoAP option if
+     *        present, else the longest client subnet match, else the
+     *        default tenant.
+     * @return nullptr if the option names an unknown tenant
+     */
+    Tenant* ResolveTenant(Address from, coap_pdu_t* pdu);
+
+    /**
+     * @brief Runs a SELECT in the dataset of the current tenant, joining an
+     *        identical query still in progress.
+     *
+     * The flight is registered before the store call, so an identical
+     * query arriving while it runs waits for it instead of calling the
+     * store again. The flight runs even if the client that started it
+     * stops waiting, since others may be waiting for it too.
+     *
+     * @return the result bindings, null if the store failed
+     */
+    CotasTask SharedSelect(std::string sparql);
+
+    /**
+     * @brief Runs a SELECT in the dataset of the current tenant.
+     * @return the result bindings, null if the store failed
+     */
+    nlohmann::json StoreSelect(const std::string& sparql);
+
+    /// Bytes exchanged with the store, before and after encoding; the
+    /// threads of the store pool count too
+    struct StoreTraffic
+    {
+        std::atomic<uint64_t> sent{0};         //!< request bodies
+        std::atomic<uint64_t> sentWire{0};     //!< request bodies as sent
+        std::atomic<uint64_t> received{0};     //!< response bodies
+        std::atomic<uint64_t> receivedWire{0}; //!< response bodies as received
+    };
+
+    /**
+     * @brief Posts a body to the store.
+     *
+     * All store calls go through StoreSend, which measures them and, with
+     * StoreCompression, encodes them.
+     */
+    httplib::Result StorePost(const std::string& path,
+                              const std::string& body,
+                              const std::string& contentType);
+
+    /**
+     * @brief Posts a form, such as a SPARQL query, to the store.
+     */
+    httplib::Result StorePost(const std::string& path,
+                              const httplib::Headers& headers,
+                              const httplib::Params& params);
+
+    /**
+     * @brief Puts a body in the store.
+     */
+    httplib::Result StorePut(const std::string& path,
+                             const std::string& body,
+                             const std::string& contentType);
+
+    /**
+     * @brief Sends a request to the store.
+     *
+     * With StoreCompression the store is asked for a gzip or deflate
+     * response, inflated here, and a compressible body of at least
+     * StoreCompressionMin bytes goes gzipped.
+     *
+     * @param compressible the store decodes this body; form fields are
+     *        read before any decoding, so forms are not
+     */
+    httplib::Result StoreSend(bool put,
+                              const std::string& path,
+                              httplib::Headers headers,
+                              std::string body,
+                              const std::string& contentType,
+                              bool compressible);
+
+    /**
+     * @brief Awaitable store step of a handler coroutine.
+     *
+     * On the wall clock the store call runs on a thread of the store pool
+     * and the handler resumes from an event scheduled when it returns, so
+     * the store calls of different requests really overlap while the
+     * simulator thread keeps serving. The call must then touch nothing
+     * but the store and the handler frame; memory is read before the step
+     * and changed after it.
+     *
+     * In a simulation the call runs when the handler suspends and only the
+     * resume waits for the time it took: the overlap exists in simulated
+     * time only, as a model of a store serving requests in parallel.
+     */
+    template <typename T>
+    struct StoreStep
+    {
+        CoTaS* cotas;             //!< server running the step
+        std::function<T()> work;  //!< the store call
+        T result{};               //!< what work returned
+        Tenant* tenant{nullptr};  //!< tenant of the suspended handler
+        Time deadline;            //!< deadline of the suspended handler
+        bool always{false};       //!< runs past the deadline too
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            tenant = cotas->m_tenant;
+            deadline = cotas->m_requestDeadline;
+            if (!always && cotas->Expired(deadline))
+            {
+                // ninguém espera mais a resposta: o handler segue com o
+                // resultado vazio, que ele trata como falha
+                tenant->skipped++;
+                cotas->Resume(handle, Seconds(0));
+                return;
+            }
+            if (cotas->m_storePool.Running())
+            {
+                // o simulador segue atendendo até a chamada voltar
+                cotas->SubmitStep(tenant, [this] { result = work(); }, handle);
+                return;
+            }
+            auto inicio = std::chrono::high_resolution_clock::now();
+            result = work();
+            std::chrono::duration<double> duracao =
+                std::chrono::high_resolution_clock::now() - inicio;
+            cotas->Resume(handle, Seconds(duracao.count()));
+        }
+
+        T await_resume()
+        {
+            // outros pedidos rodaram enquanto este esperava
+            cotas->m_tenant = tenant;
+            cotas->m_requestDeadline = deadline;
+            return std::move(result);
+        }
+    };
+
+    /**
+     * @brief Wraps a store call to be co_awaited by a handler.
+     * @param always run it even if the client stopped waiting, as the
+     *        index upkeep that follows a write already in the store
+     */
+    template <typename F>
+    StoreStep<std::invoke_result_t<F>> Step(F work, bool always = false)
+    {
+        return {this, std::move(work), {}, nullptr, Seconds(0), always};
+    }
+
+    /// Awaitable that suspends a handler before it retries a store call
+    struct Backoff
+    {
+        CoTaS* cotas;            //!< server running the handler
+        Time delay;              //!< how long the handler waits
+        Tenant* tenant{nullptr}; //!< tenant of the suspended handler
+        Time deadline;           //!< deadline of the suspended handler
+
+        bool await_ready() const noexcept
+        {
+            return delay.IsZero();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            tenant = cotas->m_tenant;
+            deadline = cotas->m_requestDeadline;
+            cotas->Resume(handle, delay, false);
+        }
+
+        void await_resume()
+        {
+            if (tenant)
+            {
+                cotas->m_tenant = tenant;
+                cotas->m_requestDeadline = deadline;
+            }
+        }
+    };
+
+    /**
+     * @brief Awaitable that waits for the updates of an object that
+     *        arrived earlier, so memory and store see them in order.
+     *
+     * The update holds the turn until its UpdateTurnGuard goes away.
+     */
+    struct UpdateTurn
+    {
+        CoTaS* cotas;            //!< server running the update
+        int32_t id;              //!< object being updated
+        Tenant* tenant{nullptr}; //!< tenant of the suspended handler
+        Time deadline;           //!< deadline of the suspended handler
+
+        bool await_ready()
+        {
+            // sem fila o objeto está livre e o update segue direto
+            return cotas->m_tenant->updating.try_emplace(id).second;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            tenant = cotas->m_tenant;
+            deadline = cotas->m_requestDeadline;
+            tenant->updating[id].push_back(handle);
+        }
+
+        void await_resume()
+        {
+            if (tenant)
+            {
+                cotas->m_tenant = tenant;
+                cotas->m_requestDeadline = deadline;
+            }
+        }
+    };
+
+    /// Gives the turn of an object to its next update on every exit of the handler
+    struct UpdateTurnGuard
+    {
+        CoTaS* cotas;   //!< server running the update
+        Tenant* tenant; //!< tenant of the object
+        int32_t id;     //!< object being updated
+
+        ~UpdateTurnGuard()
+        {
+            cotas->EndUpdate(tenant, id);
+        }
+    };
+
+    /**
+     * @brief Resumes the next update waiting for the object, if any.
+     */
+    void EndUpdate(Tenant* tenant, int32_t id);
+
+    /**
+     * @brief Awaitable that waits for a store query started by another
+     *        handler and takes its result.
+     */
+    struct FlightWait
+    {
+        CoTaS* cotas;                   //!< server running the handler
+        std::shared_ptr<Flight> flight; //!< query being waited for
+        Tenant* tenant{nullptr};        //!< tenant of the suspended handler
+        Time deadline;                  //!< deadline of the suspended handler
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            tenant = cotas->m_tenant;
+            deadline = cotas->m_requestDeadline;
+            flight->waiters.push_back(handle);
+        }
+
+        nlohmann::json await_resume()
+        {
+            cotas->m_tenant = tenant;
+            cotas->m_requestDeadline = deadline;
+            return flight->bindings;
+        }
+    };
+
+    /// Search forwarded to homes, waiting for their replies
+    struct FederatedCall
+    {
+        std::coroutine_handle<> handle;        //!< suspended upstream handler
+        std::vector<nlohmann::json>* replies;  //!< per home, null until it answers
+        size_t pending{0};                     //!< homes still to answer
+        EventId timeout;                       //!< resumes with what arrived
+    };
+
+    /**
+     * @brief Awaitable that forwards a search to homes; the handler
+     *        resumes when all replied or FederationTimeout passed.
+     */
+    struct FederationStep
+    {
+        CoTaS* cotas;                        //!< upstream server
+        std::vector<FederatedHome> homes;    //!< where the search goes
+        std::string payload;                 //!< the search
+        std::vector<nlohmann::json> replies; //!< per home, null if it did not answer
+        Tenant* tenant{nullptr};             //!< tenant of the suspended handler
+        Time deadline;                       //!< deadline of the suspended handler
+
+        bool await_ready() const noexcept
+        {
+            return homes.empty();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            tenant = cotas->m_tenant;
+            deadline = cotas->m_requestDeadline;
+            if (cotas->Expired(deadline))
+            {
+                // nenhuma casa responde a tempo de servir
+                tenant->skipped++;
+                replies.assign(homes.size(), nullptr);
+                cotas->Resume(handle, Seconds(0));
+                return;
+            }
+            cotas->Forward(*this, handle);
+        }
+
+        std::vector<nlohmann::json> await_resume()
+        {
+            if (tenant)
+            {
+                cotas->m_tenant = tenant;
+                cotas->m_requestDeadline = deadline;
+            }
+            return std::move(replies);
+        }
+    };
+
+    /**
+     * @brief Sends the search of a FederationStep to its homes.
+     */
+    void Forward(FederationStep& step, std::coroutine_handle<> handle);
+
+    /**
+     * @brief Handles a response from a home CoTaS.
+     */
+    void HandleFederationReply(coap_pdu_t* pdu);
+
+    /**
+     * @brief Resumes a federated search with the replies it has.
+     */
+    void FinishFederatedCall(uint32_t call);
+
+    /**
+     * @brief Handles /federation/digest: records what a home CoTaS has.
+     */
+    nlohmann::json HandleDigest(Address from, const std::string& payload);
+
+    /**
+     * @brief Handles /search/federated.
+     *
+     * The search goes only to the homes whose digest may have one of its
+     * classes and one of its usedFor contexts; their results come back
+     * together, each with the "home" it came from.
+     */
+    CotasTask HandleFederatedSearch(Address from, std::string payload);
+
+    /**
+     * @brief Sends the digest of every tenant to the upstream CoTaS and
+     *        schedules the next ones.
+     */
+    void SendDigests();
+
+    /**
+     * @brief Resumes a suspended handler after delay.
+     * @param measured delay is the time a store call took, which the wall
+     *        clock has already spent
+     */
+    void Resume(std::coroutine_handle<> handle, Time delay, bool measured = true);
+
+    /**
+     * @brief Runs a store step on the store pool and resumes its handler
+     *        from a simulator event once it returns.
+     * @param tenant whose datasets the call uses
+     */
+    void SubmitStep(Tenant* tenant, std::function<void()> work, std::coroutine_handle<> handle);
+
+    /**
+     * @brief Checks if the client that set deadline stopped waiting.
+     * @param deadline from the Deadline CoAP option, zero for none
+     */
+    bool Expired(Time deadline) const;
+
+    /**
+     * @brief Parses the "Tenants" attribute and creates the tenants.
+     */
+    void ParseTenants();
+
+    /**
+     * @brief Store path of an operation in the dataset of the current
+     *        tenant, or of the tenant of the step a store thread is running.
+     * @param operacao ex: "query", "update", "data?default"
+     * @param estado use the state service instead of the dataset
+     */
+    std::string StorePath(const std::string& operacao, bool estado = false) const;
+
+    /**
+     * @brief Registers a search and computes its first result.
+     *
+     * A tenant keeps at most MAX_STANDING_QUERIES queries; past that the
+     * search is answered with 5.03 until unused ones expire.
+     *
+     * @return {"queryId": N}, or an error response if the search was rejected
+     */
+    CotasTask RegisterStandingQuery(nlohmann::json consulta);
+
+    /**
+     * @brief Drops the standing queries of the tenant nobody registered
+     *        or requested for StandingQueryTimeout.
+     */
+    void ExpireStandingQueries();
+
+    /**
+     * @brief SELECT that checks the devices against a standing query.
+     * @param ids devices to check, all of them if empty
+     */
+    std::string StandingSparql(const StandingQuery& view, const std::vector<int32_t>& ids);
+
+    /**
+     * @brief Puts the store result of StandingSparql in the query.
+     */
+    void ApplyStandingResults(StandingQuery& view,
+                              const nlohmann::json& bindings,
+                              const std::vector<int32_t>& ids);
+
+    /**
+     * @brief Checks a changed device against the affected standing queries.
+     * @param changed update payload, null for a new device
+     */
+    CotasTask RefreshStandingQueries(int32_t id, nlohmann::json changed);
+
+    /**
+     * @brief Answers {"queryId": N} from the maintained result.
+     */
+    nlohmann::json HandleStandingRequest(Address from, uint32_t queryId);
+
+    /**
+     * @brief Answers /history: the samples or the rollup of one property
+     *        of a device in a time range.
+     */
+    nlohmann::json HandleHistory(Address from, const std::string& body);
+
+    /**
+     * @brief Indexes the classes, usedFor contexts and boolean states of a
+     *        new device.
+     */
+    CotasTask IndexCategories(int id, std::string payload);
+
+    /**
+     * @brief Devices matching the class, usedFor and boolean state parts of
+     *        the query; the boolean predicates are removed from it.
+     */
+    CotasBitmap BitmapFilter(CotasQuery& query);
+
+    /**
+     * @brief Answers a search fully resolved by the bitmaps.
+     */
+    nlohmann::json AnswerFromBitmap(const CotasBitmap& filtro,
+                                    CotasSelectionPolicy::Type politica,
+                                    const std::string& chave,
+                                    uint32_t cliente,
+                                    uint32_t limite,
+                                    const std::vector<std::string>& projecao = {});
+
+    /**
+     * @brief Reads the indexed numeric properties of a new device.
+     */
+    CotasTask IndexRanges(int id);
+
+    /**
+     * @brief Resolves the predicates on indexed properties; they are
+     *        removed from the query.
+     * @param ids devices satisfying all of them, in increasing order
+     * @return false if no predicate was resolved
+     */
+    bool RangeFilter(CotasQuery& query, std::vector<int32_t>& ids);
+
+    /**
+     * @brief Checks a store result against the index filters in use.
+     * @param filtro bitmap of accepted ordinals, or nullptr
+     * @param faixa sorted accepted objectIds, or nullptr
+     */
+    bool Allowed(int32_t id, const CotasBitmap* filtro, const std::vector<int32_t>* faixa);
+
     nlohmann::json HandleBadRequest();
 
     int RandomInt(int min, int max);
 
-    void SendReply(Ptr<Socket> socket, Ptr<Packet> response, Address from);
+    /**
+     * @brief Encodes a response, or a 5.00 if it does not fit a packet.
+     */
+    encoded_data EncodeReply(const nlohmann::json& response,
+                             const std::string& token,
+                             const std::vector<std::pair<uint16_t, std::string>>& options = {});
 
-    int ValidateIP_Q(Address ip);
+    /**
+     * @brief Sends a reply through the transport after delay.
+     */
+    void SendReply(const CotasTransport::Request& request, const encoded_data& data, Time delay);
 
     int ValidateID_Q(int id);
     
@@ -107,39 +916,234 @@ class CoTaS : public SinkApplication
 
     int Simple_Q();
 
-    int InsertDataSub_Q(int id, Address ip, std::string payload);
+    /**
+     * @brief Inserts each profile with its id and ip unless the ip is
+     *        already subscribed, in one SPARQL Update request with one
+     *        conditional insert per device, and reads back the ids that
+     *        hold the ips.
+     *
+     * The profiles go as the N-Triples of their parsed graphs, never as
+     * the text the client sent.
+     *
+     * Sets NewDevice::registered: its id if it was inserted, the id
+     * already subscribed with the ip, 0 if the id was taken.
+     *
+     * @return false if the store failed
+     */
+    bool RegisterDevices_Q(const std::vector<NewDevice*>& devices);
+
+    /**
+     * @brief Reads the cot classes and properties of a device model.
+     * @return false if the store failed
+     */
+    bool ModelInfo_Q(const std::string& model, Model& info);
+
+    /**
+     * @brief Stores the profile of a device model, unless it already has one.
+     * @return false if the store failed
+     */
+    bool RegisterModel_Q(const std::string& model, const std::string& turtle);
 
     void StartHandlerDict();
 
     std::string JsonToSparqlUpdateParser(nlohmann::json payload);
 
+    /// Store write built from update payloads
+    struct StoreWrite
+    {
+        std::string patch;  //!< RDF Patch for values with a known node
+        std::string sparql; //!< SPARQL update for the rest
+        bool state{false};  //!< sparql goes to the state service
+        std::vector<std::pair<int32_t, CotasDeviceGraph::Change>> changes; //!< id -> node change
+        bool patched{false}; //!< the store accepted the patch
+    };
+
+    /**
+     * @brief Builds the store write of update payloads, reading the device
+     *        graphs of the current tenant.
+     */
+    StoreWrite PrepareUpdate(const std::vector<nlohmann::json>& payloads);
+
+    /**
+     * @brief Sends a write to the store in one request per service; touches
+     *        nothing but the store and the write, so it may run as a step.
+     * @return false if the store rejected part of it
+     */
+    bool SendUpdate(StoreWrite& write);
+
+    /**
+     * @brief Moves the device graphs to the values the store accepted.
+     */
+    void CommitUpdate(const StoreWrite& write);
+
+    /**
+     * @brief Writes the dirty values of the state table to the store.
+     */
+    CotasTask FlushState();
+
+    /**
+     * @brief Flushes and schedules the next flush.
+     */
+    void ScheduleFlush();
+
+    /**
+     * @brief Reports the most frequent keys of each tenant and starts a
+     *        new period.
+     */
+    void DumpHotKeys();
+
+    /**
+     * @brief Dumps the hot keys and schedules the next dump.
+     */
+    void ScheduleHotKeys();
+
+    /**
+     * @brief cot:turnedOn of a subscription payload, 0 if absent.
+     */
+    int ProfileTurnedOn(const std::string& payload);
+
+    /**
+     * @brief Builds the update of a device state graph.
+     */
+    std::string JsonToStateUpdate(nlohmann::json payload);
+
+    /**
+     * @brief Creates the state graphs of new devices with their
+     *        cot:turnedOn, in one update.
+     */
+    void SeedState(const std::vector<NewDevice*>& devices);
+
+    /**
+     * @brief Graph pattern matching ?id of devices turned on.
+     */
+    std::string TurnedOnPattern();
+
     std::string SparqlPrefix();
 
      
     void SafeName(std::vector<std::string> tokens, 
         size_t start_index, std::vector<std::string> &safename);
 
+    /**
+     * @brief Indexes the cot:localization of a subscription payload.
+     */
+    void IndexLocation(int id, const std::string& payload);
+
+    /**
+     * @brief Resolves the "near"/"zone" part of a search in the spatial index.
+     * @return false if the zone is not configured
+     */
+    bool SpatialCandidates(const CotasQuery& query, CotasSpatialIndex::Result& candidates);
+
+    void ParseZones();
+
+    /**
+     * @brief Remembers, in the current tenant, the application class a
+     *        client subscribed as.
+     */
+    void RecordApplicationType(Address from, const std::string& payload);
+
+    /**
+     * @brief Selection policy for the application class the client
+     *        subscribed as in the current tenant.
+     */
+    CotasSelectionPolicy::Type PolicyFor(Address from);
+
+    void ParseSelectionPolicies();
+
     void UpdateElementHandler(std::ostringstream &sparql_delete,
                               std::ostringstream &sparql_insert,
                               std::unordered_set<std::string> &where_set,
                               std::string chave,
                               nlohmann::json valor);    
     
-    using HandlersFunctions = std::function<nlohmann::json(Address, coap_pdu_t*)>;
+    // o corpo chega ao handler já remontado, se veio em blocos
+    using HandlersFunctions = std::function<CotasTask(Address, std::string)>;
     std::unordered_map<std::string, HandlersFunctions> m_handlerDict;
     
     uint8_t m_tos;         //!< The packets Type of Service
+    uint32_t m_maxQueryCost; //!< Max estimated cost of a structured search
+    bool m_stateGraphs;      //!< volatile values go to per-device graphs without reasoner
+
+    Time m_flushInterval;         //!< period of FlushState, zero disables the table
+    EventId m_flushEvent;         //!< next FlushState
+
+    double m_spatialCellSize;         //!< grid cell side of the spatial indexes
+    std::string m_zonesConfig;        //!< "Zones" attribute
+    std::unordered_map<std::string, std::array<double, 4>> m_zones; //!< zone -> box
+
+    std::string m_selectionConfig;     //!< "SelectionPolicy" attribute
+    uint8_t m_affinityPrefixLength;    //!< subnet prefix shared under one AP
+    CotasSelectionPolicy::Type m_defaultPolicy{CotasSelectionPolicy::FIRST}; //!< policy for "*"
+    std::unordered_map<std::string, CotasSelectionPolicy::Type> m_policies; //!< app class -> policy
+
+    bool m_bitmapIndex;                                 //!< "BitmapIndex" attribute
+    std::string m_booleanStatesConfig;                  //!< "BooleanStates" attribute
+    std::unordered_set<std::string> m_booleanStates;    //!< keys indexed as booleans
+
+    std::string m_rangeIndexesConfig;                   //!< "RangeIndexes" attribute
+
+    bool m_historyEnabled;    //!< "History" attribute
+    Time m_historyRetention;  //!< samples older than this are dropped, zero keeps all
+
+    std::string m_tenantsConfig;               //!< "Tenants" attribute
+    std::map<std::string, Tenant> m_tenants;   //!< name -> tenant, "" is the default
+    std::vector<TenantSubnet> m_tenantSubnets; //!< client subnets of the tenants
+    Tenant* m_tenant{nullptr};                 //!< tenant of the request being handled
+
+    bool m_patchUpdates; //!< "PatchUpdates" attribute
+    bool m_singleFlight; //!< "SingleFlight" attribute
+
+    uint32_t m_hotKeys;     //!< keys reported per sketch, zero disables the sketches
+    Time m_hotKeysInterval; //!< period of DumpHotKeys, zero dumps only at the end
+    EventId m_hotKeysEvent; //!< next DumpHotKeys
+
+    Address m_upstream;        //!< CoTaS the digests go to, invalid outside a federation
+    Time m_digestInterval;     //!< period of SendDigests
+    uint32_t m_digestBits;     //!< size of the digests
+    Time m_federationTimeout;  //!< how long a federated search waits for the homes
+    bool m_storeCompression;        //!< encode the store traffic
+    uint32_t m_storeCompressionMin; //!< smallest request body compressed
+    StoreTraffic m_storeTraffic;    //!< bytes exchanged with the store
+    std::string m_storeHost;        //!< "StoreHost" attribute
+    uint16_t m_storePort;           //!< "StorePort" attribute
+    uint32_t m_storeThreads;        //!< "StoreThreads" attribute
+    CotasStorePool m_storePool;     //!< runs the store steps on the wall clock
+
+    /// tenant of the step a store thread is running, null elsewhere
+    static thread_local Tenant* s_storeTenant;
+    /// client of the store thread running a step, null elsewhere
+    static thread_local httplib::Client* s_storeClient;
+    EventId m_digestEvent;     //!< next SendDigests
+    std::unordered_map<uint32_t, FederatedCall> m_federatedCalls; //!< call -> waiting search
+    uint32_t m_nextCall{1};    //!< next call number, sent in the token
+
+    Time m_batchWindow;          //!< how long searches wait to be merged, zero disables
+    uint32_t m_maxBatchSize;     //!< a batch this big runs at once
+    CotasTransport* m_transport; //!< where the datagrams go, this by default
+    CotasTransport::Request m_request; //!< request being handled
+    std::string m_requestToken;  //!< token of the request being handled
+    Time m_requestDeadline;      //!< deadline of the request being handled, zero for none
+    Time m_blockTimeout;         //!< silence after which a Block1 request is dropped
+    Time m_standingTimeout;      //!< disuse after which a standing query is dropped
+    CotasBlockAssembler m_blocks; //!< Block1 requests by "ip:port path"
     Ptr<Socket> m_socket;  //!< Socket
     Ptr<Socket> m_socket6; //!< IPv6 Socket (used if only port is specified)
 
     
-    httplib::Client m_cli; //!< cliente http (aqui coloca a Uri do jena fuseki)
+    std::unique_ptr<httplib::Client> m_cli; //!< cliente http do jena fuseki, do StartService
     
     /// Callbacks for tracing the packet Rx events
     TracedCallback<Ptr<const Packet>> m_rxTrace;
     
     /// Callbacks for tracing the packet Rx events, includes source and destination addresses
     TracedCallback<Ptr<const Packet>, const Address&, const Address&> m_rxTraceWithAddresses;
+
+    /// Callbacks for the most frequent keys of each period
+    TracedCallback<const std::string&,
+                   const std::string&,
+                   const std::vector<CotasHeavyHitters::Entry>&>
+        m_hotKeysTrace;
     
     uint32_t m_recived_messages;
     uint32_t m_send_messages;
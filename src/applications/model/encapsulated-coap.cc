@@ -1,9 +1,22 @@
 #include "encapsulated-coap.h"
 #include <iostream>
 
+// pdu que não pôde ser montada: quem chamou decide o que fazer
+static encoded_data
+EncodeFailure(coap_pdu_t* pdu, const char* message)
+{
+    encoded_data dados;
+    printf("%s\n", message);
+    coap_delete_pdu(pdu);
+    dados.size = 0;
+    return dados;
+}
+
 encoded_data 
 EncodePduRequest(const char *uri_path, 
-    coap_pdu_code_t request_code, std::string data)
+    coap_pdu_code_t request_code, std::string data,
+    const std::vector<std::pair<uint16_t, std::string>>& options,
+    const std::string& token)
 {
     coap_pdu_t *pdu;
     encoded_data dados;
@@ -14,30 +27,42 @@ EncodePduRequest(const char *uri_path,
     pdu = coap_pdu_init(COAP_MESSAGE_CON, request_code, 0, BUFSIZE);
     if (!pdu)
     {
-        printf("falha em criar PDU CoAP no provedor.");
-        abort();
+        return EncodeFailure(pdu, "falha em criar PDU CoAP.");
+    }
+
+    // o token vem antes das opções
+    if (!token.empty() && !coap_add_token(pdu, token.size(), (const uint8_t*)token.data())){
+        return EncodeFailure(pdu, "falha em colocar o token na PDU CoAP.");
     }
 
     check = coap_add_option(pdu, COAP_OPTION_URI_PATH, strlen(uri_path), 
                             (const uint8_t*)uri_path);
     if (!check){
-        printf("falha em colocar um path na PDU CoAP no provedor.");
-        abort();
+        return EncodeFailure(pdu, "falha em colocar um path na PDU CoAP.");
+    }
+
+    // as opções vão depois do path, em ordem crescente de número
+    for (auto& [numero, valor] : options){
+        check = coap_add_option(pdu, numero, valor.size(), (const uint8_t*)valor.data());
+        if (!check){
+            return EncodeFailure(pdu, "falha em colocar uma opção na PDU CoAP.");
+        }
     }
 
     check = coap_add_data(pdu, data.size(), (const uint8_t*)data.c_str());
     if(!check){
-        printf("falha em colocar dados na PDU CoAP no provedor.");
-        abort();
+        return EncodeFailure(pdu, "falha em colocar dados na PDU CoAP.");
     }
 
     coap_pdu_encode_header(pdu, COAP_PROTO_UDP);
     dados.size = coap_pdu_dump(pdu, dados.buffer, BUFSIZE); 
+    coap_delete_pdu(pdu);
     return dados;
 }
 
 encoded_data 
-EncodePduResponse(coap_pdu_code_t response_code, std::string data){
+EncodePduResponse(coap_pdu_code_t response_code, std::string data, const std::string& token,
+    const std::vector<std::pair<uint16_t, std::string>>& options){
     coap_pdu_t *pdu;
     encoded_data dados;
     uint8_t check;
@@ -45,106 +70,135 @@ EncodePduResponse(coap_pdu_code_t response_code, std::string data){
     pdu = coap_pdu_init(COAP_MESSAGE_CON, response_code, 0, BUFSIZE);
     if (!pdu)
     {
-        printf("falha em criar PDU CoAP no provedor.");
-        abort();
+        return EncodeFailure(pdu, "falha em criar PDU CoAP.");
+    }
+
+    if (!token.empty() && !coap_add_token(pdu, token.size(), (const uint8_t*)token.data())){
+        return EncodeFailure(pdu, "falha em colocar o token na PDU CoAP.");
+    }
+
+    for (auto& [numero, valor] : options){
+        check = coap_add_option(pdu, numero, valor.size(), (const uint8_t*)valor.data());
+        if (!check){
+            return EncodeFailure(pdu, "falha em colocar uma opção na PDU CoAP.");
+        }
     }
 
     check = coap_add_data(pdu, data.size(), (const uint8_t*)data.c_str());
     if(!check){
-        printf("falha em colocar dados na PDU CoAP no provedor.");
-        abort();
+        return EncodeFailure(pdu, "falha em colocar dados na PDU CoAP.");
     }
 
     coap_pdu_encode_header(pdu, COAP_PROTO_UDP);
     dados.size = coap_pdu_dump(pdu, dados.buffer, BUFSIZE); 
+    coap_delete_pdu(pdu);
     return dados;
 }
 
-std::string 
-GetPduPath(coap_pdu_t* pdu)
+encoded_data
+EncodePduEmpty(coap_pdu_type_t type, coap_mid_t mid)
 {
-    std::stringstream path_stream;
-    coap_opt_iterator_t opt_iter;
-    coap_opt_t* opt;
-    std::string path;
-
-    opt = coap_check_option(pdu, COAP_OPTION_URI_PATH, &opt_iter);
-    if(opt){
-        path_stream.write(reinterpret_cast<const char*>(coap_opt_value(opt)), 
-            coap_opt_length(opt));
-    }else{
-        printf("Erro na interpretação do path");
-        abort();
-    }
-    
-    path = path_stream.str();
-    if (path.empty())
+    encoded_data dados;
+    coap_pdu_t* pdu = coap_pdu_init(type, COAP_EMPTY_CODE, mid, BUFSIZE);
+    if (!pdu)
     {
-        return "/"; // Se nenhum path foi encontrado, é uma requisição para a raiz.
+        return EncodeFailure(pdu, "falha em criar PDU CoAP.");
     }
-
-    return path;
+    coap_pdu_encode_header(pdu, COAP_PROTO_UDP);
+    dados.size = coap_pdu_dump(pdu, dados.buffer, BUFSIZE);
+    coap_delete_pdu(pdu);
+    return dados;
 }
 
-nlohmann::json
-GetPduPayloadJson(coap_pdu_t* pdu)
+std::string
+EncodeBlockOption(unsigned int num, bool more, unsigned int szx)
 {
-    const uint8_t *pdu_data;
-    size_t pdu_data_offset;
-    size_t pdu_data_total_length;
-    size_t pdu_data_length;
-    uint8_t check;
-    nlohmann::json payload;
+    uint8_t buffer[4];
+    unsigned int tamanho =
+        coap_encode_var_safe(buffer, sizeof(buffer), (num << 4) | (more << 3) | (szx & 7));
+    return std::string(reinterpret_cast<const char*>(buffer), tamanho);
+}
 
-    check = coap_get_data_large(pdu, &pdu_data_length, &pdu_data,
-                            &pdu_data_offset, &pdu_data_total_length);
+std::string
+EncodeUintOption(uint32_t value)
+{
+    uint8_t buffer[4];
+    unsigned int tamanho = coap_encode_var_safe(buffer, sizeof(buffer), value);
+    return std::string(reinterpret_cast<const char*>(buffer), tamanho);
+}
 
-    if(!check){
-        printf("Ocorreu um erro ao pegar o payload da pdu");
-        abort();
+bool
+GetPduPath(coap_pdu_t* pdu, std::string& path)
+{
+    coap_opt_iterator_t opt_iter;
+    coap_opt_t* opt = coap_check_option(pdu, COAP_OPTION_URI_PATH, &opt_iter);
+    if (!opt){
+        return false;
     }
-
-
-    try
+    path.assign(reinterpret_cast<const char*>(coap_opt_value(opt)), coap_opt_length(opt));
+    if (path.empty())
     {
-        payload = nlohmann::json::parse(pdu_data, pdu_data + pdu_data_total_length);
+        path = "/"; // Uri-Path vazio é uma requisição para a raiz.
     }
-    catch(const std::exception& e)
-    {
-        std::cerr << "Erro no parse do Json GetPduPayloadJson" << '\n';
-        std::cerr << e.what() << '\n';
+    return true;
+}
+
+bool
+GetPduOption(coap_pdu_t* pdu, coap_option_num_t number, std::string& value)
+{
+    coap_opt_iterator_t opt_iter;
+    coap_opt_t* opt = coap_check_option(pdu, number, &opt_iter);
+    if (!opt){
+        return false;
     }
+    value.assign(reinterpret_cast<const char*>(coap_opt_value(opt)), coap_opt_length(opt));
+    return true;
+}
 
-    return payload;
+bool
+GetPduUintOption(coap_pdu_t* pdu, coap_option_num_t number, uint32_t& value)
+{
+    coap_opt_iterator_t opt_iter;
+    coap_opt_t* opt = coap_check_option(pdu, number, &opt_iter);
+    if (!opt){
+        return false;
+    }
+    value = coap_decode_var_bytes(coap_opt_value(opt), coap_opt_length(opt));
+    return true;
 }
 
 std::string
-GetPduPayloadString(coap_pdu_t* pdu)
+GetPduToken(coap_pdu_t* pdu)
+{
+    coap_bin_const_t token = coap_pdu_get_token(pdu);
+    return std::string(reinterpret_cast<const char*>(token.s), token.length);
+}
+
+bool
+GetPduPayloadJson(coap_pdu_t* pdu, nlohmann::json& payload)
+{
+    std::string texto;
+    if (!GetPduPayloadString(pdu, texto))
+    {
+        return false;
+    }
+    payload = nlohmann::json::parse(texto, nullptr, false);
+    return !payload.is_discarded();
+}
+
+bool
+GetPduPayloadString(coap_pdu_t* pdu, std::string& payload)
 {
     const uint8_t *pdu_data;
     size_t pdu_data_offset;
     size_t pdu_data_total_length;
     size_t pdu_data_length;
-    uint8_t check;
-    std::string payload;
-
-    check = coap_get_data_large(pdu, &pdu_data_length, &pdu_data,
-                            &pdu_data_offset, &pdu_data_total_length);
 
-    if(!check){
-        printf("Ocorreu um erro ao pegar o payload do pdu");
-        abort();
-    }
-    try
-    {
-        std::string s (reinterpret_cast<const char*>(pdu_data), pdu_data_total_length);
-        payload = s;
-    }
-    catch(const std::exception& e)
-    {
-        std::cerr << "Ocorreu um erro no parse String GetPduPayloadString" << '\n';
-        std::cerr << e.what() << '\n';
+    payload.clear();
+    if (!coap_get_data_large(pdu, &pdu_data_length, &pdu_data,
+                             &pdu_data_offset, &pdu_data_total_length)){
+        return false;
     }
-    
-    return payload;
+    payload.assign(reinterpret_cast<const char*>(pdu_data), pdu_data_total_length);
+    return true;
 }
@@ -21,24 +21,60 @@
 
 #include <string>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #define BUFSIZE 1500
+// payload que sempre cabe numa pdu de BUFSIZE junto com o cabeçalho,
+// o token e as opções de uma resposta
+#define MAX_PAYLOAD (BUFSIZE - 64)
+
+// opção eletiva (número par) da faixa experimental: casa do cliente
+#define COAP_OPTION_TENANT 65000
+// opção eletiva da faixa experimental: milissegundos que o cliente ainda
+// espera pela resposta, contados de quando o pedido chega ao servidor
+#define COAP_OPTION_DEADLINE 65004
 
 typedef struct encoded_data{
   uintptr_t size;
   uint8_t buffer[BUFSIZE];
 }encoded_data;
 
+// as funções de codificação devolvem size 0 quando a pdu não pôde ser
+// montada, por exemplo quando os dados não cabem em BUFSIZE
 encoded_data EncodePduRequest( const char *uri_path, coap_pdu_code_t request_code, 
-      std::string data);
+      std::string data,
+      const std::vector<std::pair<uint16_t, std::string>>& options = {},
+      const std::string& token = "");
+
+// false se a pdu não tem payload ou ele não é um json
+bool GetPduPayloadJson(coap_pdu_t* pdu, nlohmann::json& payload);
+
+// false se a pdu não tem payload
+bool GetPduPayloadString(coap_pdu_t* pdu, std::string& payload);
+
+// false se a pdu não tem Uri-Path
+bool GetPduPath(coap_pdu_t* pdu, std::string& path);
+
+bool GetPduOption(coap_pdu_t* pdu, coap_option_num_t number, std::string& value);
+
+// opção de valor inteiro (uint), como a Deadline
+bool GetPduUintOption(coap_pdu_t* pdu, coap_option_num_t number, uint32_t& value);
+
+// token do pedido, que a resposta repete para o cliente casar as duas
+std::string GetPduToken(coap_pdu_t* pdu);
 
-nlohmann::json GetPduPayloadJson(coap_pdu_t* pdu);
+encoded_data EncodePduResponse(coap_pdu_code_t response_code, std::string data,
+      const std::string& token = "",
+      const std::vector<std::pair<uint16_t, std::string>>& options = {});
 
-std::string GetPduPayloadString(coap_pdu_t* pdu);
+// mensagem vazia (código 0.00), como o RST que responde a um ping
+encoded_data EncodePduEmpty(coap_pdu_type_t type, coap_mid_t mid);
 
-std::string GetPduPath(coap_pdu_t* pdu);
+// valor da opção Block1/Block2: número do bloco, se há mais e tamanho
+std::string EncodeBlockOption(unsigned int num, bool more, unsigned int szx);
 
-encoded_data EncodePduResponse(coap_pdu_code_t response_code, std::string data);
+std::string EncodeUintOption(uint32_t value);
 
 
 #endif /* ENCAPSULATED_COAP_H */
\ No newline at end of file
@@ -215,7 +215,7 @@ GenericServer::HandleRead(Ptr<Socket> socket)
                 abort();
             }
 
-            data = GetPduPayloadString(pdu);
+            GetPduPayloadJson(pdu, data);
             //* acaba aqui
 
             response_data = RandomData();
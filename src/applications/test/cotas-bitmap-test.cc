@@ -0,0 +1,171 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-bitmap.h"
+#include "ns3/cotas-category-index.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks CotasBitmap on both containers, across the array to bitset
+ * conversion and back, and its set operations.
+ */
+class CotasBitmapTestCase : public TestCase
+{
+  public:
+    CotasBitmapTestCase();
+    ~CotasBitmapTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasBitmapTestCase::CotasBitmapTestCase()
+    : TestCase("Bitmap add, remove and set operations on both containers")
+{
+}
+
+CotasBitmapTestCase::~CotasBitmapTestCase()
+{
+}
+
+void
+CotasBitmapTestCase::DoRun()
+{
+    CotasBitmap pares;
+    for (uint32_t v = 0; v < 2 * CotasBitmap::ARRAY_MAX + 2; v += 2)
+    {
+        pares.Add(v);
+    }
+    pares.Add(2); // repetido não conta
+    pares.Add(70000);
+    NS_TEST_ASSERT_MSG_EQ(pares.Cardinality(), CotasBitmap::ARRAY_MAX + 2, "past ARRAY_MAX");
+    NS_TEST_EXPECT_MSG_EQ(pares.Contains(4), true, "even value in the bitset container");
+    NS_TEST_EXPECT_MSG_EQ(pares.Contains(5), false, "odd value left out");
+    NS_TEST_EXPECT_MSG_EQ(pares.Contains(70000), true, "value of another container");
+
+    // remover abaixo do limite volta a ser vetor e não perde valores
+    pares.Remove(0);
+    pares.Remove(2);
+    pares.Remove(3);
+    NS_TEST_ASSERT_MSG_EQ(pares.Cardinality(), CotasBitmap::ARRAY_MAX, "two values removed");
+    NS_TEST_EXPECT_MSG_EQ(pares.Contains(2), false, "removed value");
+    NS_TEST_EXPECT_MSG_EQ(pares.Contains(8190), true, "kept value");
+
+    CotasBitmap poucos;
+    for (uint32_t v : {3u, 4u, 6u, 70000u, 80000u})
+    {
+        poucos.Add(v);
+    }
+
+    CotasBitmap e = pares;
+    e &= poucos;
+    NS_TEST_EXPECT_MSG_EQ(e.ToVector() == std::vector<uint32_t>({4, 6, 70000}),
+                          true,
+                          "intersection of a bitset and an array");
+
+    CotasBitmap ou = poucos;
+    ou |= pares;
+    NS_TEST_EXPECT_MSG_EQ(ou.Cardinality(), CotasBitmap::ARRAY_MAX + 2, "union adds 3 and 80000");
+
+    CotasBitmap menos = poucos;
+    menos -= pares;
+    NS_TEST_EXPECT_MSG_EQ(menos.ToVector() == std::vector<uint32_t>({3, 80000}),
+                          true,
+                          "difference keeps what the other lacks");
+
+    menos -= poucos;
+    NS_TEST_EXPECT_MSG_EQ(menos.Empty(), true, "nothing left");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that CotasCategoryIndex answers classes, usedFor contexts and
+ * boolean states through the ordinals of its devices.
+ */
+class CotasCategoryIndexTestCase : public TestCase
+{
+  public:
+    CotasCategoryIndexTestCase();
+    ~CotasCategoryIndexTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasCategoryIndexTestCase::CotasCategoryIndexTestCase()
+    : TestCase("Category index finds devices by class, usedFor and state")
+{
+}
+
+CotasCategoryIndexTestCase::~CotasCategoryIndexTestCase()
+{
+}
+
+void
+CotasCategoryIndexTestCase::DoRun()
+{
+    CotasCategoryIndex indice;
+    uint32_t relogio = indice.Add(101, 0x0a010107, 5683);
+    uint32_t coleira = indice.Add(102, 0x0a010108, 5684);
+    NS_TEST_EXPECT_MSG_EQ(indice.Add(101, 0, 0), relogio, "adding again keeps the ordinal");
+    NS_TEST_ASSERT_MSG_EQ(indice.All().Cardinality(), 2, "two devices");
+
+    indice.AddClass(101, "cot:SmartWatch");
+    indice.AddClass(102, "cot:PetCollar");
+    indice.AddUsedFor(101, "cot:HealthCare");
+    indice.AddUsedFor(102, "cot:PetCare");
+    indice.AddUsedFor(102, "cot:HealthCare");
+    indice.SetState(101, "turnedOn", true);
+    indice.SetState(102, "turnedOn", true);
+    indice.SetState(102, "turnedOn", false);
+
+    CotasBitmap classe = indice.Classes({"cot:SmartWatch", "cot:Unknown"});
+    NS_TEST_ASSERT_MSG_EQ(classe.Cardinality(), 1, "one smart watch");
+    NS_TEST_EXPECT_MSG_EQ(indice.Get(classe.ToVector()[0]).id, 101, "ordinal maps to the id");
+    NS_TEST_EXPECT_MSG_EQ(indice.Get(coleira).port, 5684, "device keeps its port");
+
+    NS_TEST_EXPECT_MSG_EQ(indice.UsedFor({"cot:HealthCare"}).Cardinality(), 2, "both health");
+    NS_TEST_EXPECT_MSG_EQ(indice.UsedFor({"cot:PetCare"}).Contains(coleira), true, "pet care");
+    NS_TEST_EXPECT_MSG_EQ(indice.ClassNames().size(), 2, "two classes in use");
+
+    // o último estado vale, e quem nunca informou não entra em nenhum lado
+    CotasBitmap ligados = indice.State("turnedOn", true);
+    NS_TEST_EXPECT_MSG_EQ(ligados.Contains(relogio), true, "watch is on");
+    NS_TEST_EXPECT_MSG_EQ(ligados.Contains(coleira), false, "collar was turned off");
+    NS_TEST_EXPECT_MSG_EQ(indice.State("turnedOn", false).Contains(coleira), true, "collar off");
+    NS_TEST_EXPECT_MSG_EQ(indice.State("charging", false).Empty(), true, "unknown state");
+
+    uint32_t ordinal = 0;
+    NS_TEST_EXPECT_MSG_EQ(indice.Ordinal(103, ordinal), false, "device not indexed");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasBitmap and CotasCategoryIndex TestSuite
+ */
+class CotasBitmapTestSuite : public TestSuite
+{
+  public:
+    CotasBitmapTestSuite();
+};
+
+CotasBitmapTestSuite::CotasBitmapTestSuite()
+    : TestSuite("cotas-bitmap", Type::UNIT)
+{
+    AddTestCase(new CotasBitmapTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasCategoryIndexTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasBitmapTestSuite cotasBitmapTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-test-transport.h"
+
+#include "ns3/cotas-block-assembler.h"
+#include "ns3/cotas.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks CotasBlockAssembler: a body in order, a restart, a lost block,
+ * and the caps on the body, the open transfers and their bytes.
+ */
+class CotasBlockAssemblerTestCase : public TestCase
+{
+  public:
+    CotasBlockAssemblerTestCase();
+    ~CotasBlockAssemblerTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasBlockAssemblerTestCase::CotasBlockAssemblerTestCase()
+    : TestCase("Block1 assembler joins, restarts, drops and caps transfers")
+{
+}
+
+CotasBlockAssemblerTestCase::~CotasBlockAssemblerTestCase()
+{
+}
+
+void
+CotasBlockAssemblerTestCase::DoRun()
+{
+    CotasBlockAssembler blocos(40, 2, 50);
+    std::string corpo = "antigo";
+
+    NS_TEST_ASSERT_MSG_EQ(blocos.Add("a", 0, true, 16, std::string(16, 'x'), 0, corpo),
+                          CotasBlockAssembler::MORE,
+                          "first block kept");
+    NS_TEST_ASSERT_MSG_EQ(blocos.Add("a", 1, false, 16, "fim", 1, corpo),
+                          CotasBlockAssembler::DONE,
+                          "last block completes the body");
+    NS_TEST_EXPECT_MSG_EQ(corpo, std::string(16, 'x') + "fim", "whole body, nothing stale");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Transfers(), 0, "done transfer is forgotten");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Bytes(), 0, "and so are its bytes");
+
+    // um corpo de um bloco só não deixa nada para trás
+    NS_TEST_ASSERT_MSG_EQ(blocos.Add("a", 0, false, 16, "solo", 2, corpo),
+                          CotasBlockAssembler::DONE,
+                          "single block body");
+    NS_TEST_EXPECT_MSG_EQ(corpo, "solo", "body of the single block");
+
+    // bloco 0 de novo recomeça; bloco pulado derruba a transferência
+    blocos.Add("b", 0, true, 16, std::string(16, 'y'), 3, corpo);
+    blocos.Add("b", 0, true, 16, std::string(16, 'z'), 4, corpo);
+    NS_TEST_EXPECT_MSG_EQ(blocos.Bytes(), 16, "restart drops the old blocks");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Add("b", 2, true, 16, std::string(16, 'z'), 5, corpo),
+                          CotasBlockAssembler::OUT_OF_ORDER,
+                          "block 1 was skipped");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Transfers(), 0, "out of order drops the transfer");
+
+    // corpo acima de maxBody
+    blocos.Add("c", 0, true, 16, std::string(16, 'c'), 6, corpo);
+    blocos.Add("c", 1, true, 16, std::string(16, 'c'), 7, corpo);
+    NS_TEST_EXPECT_MSG_EQ(blocos.Add("c", 2, false, 16, std::string(16, 'c'), 8, corpo),
+                          CotasBlockAssembler::TOO_LARGE,
+                          "48 bytes over maxBody 40");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Bytes(), 0, "too large drops the transfer");
+
+    // transferências abertas e bytes somados têm limite
+    blocos.Add("d", 0, true, 16, std::string(16, 'd'), 9, corpo);
+    blocos.Add("e", 0, true, 16, std::string(16, 'e'), 9, corpo);
+    NS_TEST_EXPECT_MSG_EQ(blocos.Add("f", 0, true, 16, std::string(16, 'f'), 9, corpo),
+                          CotasBlockAssembler::BUSY,
+                          "over maxTransfers");
+    blocos.Add("d", 1, true, 16, std::string(16, 'd'), 10, corpo);
+    NS_TEST_EXPECT_MSG_EQ(blocos.Add("e", 1, true, 16, std::string(16, 'e'), 10, corpo),
+                          CotasBlockAssembler::BUSY,
+                          "64 bytes over maxBytes 50");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Transfers(), 1, "the busy transfer was dropped");
+
+    // quem ficou quieto sai no Expire
+    blocos.Expire(11);
+    NS_TEST_EXPECT_MSG_EQ(blocos.Transfers(), 0, "idle transfer expired");
+    NS_TEST_EXPECT_MSG_EQ(blocos.Bytes(), 0, "with its bytes");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Sends /subscribe/bulk bodies in blocks through CoTaS::HandleDatagram and
+ * checks that each request is answered from its own body, never from the
+ * body of an earlier transfer. The checks stop before the store, so no
+ * Fuseki is needed.
+ */
+class CotasBlockDatagramTestCase : public TestCase
+{
+  public:
+    CotasBlockDatagramTestCase();
+    ~CotasBlockDatagramTestCase() override;
+
+  private:
+    void DoRun() override;
+
+    /// Hands a request to CoTaS and decodes its reply, if one came
+    bool Send(const encoded_data& pedido, coap_pdu_code_t& codigo, nlohmann::json& resposta);
+
+    Ptr<CoTaS> m_cotas;             //!< server under test
+    CotasTestTransport m_transport; //!< keeps the replies
+    Address m_client;               //!< client of every request
+};
+
+CotasBlockDatagramTestCase::CotasBlockDatagramTestCase()
+    : TestCase("Block1 requests through HandleDatagram never reuse a stale body")
+{
+}
+
+CotasBlockDatagramTestCase::~CotasBlockDatagramTestCase()
+{
+}
+
+bool
+CotasBlockDatagramTestCase::Send(const encoded_data& pedido,
+                                 coap_pdu_code_t& codigo,
+                                 nlohmann::json& resposta)
+{
+    size_t antes = m_transport.replies.size();
+    m_cotas->HandleDatagram(pedido.buffer, pedido.size, {m_client, nullptr});
+    return m_transport.replies.size() > antes &&
+           CotasTestTransport::Decode(m_transport.replies.back(), codigo, resposta);
+}
+
+void
+CotasBlockDatagramTestCase::DoRun()
+{
+    m_cotas = CreateObject<CoTaS>();
+    m_cotas->SetTransport(&m_transport);
+    m_cotas->StartService();
+    m_client = InetSocketAddress(Ipv4Address("10.1.1.7"), 40000);
+
+    // lote acima de MAX_BULK_DEVICES, grande demais para um pacote
+    nlohmann::json lote = nlohmann::json::array();
+    for (size_t i = 0; i <= CoTaS::MAX_BULK_DEVICES; i++)
+    {
+        lote.push_back({{"address", "10.1.1.9"}, {"subscription", "cot:Device a cot:Object ."}});
+    }
+    std::string corpo = lote.dump();
+    const unsigned int szx = 6; // blocos de 1024 bytes
+    const size_t tamanho = 1024;
+    NS_TEST_ASSERT_MSG_GT(corpo.size(), 2 * tamanho, "body needs several blocks");
+
+    coap_pdu_code_t codigo;
+    nlohmann::json resposta;
+    size_t blocos = (corpo.size() + tamanho - 1) / tamanho;
+    for (size_t num = 0; num < blocos; num++)
+    {
+        bool mais = num + 1 < blocos;
+        encoded_data pedido =
+            EncodePduRequest("/subscribe/bulk",
+                             COAP_REQUEST_CODE_POST,
+                             corpo.substr(num * tamanho, tamanho),
+                             {{COAP_OPTION_BLOCK1, EncodeBlockOption(num, mais, szx)}});
+        NS_TEST_ASSERT_MSG_EQ(Send(pedido, codigo, resposta), true, "block " << num << " answered");
+        if (mais)
+        {
+            NS_TEST_ASSERT_MSG_EQ(codigo, COAP_RESPONSE_CODE_CONTINUE, "2.31 until the last block");
+        }
+    }
+    NS_TEST_EXPECT_MSG_EQ(codigo,
+                          COAP_RESPONSE_CODE_REQUEST_TOO_LARGE,
+                          "handler saw the whole reassembled body");
+
+    // o pedido seguinte, sem blocos, tem só o próprio corpo
+    encoded_data simples =
+        EncodePduRequest("/subscribe/bulk", COAP_REQUEST_CODE_POST, "{\"not\": \"an array\"}");
+    NS_TEST_ASSERT_MSG_EQ(Send(simples, codigo, resposta), true, "plain request answered");
+    NS_TEST_EXPECT_MSG_EQ(codigo, COAP_RESPONSE_CODE_BAD_REQUEST, "answered from its own body");
+
+    // transferência largada no meio também não vaza para o próximo pedido
+    encoded_data primeiro =
+        EncodePduRequest("/subscribe/bulk",
+                         COAP_REQUEST_CODE_POST,
+                         corpo.substr(0, tamanho),
+                         {{COAP_OPTION_BLOCK1, EncodeBlockOption(0, true, szx)}});
+    Send(primeiro, codigo, resposta);
+    NS_TEST_ASSERT_MSG_EQ(Send(simples, codigo, resposta), true, "plain request answered");
+    NS_TEST_EXPECT_MSG_EQ(codigo, COAP_RESPONSE_CODE_BAD_REQUEST, "open transfer left aside");
+
+    // bloco fora de ordem: 4.08 e o cliente recomeça
+    encoded_data pulado =
+        EncodePduRequest("/subscribe/bulk",
+                         COAP_REQUEST_CODE_POST,
+                         corpo.substr(2 * tamanho, tamanho),
+                         {{COAP_OPTION_BLOCK1, EncodeBlockOption(2, true, szx)}});
+    NS_TEST_ASSERT_MSG_EQ(Send(pulado, codigo, resposta), true, "lost block answered");
+    NS_TEST_EXPECT_MSG_EQ(codigo, COAP_RESPONSE_CODE_INCOMPLETE, "block 1 never arrived");
+
+    m_cotas->StopService();
+    m_cotas = nullptr;
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Block1 TestSuite
+ */
+class CotasBlockAssemblerTestSuite : public TestSuite
+{
+  public:
+    CotasBlockAssemblerTestSuite();
+};
+
+CotasBlockAssemblerTestSuite::CotasBlockAssemblerTestSuite()
+    : TestSuite("cotas-block-assembler", Type::UNIT)
+{
+    AddTestCase(new CotasBlockAssemblerTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasBlockDatagramTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasBlockAssemblerTestSuite
+    cotasBlockAssemblerTestSuite; //!< Static variable for test initialization
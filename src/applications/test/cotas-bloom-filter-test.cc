@@ -0,0 +1,101 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-bloom-filter.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks the federation digest: no false negatives, a false positive
+ * rate near the expected one, and the hex form a home sends upstream.
+ */
+class CotasBloomFilterTestCase : public TestCase
+{
+  public:
+    CotasBloomFilterTestCase();
+    ~CotasBloomFilterTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasBloomFilterTestCase::CotasBloomFilterTestCase()
+    : TestCase("Bloom digest membership and hex round-trip")
+{
+}
+
+CotasBloomFilterTestCase::~CotasBloomFilterTestCase()
+{
+}
+
+void
+CotasBloomFilterTestCase::DoRun()
+{
+    // o resumo de uma casa como no SendDigests: classes como vêm, contextos
+    // com o prefixo usedFor:
+    CotasBloomFilter resumo(512, 4);
+    for (int i = 0; i < 40; i++)
+    {
+        resumo.Add("cot:Class" + std::to_string(i));
+    }
+    resumo.Add("usedFor:cot:PetCare");
+
+    for (int i = 0; i < 40; i++)
+    {
+        NS_TEST_ASSERT_MSG_EQ(resumo.MayContain("cot:Class" + std::to_string(i)),
+                              true,
+                              "added name " << i << " is never missed");
+    }
+    NS_TEST_EXPECT_MSG_EQ(resumo.MayContain("usedFor:cot:PetCare"), true, "added context");
+
+    // 41 nomes em 512 bits com 4 hashes: uns 2% de falsos positivos
+    int falsos = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        falsos += resumo.MayContain("cot:Other" + std::to_string(i));
+    }
+    NS_TEST_EXPECT_MSG_LT(falsos, 80, "false positives near the expected rate");
+    NS_TEST_EXPECT_MSG_EQ(resumo.MayContain("cot:PetCare"), false, "prefix is part of the name");
+
+    CotasBloomFilter lido;
+    NS_TEST_ASSERT_MSG_EQ(CotasBloomFilter::FromHex(resumo.ToHex(), resumo.Hashes(), lido),
+                          true,
+                          "hex read back");
+    NS_TEST_EXPECT_MSG_EQ(lido == resumo, true, "same bits after the round-trip");
+    NS_TEST_EXPECT_MSG_EQ(resumo.ToHex().size(), 128, "512 bits in hex");
+
+    NS_TEST_EXPECT_MSG_EQ(CotasBloomFilter::FromHex("", 4, lido), false, "empty text");
+    NS_TEST_EXPECT_MSG_EQ(CotasBloomFilter::FromHex("0123", 4, lido), false, "partial word");
+    NS_TEST_EXPECT_MSG_EQ(CotasBloomFilter::FromHex("0123456789ABCDEF", 4, lido),
+                          false,
+                          "upper case is not what ToHex writes");
+    NS_TEST_EXPECT_MSG_EQ(CotasBloomFilter::FromHex(resumo.ToHex(), 0, lido), false, "no hashes");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasBloomFilter TestSuite
+ */
+class CotasBloomFilterTestSuite : public TestSuite
+{
+  public:
+    CotasBloomFilterTestSuite();
+};
+
+CotasBloomFilterTestSuite::CotasBloomFilterTestSuite()
+    : TestSuite("cotas-bloom-filter", Type::UNIT)
+{
+    AddTestCase(new CotasBloomFilterTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasBloomFilterTestSuite
+    cotasBloomFilterTestSuite; //!< Static variable for test initialization
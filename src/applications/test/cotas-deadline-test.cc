@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-test-transport.h"
+
+#include "ns3/cotas.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Sends requests with and without the Deadline option through
+ * CoTaS::HandleDatagram: a request whose budget is already spent on
+ * arrival gets no reply, the others are answered. The requests are
+ * refused before the store, so no Fuseki is needed.
+ */
+class CotasDeadlineTestCase : public TestCase
+{
+  public:
+    CotasDeadlineTestCase();
+    ~CotasDeadlineTestCase() override;
+
+  private:
+    void DoRun() override;
+
+    /// Hands a /subscribe/bulk request to CoTaS at the current time
+    void Send(std::vector<std::pair<uint16_t, std::string>> opcoes);
+
+    Ptr<CoTaS> m_cotas;             //!< server under test
+    CotasTestTransport m_transport; //!< keeps the replies
+};
+
+CotasDeadlineTestCase::CotasDeadlineTestCase()
+    : TestCase("Requests past their deadline are dropped without a reply")
+{
+}
+
+CotasDeadlineTestCase::~CotasDeadlineTestCase()
+{
+}
+
+void
+CotasDeadlineTestCase::Send(std::vector<std::pair<uint16_t, std::string>> opcoes)
+{
+    encoded_data pedido =
+        EncodePduRequest("/subscribe/bulk", COAP_REQUEST_CODE_POST, "[]", opcoes);
+    m_cotas->HandleDatagram(pedido.buffer,
+                            pedido.size,
+                            {InetSocketAddress(Ipv4Address("10.1.1.7"), 40000), nullptr});
+}
+
+void
+CotasDeadlineTestCase::DoRun()
+{
+    m_cotas = CreateObject<CoTaS>();
+    m_cotas->SetTransport(&m_transport);
+    m_cotas->StartService();
+
+    // lote vazio é recusado com 4.00 sem passar pelo banco
+    using Opcoes = std::vector<std::pair<uint16_t, std::string>>;
+    Simulator::Schedule(Seconds(1), &CotasDeadlineTestCase::Send, this, Opcoes{});
+    Simulator::Schedule(Seconds(2),
+                        &CotasDeadlineTestCase::Send,
+                        this,
+                        Opcoes{{COAP_OPTION_DEADLINE, EncodeUintOption(0)}});
+    Simulator::Schedule(Seconds(3),
+                        &CotasDeadlineTestCase::Send,
+                        this,
+                        Opcoes{{COAP_OPTION_DEADLINE, EncodeUintOption(500)}});
+    Simulator::Stop(Seconds(4));
+    Simulator::Run();
+
+    // a sem prazo e a com 500 ms respondem; a de prazo zero já chegou vencida
+    NS_TEST_ASSERT_MSG_EQ(m_transport.replies.size(), 2, "the expired request got no reply");
+    for (auto& resposta : m_transport.replies)
+    {
+        coap_pdu_code_t codigo;
+        nlohmann::json corpo;
+        NS_TEST_ASSERT_MSG_EQ(CotasTestTransport::Decode(resposta, codigo, corpo),
+                              true,
+                              "reply is a CoAP message");
+        NS_TEST_EXPECT_MSG_EQ(codigo, COAP_RESPONSE_CODE_BAD_REQUEST, "empty bulk refused");
+    }
+
+    m_cotas->StopService();
+    m_cotas = nullptr;
+    Simulator::Destroy();
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Deadline TestSuite
+ */
+class CotasDeadlineTestSuite : public TestSuite
+{
+  public:
+    CotasDeadlineTestSuite();
+};
+
+CotasDeadlineTestSuite::CotasDeadlineTestSuite()
+    : TestSuite("cotas-deadline", Type::UNIT)
+{
+    AddTestCase(new CotasDeadlineTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasDeadlineTestSuite cotasDeadlineTestSuite; //!< Static variable for test initialization
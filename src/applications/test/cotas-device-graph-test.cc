@@ -0,0 +1,342 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-device-graph.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+namespace
+{
+
+const std::string PREFIXOS = "BASE <http://example.org/devices>\n"
+                             "PREFIX cot: <http://example.org/cot#>\n"
+                             "PREFIX xsd: <http://www.w3.org/2001/XMLSchema#>\n";
+const std::string COT = "http://example.org/cot#";
+const std::string XSD = "http://www.w3.org/2001/XMLSchema#";
+
+/// cot: name in N-Triples form
+std::string
+Cot(const std::string& nome)
+{
+    return "<" + COT + nome + ">";
+}
+
+/// IRI minted for the n-th blank node of the device
+std::string
+No(const std::string& dispositivo, int n)
+{
+    return "<" + CotasDeviceGraph::SKOLEM_PREFIX + dispositivo + "-" + std::to_string(n) + ">";
+}
+
+/// typed literal in N-Triples form
+std::string
+Literal(const std::string& texto, const std::string& tipo)
+{
+    return "\"" + texto + "\"^^<" + XSD + tipo + ">";
+}
+
+} // namespace
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Parses a profile with nested blank nodes, ';' and ',' lists and typed
+ * and language literals, then checks the minted node names, the N-Triples
+ * and Turtle written back, Rename, and the RDF Patch of an update key.
+ */
+class CotasDeviceGraphParseTestCase : public TestCase
+{
+  public:
+    CotasDeviceGraphParseTestCase();
+    ~CotasDeviceGraphParseTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasDeviceGraphParseTestCase::CotasDeviceGraphParseTestCase()
+    : TestCase("Device graph parses, names blank nodes, renames and patches")
+{
+}
+
+CotasDeviceGraphParseTestCase::~CotasDeviceGraphParseTestCase()
+{
+}
+
+void
+CotasDeviceGraphParseTestCase::DoRun()
+{
+    const std::string perfil =
+        "# lâmpada da sala\n"
+        "<#lamp> a cot:SmartLamp , cot:Light ;\n"
+        "    cot:powerSupply [ a cot:Battery ; cot:batteryLevel 80 ; ] ;\n"
+        "    cot:location [ cot:room [ cot:name \"sala\"@pt-BR ] ] ;\n"
+        "    cot:serial \"A1\"^^xsd:string ;\n"
+        "    cot:weight \"1.5\"^^<http://www.w3.org/2001/XMLSchema#decimal> ;\n"
+        "    cot:dimmable true ;\n"
+        "    cot:objectId 7 .";
+    CotasDeviceGraph grafo;
+    std::string texto;
+    NS_TEST_ASSERT_MSG_EQ(grafo.Parse(perfil, PREFIXOS, "7", texto), true, "profile parsed");
+    const std::string lampada = "<http://example.org/devices#lamp>";
+    NS_TEST_EXPECT_MSG_EQ(grafo.Subject(), lampada, "BASE resolves <#lamp>");
+
+    // nós em branco numerados na ordem em que abrem
+    std::string triplas = grafo.NTriples();
+    auto tem = [&triplas](const std::string& s, const std::string& p, const std::string& o) {
+        return triplas.find(s + " " + p + " " + o + " .\n") != std::string::npos;
+    };
+    const std::string tipo = "<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>";
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, tipo, Cot("SmartLamp")), true, "first of a ',' list");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, tipo, Cot("Light")), true, "second of a ',' list");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, Cot("powerSupply"), No("7", 0)), true, "first node");
+    NS_TEST_EXPECT_MSG_EQ(tem(No("7", 0), tipo, Cot("Battery")), true, "type of the node");
+    NS_TEST_EXPECT_MSG_EQ(tem(No("7", 0), Cot("batteryLevel"), Literal("80", "integer")),
+                          true,
+                          "number after a trailing ';'");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, Cot("location"), No("7", 1)), true, "second node");
+    NS_TEST_EXPECT_MSG_EQ(tem(No("7", 1), Cot("room"), No("7", 2)), true, "nested node");
+    NS_TEST_EXPECT_MSG_EQ(tem(No("7", 2), Cot("name"), "\"sala\"@pt-BR"),
+                          true,
+                          "language literal");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, Cot("serial"), Literal("A1", "string")),
+                          true,
+                          "datatype by prefixed name");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, Cot("weight"), Literal("1.5", "decimal")),
+                          true,
+                          "datatype by IRI");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, Cot("dimmable"), Literal("true", "boolean")),
+                          true,
+                          "boolean keyword");
+    NS_TEST_EXPECT_MSG_EQ(tem(lampada, Cot("objectId"), Literal("7", "integer")),
+                          true,
+                          "last statement");
+
+    // o turtle devolvido tem os nós primeiro e o dispositivo no fim
+    const std::string minted = "<" + CotasDeviceGraph::SKOLEM_PREFIX;
+    NS_TEST_EXPECT_MSG_EQ(texto.compare(0, minted.size(), minted), 0, "named nodes come first");
+    NS_TEST_EXPECT_MSG_EQ(texto.substr(texto.size() - 2), " .", "device statement last");
+    CotasDeviceGraph copia;
+    std::string deNovo;
+    NS_TEST_ASSERT_MSG_EQ(copia.Parse(texto, PREFIXOS, "7", deNovo), true, "output parses");
+    NS_TEST_EXPECT_MSG_EQ(copia.NTriples(), triplas, "and gives the same triples");
+    std::string semLocal = grafo.Serialize({"location"});
+    NS_TEST_EXPECT_MSG_EQ(semLocal.find(No("7", 1)), std::string::npos, "dropped property");
+    NS_TEST_EXPECT_MSG_EQ(semLocal.find(No("7", 2)), std::string::npos, "and what it reaches");
+
+    // o patch troca só a tripla do valor, pelo nó nomeado
+    std::string operacoes;
+    CotasDeviceGraph::Change troca;
+    NS_TEST_ASSERT_MSG_EQ(grafo.Patch("powerSupply/Battery.batteryLevel", 20, operacoes, troca),
+                          true,
+                          "typed path resolves");
+    std::string slot = No("7", 0) + " " + Cot("batteryLevel") + " ";
+    NS_TEST_EXPECT_MSG_EQ(operacoes,
+                          "D " + slot + Literal("80", "integer") + " .\n" + "A " + slot +
+                              Literal("20", "integer") + " .\n",
+                          "delete the old value, add the new");
+    grafo.Commit(troca);
+    operacoes.clear();
+    grafo.Patch("powerSupply.batteryLevel", 15.5, operacoes, troca);
+    NS_TEST_EXPECT_MSG_EQ(operacoes.find("D " + slot + Literal("20", "integer")),
+                          0,
+                          "the committed value is the old one now");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Patch("powerSupply/Charger.batteryLevel", 1, operacoes, troca),
+                          false,
+                          "node of another type");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Patch("brightness", 1, operacoes, troca),
+                          false,
+                          "no old value to replace");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Patch("serial", nlohmann::json::array(), operacoes, troca),
+                          false,
+                          "value without a term");
+
+    // o dispositivo muda de IRI e aponta para o perfil original
+    const std::string instancia = "<urn:cot:device7>";
+    NS_TEST_ASSERT_MSG_EQ(grafo.Rename(instancia), true, "renamed");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Subject(), instancia, "new subject");
+    triplas = grafo.NTriples();
+    NS_TEST_EXPECT_MSG_EQ(tem(instancia, Cot("instanceOf"), lampada), true, "old IRI kept");
+    NS_TEST_EXPECT_MSG_EQ(tem(instancia, Cot("powerSupply"), No("7", 0)),
+                          true,
+                          "properties moved to the new IRI");
+    NS_TEST_EXPECT_MSG_EQ(triplas.find(lampada + " " + Cot("objectId")),
+                          std::string::npos,
+                          "nothing left on the old IRI");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Rename(instancia), false, "same IRI again");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that malformed profiles are refused by Parse instead of reaching
+ * the store.
+ */
+class CotasDeviceGraphMalformedTestCase : public TestCase
+{
+  public:
+    CotasDeviceGraphMalformedTestCase();
+    ~CotasDeviceGraphMalformedTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasDeviceGraphMalformedTestCase::CotasDeviceGraphMalformedTestCase()
+    : TestCase("Device graph refuses malformed profiles")
+{
+}
+
+CotasDeviceGraphMalformedTestCase::~CotasDeviceGraphMalformedTestCase()
+{
+}
+
+void
+CotasDeviceGraphMalformedTestCase::DoRun()
+{
+    const std::vector<std::pair<std::string, std::string>> ruins = {
+        {"<#d> cot:serial \"x\"^^ .", "datatype without a name"},
+        {"<#d> cot:serial \"x\"^^", "datatype at the end"},
+        {"<#d> cot:serial \"x\"@ .", "language without a tag"},
+        {"<#d> cot:serial \"x\"^^foo:bar .", "datatype of an unknown prefix"},
+        {"<#d> cot:serial \"x\"^^<http://x .", "unclosed datatype IRI"},
+        {"<#d> foo:serial 1 .", "unknown prefix"},
+        {"<#d> cot:serial 1", "missing '.'"},
+        {"<#d> cot:serial \"x .", "unclosed literal"},
+        {"<#d> cot:serial \"\"\"x\"\"\" .", "long literal"},
+        {"<#d> cot:parts ( 1 2 ) .", "collection"},
+        {"<#d> cot:serial 'x' .", "single quotes"},
+        {"<#d> cot:p [ cot:q 1 .", "unclosed blank node"},
+        {"<#d> cot:p 1 , .", "',' without an object"},
+        {"<#d> \"x\" 1 .", "literal as predicate"},
+        {"\"x\" cot:p 1 .", "literal as subject"},
+        {"<#d .", "unclosed IRI"},
+        {"", "empty profile"}};
+    for (auto& [perfil, motivo] : ruins)
+    {
+        CotasDeviceGraph grafo;
+        std::string texto;
+        NS_TEST_EXPECT_MSG_EQ(grafo.Parse(perfil, PREFIXOS, "1", texto), false, motivo);
+    }
+
+    CotasDeviceGraph grafo;
+    std::string texto;
+    NS_TEST_EXPECT_MSG_EQ(grafo.Parse("<#d> cot:p 1 .", "PREFIX cot: http://x#", "1", texto),
+                          false,
+                          "prefix without <>");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Parse("<#d> cot:p 1 .", "IMPORT <http://x>", "1", texto),
+                          false,
+                          "unknown declaration");
+    NS_TEST_EXPECT_MSG_EQ(grafo.Rename("<urn:x>"), false, "nothing to rename");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that Compose writes update-style keys as a profile Parse reads,
+ * and refuses keys and values that would not be valid Turtle.
+ */
+class CotasDeviceGraphComposeTestCase : public TestCase
+{
+  public:
+    CotasDeviceGraphComposeTestCase();
+    ~CotasDeviceGraphComposeTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasDeviceGraphComposeTestCase::CotasDeviceGraphComposeTestCase()
+    : TestCase("Device graph composes profiles from update keys")
+{
+}
+
+CotasDeviceGraphComposeTestCase::~CotasDeviceGraphComposeTestCase()
+{
+}
+
+void
+CotasDeviceGraphComposeTestCase::DoRun()
+{
+    nlohmann::json valores = {{"powerSupply/Battery.batteryLevel", 80},
+                              {"label", "sala"},
+                              {"dimmable", true},
+                              {"objectId", 9}};
+    std::string turtle;
+    NS_TEST_ASSERT_MSG_EQ(CotasDeviceGraph::Compose("<urn:cot:device9>",
+                                                    {"a cot:SmartLamp"},
+                                                    valores,
+                                                    turtle),
+                          true,
+                          "profile composed");
+
+    // o que sai do Compose é lido pelo Parse como qualquer perfil
+    CotasDeviceGraph grafo;
+    std::string texto;
+    NS_TEST_ASSERT_MSG_EQ(grafo.Parse(turtle, PREFIXOS, "9", texto), true, "composed parses");
+    std::string triplas = grafo.NTriples();
+    const std::string dispositivo = "<urn:cot:device9>";
+    auto tem = [&triplas](const std::string& s, const std::string& p, const std::string& o) {
+        return triplas.find(s + " " + p + " " + o + " .\n") != std::string::npos;
+    };
+    const std::string tipo = "<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>";
+    NS_TEST_EXPECT_MSG_EQ(tem(dispositivo, tipo, Cot("SmartLamp")), true, "statement kept");
+    NS_TEST_EXPECT_MSG_EQ(tem(No("9", 0), tipo, Cot("Battery")), true, "'/' types the node");
+    NS_TEST_EXPECT_MSG_EQ(tem(No("9", 0), Cot("batteryLevel"), Literal("80", "integer")),
+                          true,
+                          "'.' walks into the node");
+    NS_TEST_EXPECT_MSG_EQ(tem(dispositivo, Cot("label"), "\"sala\""), true, "string value");
+    NS_TEST_EXPECT_MSG_EQ(tem(dispositivo, Cot("dimmable"), Literal("true", "boolean")),
+                          true,
+                          "boolean value");
+
+    const std::vector<std::pair<nlohmann::json, std::string>> ruins = {
+        {{{"a", {1, 2}}}, "array value"},
+        {{{"a", {{"b", 1}}}}, "object value"},
+        {{{"a", nullptr}}, "null value"},
+        {{{"-a", 1}}, "name starting with '-'"},
+        {{{"a.-b", 1}}, "inner name starting with '-'"},
+        {{{"a/-T.b", 1}}, "class starting with '-'"},
+        {{{"a//T.b", 1}}, "empty class"},
+        {{{"a/.b", 1}}, "class missing after '/'"},
+        {{{"/a.b", 1}}, "'/' before the name"},
+        {{{"a..b", 1}}, "empty name"},
+        {{{"a/T", 1}}, "typed property"},
+        {{{"a b", 1}}, "space in the name"}};
+    for (auto& [ruim, motivo] : ruins)
+    {
+        NS_TEST_EXPECT_MSG_EQ(CotasDeviceGraph::Compose("<urn:x>", {}, ruim, turtle),
+                              false,
+                              motivo);
+    }
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasDeviceGraph TestSuite
+ */
+class CotasDeviceGraphTestSuite : public TestSuite
+{
+  public:
+    CotasDeviceGraphTestSuite();
+};
+
+CotasDeviceGraphTestSuite::CotasDeviceGraphTestSuite()
+    : TestSuite("cotas-device-graph", Type::UNIT)
+{
+    AddTestCase(new CotasDeviceGraphParseTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasDeviceGraphMalformedTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasDeviceGraphComposeTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasDeviceGraphTestSuite
+    cotasDeviceGraphTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-heavy-hitters.h"
+#include "ns3/test.h"
+
+#include <map>
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Feeds a narrow sketch many more keys than it has counters and checks
+ * that the conservative update never estimates a key below its real
+ * count, nor above the bound of the sketch.
+ */
+class CotasHeavyHittersEstimateTestCase : public TestCase
+{
+  public:
+    CotasHeavyHittersEstimateTestCase();
+    ~CotasHeavyHittersEstimateTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasHeavyHittersEstimateTestCase::CotasHeavyHittersEstimateTestCase()
+    : TestCase("Heavy hitters estimates never fall below the real count")
+{
+}
+
+CotasHeavyHittersEstimateTestCase::~CotasHeavyHittersEstimateTestCase()
+{
+}
+
+void
+CotasHeavyHittersEstimateTestCase::DoRun()
+{
+    // 64 contadores por linha para 2000 chaves: colisões em toda parte
+    CotasHeavyHitters sketch(64, 4, 10);
+    std::map<std::string, uint64_t> reais;
+    uint64_t semente = 12345;
+    for (int i = 0; i < 20000; i++)
+    {
+        // gerador congruente: os sorteios são os mesmos em toda execução
+        semente = semente * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t sorteio = (semente >> 33) % 2000;
+        // chaves de número baixo saem bem mais vezes
+        std::string chave = "k" + std::to_string(sorteio * sorteio / 2000);
+        uint64_t vezes = 1 + (semente >> 20) % 3;
+        sketch.Add(chave, vezes);
+        reais[chave] += vezes;
+    }
+
+    uint64_t total = 0;
+    bool nuncaAbaixo = true;
+    for (auto& [chave, real] : reais)
+    {
+        nuncaAbaixo = nuncaAbaixo && sketch.Estimate(chave) >= real;
+        total += real;
+    }
+    NS_TEST_EXPECT_MSG_EQ(nuncaAbaixo, true, "every estimate is at least the real count");
+    NS_TEST_EXPECT_MSG_EQ(sketch.Total(), total, "total of the counts added");
+    NS_TEST_EXPECT_MSG_LT_OR_EQ(sketch.Estimate("nunca vista"),
+                                total,
+                                "an unseen key is bounded by the total");
+    for (auto& [chave, estimativa] : sketch.Top())
+    {
+        NS_TEST_EXPECT_MSG_GT_OR_EQ(estimativa, reais[chave], "top estimate of " + chave);
+    }
+
+    // largo o bastante para poucas chaves a estimativa é exata
+    CotasHeavyHitters largo(1 << 16, 4, 10);
+    for (int i = 1; i <= 50; i++)
+    {
+        largo.Add("chave" + std::to_string(i), i);
+    }
+    bool exato = true;
+    for (int i = 1; i <= 50; i++)
+    {
+        exato = exato && largo.Estimate("chave" + std::to_string(i)) == static_cast<uint64_t>(i);
+    }
+    NS_TEST_EXPECT_MSG_EQ(exato, true, "no collisions, exact counts");
+
+    largo.Clear();
+    NS_TEST_EXPECT_MSG_EQ(largo.Estimate("chave50"), 0, "Clear forgets the counts");
+    NS_TEST_EXPECT_MSG_EQ(largo.Top().empty(), true, "and the top");
+    NS_TEST_EXPECT_MSG_EQ(largo.Total(), 0, "and the total");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that the top keeps the real heavy keys when they arrive after
+ * light ones filled it, and that the floor follows a kept key that grows.
+ */
+class CotasHeavyHittersTopTestCase : public TestCase
+{
+  public:
+    CotasHeavyHittersTopTestCase();
+    ~CotasHeavyHittersTopTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasHeavyHittersTopTestCase::CotasHeavyHittersTopTestCase()
+    : TestCase("Heavy hitters top evicts light keys and keeps its floor")
+{
+}
+
+CotasHeavyHittersTopTestCase::~CotasHeavyHittersTopTestCase()
+{
+}
+
+void
+CotasHeavyHittersTopTestCase::DoRun()
+{
+    // as leves enchem o top antes das pesadas aparecerem
+    CotasHeavyHitters sketch(1024, 4, 5);
+    for (int i = 0; i < 300; i++)
+    {
+        sketch.Add("leve" + std::to_string(i), 1 + i % 3);
+    }
+    NS_TEST_ASSERT_MSG_EQ(sketch.Top().size(), 5, "top full of light keys");
+    for (int rodada = 0; rodada < 100; rodada++)
+    {
+        for (int p = 0; p < 5; p++)
+        {
+            // pesada0 sai 100 vezes por rodada, pesada4 sai 20
+            sketch.Add("pesada" + std::to_string(p), 20 * (5 - p));
+        }
+        sketch.Add("leve" + std::to_string(rodada), 1);
+    }
+
+    std::vector<CotasHeavyHitters::Entry> top = sketch.Top();
+    NS_TEST_ASSERT_MSG_EQ(top.size(), 5, "k keys kept");
+    for (int p = 0; p < 5; p++)
+    {
+        NS_TEST_EXPECT_MSG_EQ(top[p].first,
+                              "pesada" + std::to_string(p),
+                              "heavy keys, most frequent first");
+        NS_TEST_EXPECT_MSG_GT_OR_EQ(top[p].second,
+                                    static_cast<uint64_t>(2000 * (5 - p)),
+                                    "estimate at least the real count");
+    }
+
+    // o piso acompanha a chave do top que cresce; sem isso "c" entraria
+    // com 2 no lugar de "b", que também tem 2
+    CotasHeavyHitters piso(1 << 16, 4, 2);
+    piso.Add("a", 1);
+    piso.Add("b", 2);
+    piso.Add("a", 5);
+    piso.Add("c", 2);
+    top = piso.Top();
+    NS_TEST_ASSERT_MSG_EQ(top.size(), 2, "two keys kept");
+    NS_TEST_EXPECT_MSG_EQ(top[0].first, "a", "a grew to 6");
+    NS_TEST_EXPECT_MSG_EQ(top[1].first, "b", "c did not pass the floor of 2");
+    piso.Add("c", 1);
+    top = piso.Top();
+    NS_TEST_EXPECT_MSG_EQ(top[1].first, "c", "c with 3 takes the place of b");
+    NS_TEST_EXPECT_MSG_EQ(top[1].second, 3, "with its estimate");
+
+    CotasHeavyHitters semTop(1024, 4, 0);
+    semTop.Add("a", 3);
+    NS_TEST_EXPECT_MSG_EQ(semTop.Top().empty(), true, "k = 0 keeps no keys");
+    NS_TEST_EXPECT_MSG_EQ(semTop.Estimate("a"), 3, "but still counts");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasHeavyHitters TestSuite
+ */
+class CotasHeavyHittersTestSuite : public TestSuite
+{
+  public:
+    CotasHeavyHittersTestSuite();
+};
+
+CotasHeavyHittersTestSuite::CotasHeavyHittersTestSuite()
+    : TestSuite("cotas-heavy-hitters", Type::UNIT)
+{
+    AddTestCase(new CotasHeavyHittersEstimateTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasHeavyHittersTopTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasHeavyHittersTestSuite
+    cotasHeavyHittersTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cotas-test-transport.h"
+
+#include "ns3/cotas.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+#include "ns3/uinteger.h"
+
+#include <regex>
+#include <thread>
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * With the hot state table, turnedOn is checked by CoTaS on the rows the
+ * store returns, not by the store. A fake Fuseki on a loopback port lists
+ * MAX_OFF switched-off devices ahead of the one switched on and honours
+ * LIMIT the way the real one does: the search must still find the device
+ * that is on, so it cannot go to the store with a LIMIT.
+ */
+class CotasHotSearchTestCase : public TestCase
+{
+  public:
+    CotasHotSearchTestCase();
+    ~CotasHotSearchTestCase() override;
+
+  private:
+    void DoRun() override;
+
+    /// Hands a request to CoTaS at the current time
+    void Send(std::string path, std::string payload);
+
+    /// Answers a SELECT the way Fuseki would, from the devices listed
+    static std::string Select(const std::string& sparql);
+
+    /// devices switched off, listed first by the store
+    static constexpr int32_t MAX_OFF{40};
+
+    Ptr<CoTaS> m_cotas;             //!< server under test
+    CotasTestTransport m_transport; //!< keeps the replies
+};
+
+CotasHotSearchTestCase::CotasHotSearchTestCase()
+    : TestCase("Hot state search finds the device on behind many that are off")
+{
+}
+
+CotasHotSearchTestCase::~CotasHotSearchTestCase()
+{
+}
+
+void
+CotasHotSearchTestCase::Send(std::string path, std::string payload)
+{
+    encoded_data pedido = EncodePduRequest(path.c_str(), COAP_REQUEST_CODE_POST, payload, {});
+    m_cotas->HandleDatagram(pedido.buffer,
+                            pedido.size,
+                            {InetSocketAddress(Ipv4Address("10.1.1.7"), 40000), nullptr});
+}
+
+std::string
+CotasHotSearchTestCase::Select(const std::string& sparql)
+{
+    nlohmann::json linhas = nlohmann::json::array();
+    std::smatch encontrado;
+    static const std::regex validacao("cot:objectId (\\d+) \\.");
+    if (sparql.find("SELECT ?device") != std::string::npos &&
+        std::regex_search(sparql, encontrado, validacao))
+    {
+        // todo id dos testes está inscrito
+        linhas.push_back({{"device", {{"value", "urn:cot:device" + encontrado[1].str()}}}});
+    }
+    else if (sparql.find("?id ?ip ?port") != std::string::npos)
+    {
+        // os desligados vêm antes, como o banco pode devolver
+        static const std::regex corte("LIMIT (\\d+)");
+        size_t limite = std::regex_search(sparql, encontrado, corte)
+                            ? std::stoul(encontrado[1].str())
+                            : MAX_OFF + 1;
+        for (int32_t id = 1; id <= MAX_OFF + 1 && linhas.size() < limite; id++)
+        {
+            linhas.push_back({{"id", {{"value", std::to_string(id)}}},
+                              {"ip", {{"value", std::to_string(id)}}},
+                              {"port", {{"value", "5683"}}}});
+        }
+    }
+    return nlohmann::json{{"results", {{"bindings", linhas}}}}.dump();
+}
+
+void
+CotasHotSearchTestCase::DoRun()
+{
+    // fuseki de mentira: consultas respondidas por Select, o resto aceito
+    httplib::Server fuseki;
+    fuseki.Post("/dataset/query", [](const httplib::Request& req, httplib::Response& res) {
+        res.set_content(Select(req.get_param_value("query")), "application/sparql-results+json");
+    });
+    fuseki.Post("/dataset/update", [](const httplib::Request&, httplib::Response& res) {
+        res.status = httplib::NoContent_204;
+    });
+    fuseki.Post("/dataset/data", [](const httplib::Request&, httplib::Response&) {});
+    fuseki.Put("/dataset/data", [](const httplib::Request&, httplib::Response&) {});
+    int porta = fuseki.bind_to_any_port("127.0.0.1");
+    NS_TEST_ASSERT_MSG_GT(porta, 0, "fake store bound to a port");
+    std::thread servidor([&fuseki]() { fuseki.listen_after_bind(); });
+    fuseki.wait_until_ready();
+
+    m_cotas = CreateObject<CoTaS>();
+    m_cotas->SetAttribute("StorePort", UintegerValue(porta));
+    m_cotas->SetAttribute("FlushInterval", TimeValue(Seconds(60)));
+    m_cotas->SetTransport(&m_transport);
+    m_cotas->StartService();
+
+    // todos desligados menos o último, que o banco lista por último
+    for (int32_t id = 1; id <= MAX_OFF + 1; id++)
+    {
+        nlohmann::json estado = {{"objectId", id}, {"turnedOn", id > MAX_OFF ? 1 : 0}};
+        Simulator::Schedule(Seconds(1),
+                            &CotasHotSearchTestCase::Send,
+                            this,
+                            "/update/object",
+                            estado.dump());
+    }
+    Simulator::Schedule(Seconds(2),
+                        &CotasHotSearchTestCase::Send,
+                        this,
+                        "/search",
+                        R"({"class": ["cot:SmartLamp"]})");
+    Simulator::Stop(Seconds(3));
+    Simulator::Run();
+
+    m_cotas->StopService();
+    m_cotas = nullptr;
+    Simulator::Destroy();
+    fuseki.stop();
+    servidor.join();
+
+    NS_TEST_ASSERT_MSG_EQ(m_transport.replies.size(), MAX_OFF + 2, "every request answered");
+    for (size_t i = 0; i < m_transport.replies.size(); i++)
+    {
+        coap_pdu_code_t codigo;
+        nlohmann::json corpo;
+        NS_TEST_ASSERT_MSG_EQ(CotasTestTransport::Decode(m_transport.replies[i], codigo, corpo),
+                              true,
+                              "reply is a CoAP message");
+        if (i + 1 < m_transport.replies.size())
+        {
+            NS_TEST_EXPECT_MSG_EQ(codigo, COAP_RESPONSE_CODE_CHANGED, "update accepted");
+            continue;
+        }
+        NS_TEST_ASSERT_MSG_EQ(codigo, COAP_RESPONSE_CODE_CONTENT, "a device that is on found");
+        NS_TEST_EXPECT_MSG_EQ(corpo["response"]["ip"].get<int32_t>(),
+                              MAX_OFF + 1,
+                              "the one switched on");
+    }
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Hot state search TestSuite
+ */
+class CotasHotSearchTestSuite : public TestSuite
+{
+  public:
+    CotasHotSearchTestSuite();
+};
+
+CotasHotSearchTestSuite::CotasHotSearchTestSuite()
+    : TestSuite("cotas-hot-search", Type::SYSTEM)
+{
+    AddTestCase(new CotasHotSearchTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasHotSearchTestSuite cotasHotSearchTestSuite; //!< Static variable for test initialization
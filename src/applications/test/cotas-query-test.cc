@@ -0,0 +1,345 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-query.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+namespace
+{
+
+/// Parses a query written as JSON text, reporting the error if any
+bool
+Parse(const std::string& texto, CotasQuery& query, std::string& erro)
+{
+    return CotasQuery::Parse(nlohmann::json::parse(texto), query, erro);
+}
+
+} // namespace
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that CotasQuery::Parse refuses bad names, paths, operators,
+ * limits and fields before anything reaches the store.
+ */
+class CotasQueryRejectTestCase : public TestCase
+{
+  public:
+    CotasQueryRejectTestCase();
+    ~CotasQueryRejectTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasQueryRejectTestCase::CotasQueryRejectTestCase()
+    : TestCase("Structured queries with bad names, paths, operators or limits are refused")
+{
+}
+
+CotasQueryRejectTestCase::~CotasQueryRejectTestCase()
+{
+}
+
+void
+CotasQueryRejectTestCase::DoRun()
+{
+    nlohmann::json muitos = nlohmann::json::array();
+    for (size_t i = 0; i <= CotasQuery::MAX_SET_SIZE; i++)
+    {
+        muitos.push_back("C" + std::to_string(i));
+    }
+    nlohmann::json filtros = nlohmann::json::object();
+    for (size_t i = 0; i <= CotasQuery::MAX_PREDICATES; i++)
+    {
+        filtros["p" + std::to_string(i)] = 1;
+    }
+
+    const std::vector<std::pair<std::string, std::string>> ruins = {
+        {R"([1])", "not an object"},
+        {R"({"class": "1Lamp"})", "name starting with a digit"},
+        {R"({"class": "cot:Smart-Lamp"})", "name with '-'"},
+        {R"({"class": "x:Lamp"})", "name in another prefix"},
+        {R"({"class": []})", "empty class list"},
+        {R"({"class": 5})", "class that is not a name"},
+        {nlohmann::json{{"usedFor", muitos}}.dump(), "more than MAX_SET_SIZE names"},
+        {R"({"where": {"a..b": 1}})", "empty step in a path"},
+        {R"({"where": {".a": 1}})", "path starting with '.'"},
+        {R"({"where": {"a/Battery": 1}})", "path ending in a class"},
+        {R"({"where": {"a.b.c.d.e.f.g": 1}})", "path deeper than MAX_PATH_DEPTH"},
+        {R"({"where": {"a b": 1}})", "space in a path"},
+        {R"({"where": {"x": {"like": 1}}})", "unknown operator"},
+        {R"({"where": {"x": {}}})", "filter without comparisons"},
+        {R"({"where": {"x": {"lt": "cot:High"}}})", "order comparison of a name"},
+        {R"({"where": {"x": [1]}})", "value that is a list"},
+        {R"({"where": {"x": "a b"}})", "value that is not a name"},
+        {R"({"where": {"x": {"gt": 1, "lt": 5, "ne": 3}, "y": 1, "z": 2, "w": 3,
+             "v": 4, "u": 5, "t": 6}})",
+         "more than MAX_PREDICATES comparisons"},
+        {nlohmann::json{{"where", filtros}}.dump(), "more than MAX_PREDICATES properties"},
+        {R"({"where": 1})", "where that is not an object"},
+        {R"({"limit": 0})", "zero limit"},
+        {R"({"limit": 51})", "limit over MAX_LIMIT"},
+        {R"({"limit": -1})", "negative limit"},
+        {R"({"limit": 1.5})", "fractional limit"},
+        {R"({"limit": "3"})", "limit as text"},
+        {R"({"near": {"latitude": 1}})", "near without longitude"},
+        {R"({"near": {"latitude": 1, "longitude": 2, "radius": 0}})", "zero radius"},
+        {R"({"near": {"latitude": 1, "longitude": 2, "height": 3}})", "unknown near field"},
+        {R"({"zone": "a b"})", "bad zone name"},
+        {R"({"project": "x"})", "project that is not a list"},
+        {R"({"project": ["a..b"]})", "bad projected path"},
+        {R"({"select": "*"})", "unknown field"}};
+    for (auto& [texto, motivo] : ruins)
+    {
+        CotasQuery query;
+        std::string erro;
+        NS_TEST_EXPECT_MSG_EQ(Parse(texto, query, erro), false, motivo);
+        NS_TEST_EXPECT_MSG_EQ(erro.empty(), false, "with a reason: " + motivo);
+    }
+
+    // nos limites ainda vale
+    CotasQuery query;
+    std::string erro;
+    NS_TEST_EXPECT_MSG_EQ(Parse(R"({"limit": 50, "where": {"a.b.c.d.e.f": 1}})", query, erro),
+                          true,
+                          "MAX_LIMIT and MAX_PATH_DEPTH themselves are accepted");
+
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::IsStructured(R"( {"class": "Lamp"})"), true, "JSON object");
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::IsStructured("?device a cot:Lamp ."), false, "SPARQL");
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::IsStructured("{ ?device a cot:Lamp } UNION { }"),
+                          false,
+                          "SPARQL group");
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::IsStructured("[1]"), false, "JSON array");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that equivalent queries share the canonical Key, that Shape
+ * drops the constants, and the Cost of anchored and unanchored queries.
+ */
+class CotasQueryKeyTestCase : public TestCase
+{
+  public:
+    CotasQueryKeyTestCase();
+    ~CotasQueryKeyTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasQueryKeyTestCase::CotasQueryKeyTestCase()
+    : TestCase("Structured query Key, Shape and Cost")
+{
+}
+
+CotasQueryKeyTestCase::~CotasQueryKeyTestCase()
+{
+}
+
+void
+CotasQueryKeyTestCase::DoRun()
+{
+    CotasQuery a;
+    CotasQuery b;
+    std::string erro;
+    NS_TEST_ASSERT_MSG_EQ(Parse(R"({"class": ["Lamp", "cot:Bulb"], "usedFor": "Lighting",
+                                    "where": {"turnedOn": true, "level": {"gt": 2, "lt": 9}},
+                                    "project": ["level", "turnedOn"], "limit": 3})",
+                                a,
+                                erro),
+                          true,
+                          erro);
+    NS_TEST_ASSERT_MSG_EQ(Parse(R"({"limit": 3, "project": ["turnedOn", "level", "level"],
+                                    "where": {"level": {"lt": 9, "gt": 2}, "turnedOn": true},
+                                    "usedFor": ["cot:Lighting"],
+                                    "class": ["cot:Bulb", "Lamp", "Bulb"]})",
+                                b,
+                                erro),
+                          true,
+                          erro);
+    NS_TEST_EXPECT_MSG_EQ(a.Key(), b.Key(), "reordered and repeated input, same key");
+    NS_TEST_EXPECT_MSG_EQ(a.Shape(), b.Shape(), "and same shape");
+
+    CotasQuery outroValor;
+    Parse(R"({"class": ["Lamp", "Bulb"], "usedFor": "Lighting",
+              "where": {"turnedOn": true, "level": {"gt": 4, "lt": 9}},
+              "project": ["level", "turnedOn"], "limit": 7})",
+          outroValor,
+          erro);
+    NS_TEST_EXPECT_MSG_NE(outroValor.Key(), a.Key(), "other values and limit, other key");
+    NS_TEST_EXPECT_MSG_EQ(outroValor.Shape(), a.Shape(), "but the same shape");
+
+    CotasQuery outraProjecao;
+    Parse(R"({"class": ["Lamp", "Bulb"], "usedFor": "Lighting",
+              "where": {"turnedOn": true, "level": {"gt": 2, "lt": 9}}, "limit": 3})",
+          outraProjecao,
+          erro);
+    NS_TEST_EXPECT_MSG_NE(outraProjecao.Key(), a.Key(), "the projection changes the reply");
+    NS_TEST_EXPECT_MSG_NE(outraProjecao.Shape(), a.Shape(), "and the shape");
+
+    CotasQuery outroOperador;
+    Parse(R"({"class": ["Lamp", "Bulb"], "usedFor": "Lighting",
+              "where": {"turnedOn": true, "level": {"gte": 2, "lt": 9}},
+              "project": ["level", "turnedOn"], "limit": 3})",
+          outroOperador,
+          erro);
+    NS_TEST_EXPECT_MSG_NE(outroOperador.Shape(), a.Shape(), "another operator, another shape");
+
+    CotasQuery perto;
+    CotasQuery longe;
+    Parse(R"({"near": {"latitude": 1, "longitude": 2, "radius": 3}})", perto, erro);
+    Parse(R"({"near": {"latitude": 5, "longitude": 6, "radius": 1}})", longe, erro);
+    NS_TEST_EXPECT_MSG_NE(perto.Key(), longe.Key(), "another point, another key");
+    NS_TEST_EXPECT_MSG_EQ(perto.Shape(), longe.Shape(), "same shape");
+
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::FragmentShape("?device  cot:level 42 .\n"
+                                                    "FILTER (?x > -3.5) cot:room2 \"a \\\" b\" "),
+                          "?device cot:level ? . FILTER (?x > ?) cot:room2 ?",
+                          "fragment shape drops literals and extra whitespace");
+
+    // ip, porta e id; classe +1, usedFor +2, cada salto +1
+    CotasQuery custo;
+    Parse(R"({"class": "Lamp", "usedFor": "Lighting"})", custo, erro);
+    NS_TEST_EXPECT_MSG_EQ(custo.Cost(), 6, "class and usedFor");
+    Parse(R"({"class": "Lamp", "where": {"powerSupply.batteryLevel": 1, "turnedOn": 1}})",
+          custo,
+          erro);
+    NS_TEST_EXPECT_MSG_EQ(custo.Cost(), 7, "two hops and one hop");
+    Parse(R"({"where": {"turnedOn": 1}})", custo, erro);
+    NS_TEST_EXPECT_MSG_EQ(custo.Cost(), 16, "no anchor costs four times as much");
+    Parse(R"({"where": {"turnedOn": 1}, "zone": "Kitchen"})", custo, erro);
+    NS_TEST_EXPECT_MSG_EQ(custo.Cost(), 4, "a zone anchors the query");
+    NS_TEST_EXPECT_MSG_EQ(custo.IsSpatial(), true, "zone is spatial");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks the WHERE body compiled for class, usedFor, where and the state
+ * graphs, and the candidates the indexes pass in.
+ */
+class CotasQuerySparqlTestCase : public TestCase
+{
+  public:
+    CotasQuerySparqlTestCase();
+    ~CotasQuerySparqlTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasQuerySparqlTestCase::CotasQuerySparqlTestCase()
+    : TestCase("Structured query compiles to the expected WHERE body")
+{
+}
+
+CotasQuerySparqlTestCase::~CotasQuerySparqlTestCase()
+{
+}
+
+void
+CotasQuerySparqlTestCase::DoRun()
+{
+    const std::string fim = "?device cot:ipAddress ?ip . ?device cot:port ?port . ";
+    CotasQuery query;
+    std::string erro;
+
+    // uma classe e um contexto vão direto no padrão
+    Parse(R"({"class": "Lamp", "usedFor": "Lighting", "where": {"turnedOn": true}})",
+          query,
+          erro);
+    NS_TEST_EXPECT_MSG_EQ(query.ToSparqlWhere(),
+                          "?device a cot:Lamp . cot:Lamp cot:usedFor cot:Lighting . "
+                          "?device cot:objectId ?id . " +
+                              fim +
+                              "?device cot:instanceOf?/cot:turnedOn ?p0_0 . "
+                              "FILTER (?p0_0 = 1) FILTER (!isBlank(?device))",
+                          "single class and context");
+
+    // vários nomes viram VALUES, em ordem
+    Parse(R"({"class": ["Lamp", "Bulb"], "usedFor": ["Safety", "Lighting"]})", query, erro);
+    NS_TEST_EXPECT_MSG_EQ(query.ToSparqlWhere(),
+                          "VALUES ?class { cot:Bulb cot:Lamp } ?device a ?class . "
+                          "VALUES ?context { cot:Lighting cot:Safety } "
+                          "?class cot:usedFor ?context . ?device cot:objectId ?id . " +
+                              fim + "FILTER (!isBlank(?device))",
+                          "sets of classes and contexts");
+
+    // usedFor sem classe ainda precisa da classe do dispositivo
+    Parse(R"({"usedFor": "Lighting"})", query, erro);
+    NS_TEST_EXPECT_MSG_EQ(query.ToSparqlWhere().compare(
+                              0,
+                              std::string("?device a ?class . ?class cot:usedFor").size(),
+                              "?device a ?class . ?class cot:usedFor"),
+                          0,
+                          "context without class");
+
+    // caminho tipado e duas comparações sobre a mesma variável
+    Parse(R"({"where": {"powerSupply/Battery.level": {"lt": 20, "gte": 5}, "mode": "Eco"}})",
+          query,
+          erro);
+    NS_TEST_EXPECT_MSG_EQ(query.ToSparqlWhere(),
+                          "?device cot:objectId ?id . " + fim +
+                              "?device cot:instanceOf?/cot:mode ?p0_0 . "
+                              "FILTER (?p0_0 = cot:Eco) "
+                              "?device cot:instanceOf?/cot:powerSupply ?p1_0 . "
+                              "?p1_0 a cot:Battery . ?p1_0 cot:level ?p1_1 . "
+                              "FILTER (?p1_1 < 20) FILTER (?p1_1 >= 5) "
+                              "FILTER (!isBlank(?device))",
+                          "typed path and a name value");
+
+    // com grafos de estado o valor novo vence o do perfil
+    Parse(R"({"where": {"powerSupply.level": {"lt": 20}}})", query, erro);
+    NS_TEST_EXPECT_MSG_EQ(query.ToSparqlWhere({}, true),
+                          "?device cot:objectId ?id . " + fim +
+                              "OPTIONAL { ?device cot:instanceOf?/cot:powerSupply ?p0_0 . "
+                              "?p0_0 cot:level ?p0_1 . } "
+                              "OPTIONAL { GRAPH <urn:cotas:state> { ?p0_s cot:objectId ?id ; "
+                              "<urn:cotas:path:powerSupply.level> ?p0_e . } } "
+                              "BIND (COALESCE(?p0_e, ?p0_1) AS ?p0) FILTER (?p0 < 20) "
+                              "FILTER (!isBlank(?device))",
+                          "state graph value with the profile as fallback");
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::StateProperty("turnedOn"), "cot:turnedOn", "one hop");
+    NS_TEST_EXPECT_MSG_EQ(CotasQuery::StateProperty("a..b"), "", "bad path has no property");
+
+    // candidatos dos índices ancoram a consulta pelo id
+    Parse(R"({"class": "Lamp"})", query, erro);
+    std::string comCandidatos = query.ToSparqlWhere({3, 5});
+    NS_TEST_EXPECT_MSG_EQ(comCandidatos,
+                          "VALUES ?id { 3 5 } ?device cot:objectId ?id . "
+                          "?device a cot:Lamp . " +
+                              fim + "FILTER (!isBlank(?device))",
+                          "candidates come first, objectId once");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasQuery TestSuite
+ */
+class CotasQueryTestSuite : public TestSuite
+{
+  public:
+    CotasQueryTestSuite();
+};
+
+CotasQueryTestSuite::CotasQueryTestSuite()
+    : TestSuite("cotas-query", Type::UNIT)
+{
+    AddTestCase(new CotasQueryRejectTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasQueryKeyTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasQuerySparqlTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasQueryTestSuite cotasQueryTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-range-index.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks every operator of CotasRangeIndex::Range, on ties too, and that
+ * a new value of a device replaces the old one.
+ */
+class CotasRangeIndexTestCase : public TestCase
+{
+  public:
+    CotasRangeIndexTestCase();
+    ~CotasRangeIndexTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasRangeIndexTestCase::CotasRangeIndexTestCase()
+    : TestCase("Range index answers every operator and follows updates")
+{
+}
+
+CotasRangeIndexTestCase::~CotasRangeIndexTestCase()
+{
+}
+
+void
+CotasRangeIndexTestCase::DoRun()
+{
+    using Ids = std::vector<int32_t>;
+
+    CotasRangeIndex indice;
+    indice.Configure({"temperature"});
+    NS_TEST_ASSERT_MSG_EQ(indice.Indexes("temperature"), true, "configured property");
+    NS_TEST_EXPECT_MSG_EQ(indice.Indexes("humidity"), false, "property not configured");
+
+    indice.Update(3, "temperature", 20);
+    indice.Update(1, "temperature", 25);
+    indice.Update(2, "temperature", 25);
+    indice.Update(4, "temperature", 30);
+    indice.Update(5, "humidity", 80); // fora do índice, ignorado
+
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::EQ, 25) == Ids({1, 2}),
+                          true,
+                          "EQ takes every tie");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::NE, 25) == Ids({3, 4}),
+                          true,
+                          "NE skips the ties");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::LT, 25) == Ids({3}),
+                          true,
+                          "LT");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::LTE, 25) == Ids({1, 2, 3}),
+                          true,
+                          "LTE");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::GT, 25) == Ids({4}),
+                          true,
+                          "GT");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::GTE, 25) == Ids({1, 2, 4}),
+                          true,
+                          "GTE");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::GT, 99).empty(),
+                          true,
+                          "nothing above the largest value");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("humidity", CotasQuery::GT, 0).empty(),
+                          true,
+                          "property not indexed");
+
+    // o valor antigo sai da ordem quando chega um novo
+    indice.Update(1, "temperature", 10);
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::EQ, 25) == Ids({2}),
+                          true,
+                          "old value dropped");
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::LT, 20) == Ids({1}),
+                          true,
+                          "new value in place");
+
+    // reconfigurar apaga os valores
+    indice.Configure({"temperature", "humidity"});
+    NS_TEST_EXPECT_MSG_EQ(indice.Range("temperature", CotasQuery::GTE, 0).empty(),
+                          true,
+                          "values dropped by Configure");
+    NS_TEST_EXPECT_MSG_EQ(indice.Keys().size(), 2, "two properties indexed");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasRangeIndex TestSuite
+ */
+class CotasRangeIndexTestSuite : public TestSuite
+{
+  public:
+    CotasRangeIndexTestSuite();
+};
+
+CotasRangeIndexTestSuite::CotasRangeIndexTestSuite()
+    : TestSuite("cotas-range-index", Type::UNIT)
+{
+    AddTestCase(new CotasRangeIndexTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasRangeIndexTestSuite
+    cotasRangeIndexTestSuite; //!< Static variable for test initialization
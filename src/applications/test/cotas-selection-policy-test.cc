@@ -0,0 +1,193 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-selection-policy.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+namespace
+{
+
+/// ids of the candidates, in their current order
+std::vector<int32_t>
+Ids(const std::vector<CotasSelectionPolicy::Candidate>& candidatos)
+{
+    std::vector<int32_t> ids;
+    for (auto& candidato : candidatos)
+    {
+        ids.push_back(candidato.id);
+    }
+    return ids;
+}
+
+} // namespace
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks the order CotasSelectionPolicy gives the candidates under
+ * round-robin, least-loaded and AP affinity, and that Assign moves the
+ * load of a client between objects.
+ */
+class CotasSelectionPolicyTestCase : public TestCase
+{
+  public:
+    CotasSelectionPolicyTestCase();
+    ~CotasSelectionPolicyTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasSelectionPolicyTestCase::CotasSelectionPolicyTestCase()
+    : TestCase("Selection policies order the candidates and track the load")
+{
+}
+
+CotasSelectionPolicyTestCase::~CotasSelectionPolicyTestCase()
+{
+}
+
+void
+CotasSelectionPolicyTestCase::DoRun()
+{
+    using Policy = CotasSelectionPolicy;
+    uint32_t cliente = Ipv4Address("10.1.1.7").Get();
+
+    // round-robin gira pelos ids, não pela ordem do fuseki
+    Policy politica(24);
+    std::vector<std::vector<int32_t>> voltas;
+    for (int i = 0; i < 4; i++)
+    {
+        std::vector<Policy::Candidate> opcoes = {{3, 0, 0}, {1, 0, 1}, {2, 0, 2}};
+        politica.Order(Policy::ROUND_ROBIN, "q", cliente, opcoes);
+        voltas.push_back(Ids(opcoes));
+    }
+    NS_TEST_EXPECT_MSG_EQ((voltas[0] == std::vector<int32_t>{1, 2, 3}), true, "starts at the id 1");
+    NS_TEST_EXPECT_MSG_EQ((voltas[1] == std::vector<int32_t>{2, 3, 1}), true, "then rotates");
+    NS_TEST_EXPECT_MSG_EQ((voltas[2] == std::vector<int32_t>{3, 1, 2}), true, "once per query");
+    NS_TEST_EXPECT_MSG_EQ((voltas[3] == voltas[0]), true, "and wraps around");
+    std::vector<Policy::Candidate> outra = {{3, 0, 0}, {1, 0, 1}, {2, 0, 2}};
+    politica.Order(Policy::ROUND_ROBIN, "r", cliente, outra);
+    NS_TEST_EXPECT_MSG_EQ(outra.front().id, 1, "another query has its own cursor");
+
+    // least-loaded: menos clientes primeiro, empate pela ordem do fuseki
+    Policy carga(24);
+    carga.Assign(1, "q", 10, 1.0);
+    carga.Assign(2, "q", 10, 2.0);
+    carga.Assign(3, "q", 20, 3.0);
+    std::vector<Policy::Candidate> opcoes = {{10, 0, 0}, {20, 0, 1}, {40, 0, 2}, {30, 0, 3}};
+    carga.Order(Policy::LEAST_LOADED, "q", cliente, opcoes);
+    NS_TEST_EXPECT_MSG_EQ((Ids(opcoes) == std::vector<int32_t>{40, 30, 20, 10}),
+                          true,
+                          "fewest clients first, store order on ties");
+
+    // o cliente 1 muda de objeto para a mesma consulta: a carga vai junto
+    carga.Assign(1, "q", 20, 4.0);
+    NS_TEST_EXPECT_MSG_EQ(carga.Load(10), 1, "client 1 left the object 10");
+    NS_TEST_EXPECT_MSG_EQ(carga.Load(20), 2, "and went to the object 20");
+    carga.Assign(1, "q", 20, 5.0);
+    NS_TEST_EXPECT_MSG_EQ(carga.Load(20), 2, "the same assignment again counts once");
+    carga.Assign(1, "r", 20, 6.0);
+    NS_TEST_EXPECT_MSG_EQ(carga.Load(20), 3, "another query of the client counts apart");
+
+    // afinidade: a sub-rede do cliente manda, a carga desempata
+    std::vector<Policy::Candidate> vizinhos = {{10, Ipv4Address("10.1.2.5").Get(), 0},
+                                               {20, Ipv4Address("10.1.1.9").Get(), 1},
+                                               {50, Ipv4Address("10.1.1.3").Get(), 2}};
+    carga.Order(Policy::AP_AFFINITY, "q", cliente, vizinhos);
+    NS_TEST_EXPECT_MSG_EQ((Ids(vizinhos) == std::vector<int32_t>{50, 20, 10}),
+                          true,
+                          "same /24 first, least loaded among them");
+    Policy larga(16);
+    vizinhos = {{10, Ipv4Address("10.1.2.5").Get(), 0},
+                {20, Ipv4Address("10.2.1.9").Get(), 1},
+                {50, Ipv4Address("10.1.1.3").Get(), 2}};
+    larga.Order(Policy::AP_AFFINITY, "q", cliente, vizinhos);
+    NS_TEST_EXPECT_MSG_EQ((Ids(vizinhos) == std::vector<int32_t>{10, 50, 20}),
+                          true,
+                          "a /16 mask takes in 10.1.2.5");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that the assignments and round-robin cursors stay bounded when
+ * every search brings a new query text.
+ */
+class CotasSelectionPolicyBoundsTestCase : public TestCase
+{
+  public:
+    CotasSelectionPolicyBoundsTestCase();
+    ~CotasSelectionPolicyBoundsTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasSelectionPolicyBoundsTestCase::CotasSelectionPolicyBoundsTestCase()
+    : TestCase("Selection policy forgets the oldest assignments past its bound")
+{
+}
+
+CotasSelectionPolicyBoundsTestCase::~CotasSelectionPolicyBoundsTestCase()
+{
+}
+
+void
+CotasSelectionPolicyBoundsTestCase::DoRun()
+{
+    using Policy = CotasSelectionPolicy;
+    Policy politica(24);
+
+    // o primeiro par é o mais antigo e sai quando o mapa passa do limite
+    politica.Assign(1, "q0", 7, 0.0);
+    for (size_t i = 1; i < Policy::MAX_ASSIGNMENTS; i++)
+    {
+        politica.Assign(1, "q" + std::to_string(i), 8, static_cast<double>(i));
+    }
+    NS_TEST_ASSERT_MSG_EQ(politica.Assignments(), Policy::MAX_ASSIGNMENTS, "map is full");
+    NS_TEST_EXPECT_MSG_EQ(politica.Load(7), 1, "the oldest pair still counts");
+
+    politica.Assign(2, "nova", 9, 1e6);
+    NS_TEST_EXPECT_MSG_EQ(politica.Assignments(), Policy::MAX_ASSIGNMENTS, "bound kept");
+    NS_TEST_EXPECT_MSG_EQ(politica.Load(7), 0, "the oldest pair was forgotten");
+    NS_TEST_EXPECT_MSG_EQ(politica.Load(9), 1, "the new pair counts");
+
+    // cursores demais recomeçam as rotações, sem quebrar a ordem
+    for (size_t i = 0; i <= Policy::MAX_CURSORS; i++)
+    {
+        std::vector<Policy::Candidate> opcoes = {{1, 0, 0}, {2, 0, 1}};
+        politica.Order(Policy::ROUND_ROBIN, "c" + std::to_string(i), 0, opcoes);
+        NS_TEST_ASSERT_MSG_EQ(opcoes.front().id, 1, "a new query starts at the first id");
+    }
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasSelectionPolicy TestSuite
+ */
+class CotasSelectionPolicyTestSuite : public TestSuite
+{
+  public:
+    CotasSelectionPolicyTestSuite();
+};
+
+CotasSelectionPolicyTestSuite::CotasSelectionPolicyTestSuite()
+    : TestSuite("cotas-selection-policy", Type::UNIT)
+{
+    AddTestCase(new CotasSelectionPolicyTestCase, TestCase::Duration::QUICK);
+    AddTestCase(new CotasSelectionPolicyBoundsTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasSelectionPolicyTestSuite
+    cotasSelectionPolicyTestSuite; //!< Static variable for test initialization
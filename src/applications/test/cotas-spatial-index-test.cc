@@ -0,0 +1,98 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-spatial-index.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks the radius, nearest and box queries of CotasSpatialIndex,
+ * including after devices move to another cell and leave.
+ */
+class CotasSpatialIndexTestCase : public TestCase
+{
+  public:
+    CotasSpatialIndexTestCase();
+    ~CotasSpatialIndexTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasSpatialIndexTestCase::CotasSpatialIndexTestCase()
+    : TestCase("Radius, nearest and box queries follow the devices")
+{
+}
+
+CotasSpatialIndexTestCase::~CotasSpatialIndexTestCase()
+{
+}
+
+void
+CotasSpatialIndexTestCase::DoRun()
+{
+    CotasSpatialIndex indice(2.0);
+    indice.Update(1, 0, 0);
+    indice.Update(2, 3, 4);
+    indice.Update(3, -10, -10);
+    NS_TEST_ASSERT_MSG_EQ(indice.Size(), 3, "three devices indexed");
+
+    // o ponto da borda conta e a resposta vem ordenada pela distância
+    CotasSpatialIndex::Result raio = indice.Radius(0, 0, 5);
+    NS_TEST_ASSERT_MSG_EQ(raio.size(), 2, "devices 1 and 2 are within 5");
+    NS_TEST_EXPECT_MSG_EQ(raio[0].first, 1, "closest first");
+    NS_TEST_EXPECT_MSG_EQ(raio[1].first, 2, "then device 2");
+    NS_TEST_EXPECT_MSG_EQ_TOL(raio[1].second, 5.0, 1e-9, "distance of device 2");
+
+    CotasSpatialIndex::Result proximos = indice.Nearest(-9, -9, 2);
+    NS_TEST_ASSERT_MSG_EQ(proximos.size(), 2, "k devices");
+    NS_TEST_EXPECT_MSG_EQ(proximos[0].first, 3, "device 3 is the nearest");
+    NS_TEST_EXPECT_MSG_EQ(proximos[1].first, 1, "then device 1");
+    NS_TEST_EXPECT_MSG_EQ(indice.Nearest(0, 0, 10).size(), 3, "k above the size gives all");
+
+    CotasSpatialIndex::Result caixa = indice.Box(-1, -1, 4, 4, 3, 4);
+    NS_TEST_ASSERT_MSG_EQ(caixa.size(), 2, "devices 1 and 2 are in the box");
+    NS_TEST_EXPECT_MSG_EQ(caixa[0].first, 2, "sorted by distance to the reference");
+
+    // mudar de célula tira o dispositivo da antiga
+    indice.Update(2, 50, 50);
+    double x = 0;
+    double y = 0;
+    NS_TEST_ASSERT_MSG_EQ(indice.Get(2, x, y), true, "device 2 has a position");
+    NS_TEST_EXPECT_MSG_EQ_TOL(x, 50.0, 1e-9, "new x");
+    NS_TEST_EXPECT_MSG_EQ(indice.Radius(0, 0, 5).size(), 1, "device 2 left the old cell");
+    NS_TEST_EXPECT_MSG_EQ(indice.Radius(50, 50, 0.5).size(), 1, "and is found in the new one");
+
+    indice.Remove(1);
+    NS_TEST_EXPECT_MSG_EQ(indice.Get(1, x, y), false, "removed device has no position");
+    NS_TEST_EXPECT_MSG_EQ(indice.Radius(0, 0, 5).size(), 0, "nothing left around the origin");
+    NS_TEST_EXPECT_MSG_EQ(indice.Size(), 2, "two devices left");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasSpatialIndex TestSuite
+ */
+class CotasSpatialIndexTestSuite : public TestSuite
+{
+  public:
+    CotasSpatialIndexTestSuite();
+};
+
+CotasSpatialIndexTestSuite::CotasSpatialIndexTestSuite()
+    : TestSuite("cotas-spatial-index", Type::UNIT)
+{
+    AddTestCase(new CotasSpatialIndexTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasSpatialIndexTestSuite
+    cotasSpatialIndexTestSuite; //!< Static variable for test initialization
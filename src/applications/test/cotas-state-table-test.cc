@@ -0,0 +1,101 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-state-table.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks reads, matches and projections of CotasStateTable, and that
+ * only the values written with Set come out of TakeDirty, once.
+ */
+class CotasStateTableTestCase : public TestCase
+{
+  public:
+    CotasStateTableTestCase();
+    ~CotasStateTableTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasStateTableTestCase::CotasStateTableTestCase()
+    : TestCase("State table reads, matches and hands dirty values once")
+{
+}
+
+CotasStateTableTestCase::~CotasStateTableTestCase()
+{
+}
+
+void
+CotasStateTableTestCase::DoRun()
+{
+    CotasStateTable tabela;
+    NS_TEST_EXPECT_MSG_EQ(tabela.Contains(7), false, "empty table");
+
+    // Load é o que o banco já tem, Set ainda precisa ir para ele
+    tabela.Load(7, "turnedOn", 1, 10);
+    tabela.Set(7, "temperature", 21.5, 12);
+    tabela.Set(8, "temperature", 30, 13);
+    NS_TEST_ASSERT_MSG_EQ(tabela.Size(), 2, "a row per device");
+
+    double valor = 0;
+    double instante = 0;
+    NS_TEST_ASSERT_MSG_EQ(tabela.Get(7, "temperature", valor, instante), true, "known value");
+    NS_TEST_EXPECT_MSG_EQ_TOL(valor, 21.5, 1e-9, "value read back");
+    NS_TEST_EXPECT_MSG_EQ_TOL(instante, 12.0, 1e-9, "report time read back");
+    NS_TEST_EXPECT_MSG_EQ(tabela.Get(8, "turnedOn", valor), false, "device 8 has no turnedOn");
+    NS_TEST_EXPECT_MSG_EQ(tabela.Get(9, "temperature", valor), false, "unknown device");
+    NS_TEST_EXPECT_MSG_EQ(tabela.Matches(7, "turnedOn", 1), true, "device 7 is on");
+    NS_TEST_EXPECT_MSG_EQ(tabela.Matches(8, "turnedOn", 1), false, "device 8 is not known on");
+
+    nlohmann::json contexto = tabela.Project(7, {"temperature", "humidity"});
+    NS_TEST_EXPECT_MSG_EQ(contexto.size(), 1, "unknown keys are left out");
+    NS_TEST_EXPECT_MSG_EQ(contexto["temperature"]["value"].get<double>(), 21.5, "projected value");
+
+    CotasStateTable::Batch lote = tabela.TakeDirty();
+    NS_TEST_ASSERT_MSG_EQ(lote.size(), 2, "one update per device with dirty values");
+    NS_TEST_EXPECT_MSG_EQ(lote[0].first, 7, "rows in subscription order");
+    NS_TEST_EXPECT_MSG_EQ(lote[0].second.contains("turnedOn"), false, "loaded values stay out");
+    NS_TEST_EXPECT_MSG_EQ(lote[0].second["objectId"].get<int32_t>(), 7, "update names the device");
+    NS_TEST_EXPECT_MSG_EQ(lote[1].second["temperature"].is_number_integer(),
+                          true,
+                          "integral values go as integers");
+    NS_TEST_EXPECT_MSG_EQ(tabela.TakeDirty().size(), 0, "dirty values are handed once");
+
+    // duas escritas antes do flush viram uma atualização só
+    tabela.Set(8, "temperature", 31, 14);
+    tabela.Set(8, "temperature", 32, 15);
+    lote = tabela.TakeDirty();
+    NS_TEST_ASSERT_MSG_EQ(lote.size(), 1, "only device 8 changed");
+    NS_TEST_EXPECT_MSG_EQ(lote[0].second["temperature"].get<int>(), 32, "the latest value goes");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasStateTable TestSuite
+ */
+class CotasStateTableTestSuite : public TestSuite
+{
+  public:
+    CotasStateTableTestSuite();
+};
+
+CotasStateTableTestSuite::CotasStateTableTestSuite()
+    : TestSuite("cotas-state-table", Type::UNIT)
+{
+    AddTestCase(new CotasStateTableTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasStateTableTestSuite
+    cotasStateTableTestSuite; //!< Static variable for test initialization
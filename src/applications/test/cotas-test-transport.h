@@ -0,0 +1,71 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef COTAS_TEST_TRANSPORT_H
+#define COTAS_TEST_TRANSPORT_H
+
+#include "ns3/cotas-transport.h"
+#include "ns3/encapsulated-coap.h"
+
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @ingroup applications-test
+ * @brief Transport that keeps the replies of CoTaS for a test to read.
+ *
+ * The test hands datagrams to CoTaS::HandleDatagram itself; nothing goes
+ * through a socket.
+ */
+class CotasTestTransport : public CotasTransport
+{
+  public:
+    std::vector<std::string> replies; //!< datagrams replied, in order
+
+    void Reply(const Request& /* request */, const std::string& datagram, Time /* delay */) override
+    {
+        replies.push_back(datagram);
+    }
+
+    void Send(const Address& /* to */, const std::string& /* datagram */) override
+    {
+    }
+
+    bool WallClock() const override
+    {
+        return false;
+    }
+
+    /**
+     * @brief Decodes a reply.
+     * @param code receives the response code
+     * @param payload receives the JSON payload, null if it has none
+     * @return false if the datagram is not a CoAP message
+     */
+    static bool Decode(const std::string& datagram, coap_pdu_code_t& code, nlohmann::json& payload)
+    {
+        coap_pdu_t* pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, 0, BUFSIZE);
+        bool ok = coap_pdu_parse(COAP_PROTO_UDP,
+                                 reinterpret_cast<const uint8_t*>(datagram.data()),
+                                 datagram.size(),
+                                 pdu);
+        if (ok)
+        {
+            code = coap_pdu_get_code(pdu);
+            payload = nullptr;
+            GetPduPayloadJson(pdu, payload);
+        }
+        coap_delete_pdu(pdu);
+        return ok;
+    }
+};
+
+} // namespace ns3
+
+#endif /* COTAS_TEST_TRANSPORT_H */
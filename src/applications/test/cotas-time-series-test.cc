@@ -0,0 +1,145 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-time-series.h"
+#include "ns3/test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Checks that the samples of CotasTimeSeries come back bit for bit after
+ * compression, across several blocks, and its rollups and trimming.
+ */
+class CotasTimeSeriesTestCase : public TestCase
+{
+  public:
+    CotasTimeSeriesTestCase();
+    ~CotasTimeSeriesTestCase() override;
+
+  private:
+    void DoRun() override;
+};
+
+CotasTimeSeriesTestCase::CotasTimeSeriesTestCase()
+    : TestCase("History compression round-trip, rollup and trim")
+{
+}
+
+CotasTimeSeriesTestCase::~CotasTimeSeriesTestCase()
+{
+}
+
+void
+CotasTimeSeriesTestCase::DoRun()
+{
+    // intervalos e valores que passam por todos os casos da codificação:
+    // delta repetido, delta-of-delta pequeno e grande, valor repetido,
+    // mudança nos bits baixos e salto de sinal e expoente
+    CotasTimeSeries serie;
+    std::vector<CotasTimeSeries::Sample> esperado;
+    int64_t tempo = 1000;
+    for (uint32_t i = 0; i < 3 * CotasTimeSeries::MAX_BLOCK_SAMPLES + 7; i++)
+    {
+        tempo += i % 50 == 0 ? 3600000 : (i % 7 == 0 ? 1500 : 1000);
+        double valor = 20.0;
+        if (i % 3 == 1)
+        {
+            valor = 20.0 + i * 0.001;
+        }
+        else if (i % 11 == 0)
+        {
+            valor = -std::ldexp(1.0, static_cast<int>(i % 60)) / 3;
+        }
+        NS_TEST_ASSERT_MSG_EQ(serie.Append(tempo, valor), true, "samples in time order");
+        esperado.emplace_back(tempo, valor);
+    }
+    NS_TEST_EXPECT_MSG_EQ(serie.Append(tempo - 1, 0), false, "older sample refused");
+    NS_TEST_ASSERT_MSG_EQ(serie.Size(), esperado.size(), "every sample kept");
+    NS_TEST_EXPECT_MSG_LT(serie.Bytes(),
+                          esperado.size() * sizeof(CotasTimeSeries::Sample),
+                          "smaller than the raw samples");
+
+    std::vector<CotasTimeSeries::Sample> lido = serie.Range(0, tempo);
+    NS_TEST_ASSERT_MSG_EQ(lido.size(), esperado.size(), "whole range read back");
+    for (size_t i = 0; i < lido.size(); i++)
+    {
+        NS_TEST_ASSERT_MSG_EQ(lido[i].first, esperado[i].first, "time of sample " << i);
+        NS_TEST_ASSERT_MSG_EQ(std::memcmp(&lido[i].second, &esperado[i].second, sizeof(double)),
+                              0,
+                              "value of sample " << i << " bit for bit");
+    }
+
+    // fatia no meio de um bloco, com as pontas incluídas
+    size_t a = CotasTimeSeries::MAX_BLOCK_SAMPLES - 3;
+    size_t b = CotasTimeSeries::MAX_BLOCK_SAMPLES + 4;
+    lido = serie.Range(esperado[a].first, esperado[b].first);
+    NS_TEST_ASSERT_MSG_EQ(lido.size(), b - a + 1, "range across two blocks");
+    NS_TEST_EXPECT_MSG_EQ(lido.front().first, esperado[a].first, "first end included");
+    NS_TEST_EXPECT_MSG_EQ(lido.back().first, esperado[b].first, "last end included");
+
+    // agregados de uma janela conferidos contra as amostras
+    int64_t passo = 10000;
+    int64_t inicio = esperado[100].first;
+    int64_t fim = esperado[400].first;
+    std::vector<CotasTimeSeries::Bucket> janelas = serie.Rollup(inicio, fim, passo);
+    uint64_t contagem = 0;
+    double soma = 0;
+    double minimo = INFINITY;
+    for (auto& janela : janelas)
+    {
+        contagem += janela.count;
+        soma += janela.sum;
+        minimo = std::min(minimo, janela.min);
+    }
+    double somaEsperada = 0;
+    double minimoEsperado = INFINITY;
+    for (size_t i = 100; i <= 400; i++)
+    {
+        somaEsperada += esperado[i].second;
+        minimoEsperado = std::min(minimoEsperado, esperado[i].second);
+    }
+    NS_TEST_EXPECT_MSG_EQ(contagem, 301, "every sample in a bucket");
+    NS_TEST_EXPECT_MSG_EQ_TOL(soma, somaEsperada, std::abs(somaEsperada) * 1e-12, "sum");
+    NS_TEST_EXPECT_MSG_EQ(minimo, minimoEsperado, "min");
+
+    // só blocos inteiramente antigos saem
+    serie.Trim(esperado[CotasTimeSeries::MAX_BLOCK_SAMPLES + 1].first);
+    lido = serie.Range(0, tempo);
+    NS_TEST_EXPECT_MSG_EQ(lido.size(),
+                          esperado.size() - CotasTimeSeries::MAX_BLOCK_SAMPLES,
+                          "first block dropped");
+    NS_TEST_EXPECT_MSG_EQ(lido.front().first,
+                          esperado[CotasTimeSeries::MAX_BLOCK_SAMPLES].first,
+                          "second block kept whole");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasTimeSeries TestSuite
+ */
+class CotasTimeSeriesTestSuite : public TestSuite
+{
+  public:
+    CotasTimeSeriesTestSuite();
+};
+
+CotasTimeSeriesTestSuite::CotasTimeSeriesTestSuite()
+    : TestSuite("cotas-time-series", Type::UNIT)
+{
+    AddTestCase(new CotasTimeSeriesTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasTimeSeriesTestSuite
+    cotasTimeSeriesTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2007 Universidade Federal de Viçosa
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ns3/cotas-udp-daemon.h"
+#include "ns3/cotas.h"
+#include "ns3/global-value.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace ns3;
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * Runs CotasUdpDaemon on a loopback port and talks to it from a plain UDP
+ * socket: a CoAP ping is answered with RST and an empty bulk subscription
+ * with 4.00, both matched to their request. Neither reaches the store, so
+ * no Fuseki is needed.
+ */
+class CotasUdpDaemonTestCase : public TestCase
+{
+  public:
+    CotasUdpDaemonTestCase();
+    ~CotasUdpDaemonTestCase() override;
+
+  private:
+    void DoRun() override;
+
+    /**
+     * @brief Sends a request until a reply comes, as a CON client would.
+     * @return false if the daemon never answered
+     */
+    static bool Exchange(int socket,
+                         const sockaddr_in& daemon,
+                         const encoded_data& request,
+                         std::string& reply);
+};
+
+CotasUdpDaemonTestCase::CotasUdpDaemonTestCase()
+    : TestCase("UDP daemon answers a ping and a request over loopback")
+{
+}
+
+CotasUdpDaemonTestCase::~CotasUdpDaemonTestCase()
+{
+}
+
+bool
+CotasUdpDaemonTestCase::Exchange(int socket,
+                                 const sockaddr_in& daemon,
+                                 const encoded_data& request,
+                                 std::string& reply)
+{
+    // o daemon pode ainda não ter aberto a porta: o pedido vai de novo
+    char buffer[BUFSIZE];
+    for (int tentativa = 0; tentativa < 10; tentativa++)
+    {
+        sendto(socket,
+               request.buffer,
+               request.size,
+               0,
+               reinterpret_cast<const sockaddr*>(&daemon),
+               sizeof(daemon));
+        ssize_t recebidos = recv(socket, buffer, sizeof(buffer), 0);
+        if (recebidos > 0)
+        {
+            reply.assign(buffer, recebidos);
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+CotasUdpDaemonTestCase::DoRun()
+{
+    const uint16_t porta = 56831;
+
+    // como no cotas-daemon: os eventos seguem o relógio de parede e os
+    // workers agendam de outras threads
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::RealtimeSimulatorImpl"));
+
+    Ptr<CoTaS> cotas = CreateObject<CoTaS>();
+    CotasUdpDaemon daemon(cotas, porta, 1);
+
+    // o cliente roda noutra thread e só guarda o que recebeu; as
+    // verificações ficam na thread do teste
+    std::string pong;
+    std::string resposta;
+    bool respondeuPing = false;
+    bool respondeuPedido = false;
+    encoded_data ping = EncodePduEmpty(COAP_MESSAGE_CON, 0x1234);
+    encoded_data pedido =
+        EncodePduRequest("/subscribe/bulk", COAP_REQUEST_CODE_POST, "[]", {}, "tk");
+    std::thread cliente([&]() {
+        int s = socket(AF_INET, SOCK_DGRAM, 0);
+        timeval espera{0, 500000};
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &espera, sizeof(espera));
+        sockaddr_in destino{};
+        destino.sin_family = AF_INET;
+        destino.sin_port = htons(porta);
+        destino.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        respondeuPing = Exchange(s, destino, ping, pong);
+        respondeuPedido = Exchange(s, destino, pedido, resposta);
+        close(s);
+        daemon.Stop();
+    });
+
+    bool ok = daemon.Run();
+    cliente.join();
+    cotas = nullptr;
+    Simulator::Destroy();
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DefaultSimulatorImpl"));
+
+    NS_TEST_ASSERT_MSG_EQ(ok, true, "daemon opened its port");
+    NS_TEST_ASSERT_MSG_EQ(respondeuPing, true, "ping answered");
+    NS_TEST_ASSERT_MSG_EQ(respondeuPedido, true, "request answered");
+
+    coap_pdu_t* pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, 0, BUFSIZE);
+    NS_TEST_ASSERT_MSG_EQ(
+        coap_pdu_parse(COAP_PROTO_UDP,
+                       reinterpret_cast<const uint8_t*>(pong.data()),
+                       pong.size(),
+                       pdu) != 0,
+        true,
+        "pong is a CoAP message");
+    NS_TEST_EXPECT_MSG_EQ(coap_pdu_get_type(pdu), COAP_MESSAGE_RST, "ping gets a RST");
+    NS_TEST_EXPECT_MSG_EQ(coap_pdu_get_mid(pdu), 0x1234, "with the message id of the ping");
+    coap_delete_pdu(pdu);
+
+    pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, 0, BUFSIZE);
+    NS_TEST_ASSERT_MSG_EQ(
+        coap_pdu_parse(COAP_PROTO_UDP,
+                       reinterpret_cast<const uint8_t*>(resposta.data()),
+                       resposta.size(),
+                       pdu) != 0,
+        true,
+        "reply is a CoAP message");
+    NS_TEST_EXPECT_MSG_EQ(coap_pdu_get_code(pdu),
+                          COAP_RESPONSE_CODE_BAD_REQUEST,
+                          "empty bulk refused");
+    NS_TEST_EXPECT_MSG_EQ(GetPduToken(pdu), "tk", "reply carries the request token");
+    coap_delete_pdu(pdu);
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief CotasUdpDaemon TestSuite
+ */
+class CotasUdpDaemonTestSuite : public TestSuite
+{
+  public:
+    CotasUdpDaemonTestSuite();
+};
+
+CotasUdpDaemonTestSuite::CotasUdpDaemonTestSuite()
+    : TestSuite("cotas-udp-daemon", Type::SYSTEM)
+{
+    AddTestCase(new CotasUdpDaemonTestCase, TestCase::Duration::QUICK);
+}
+
+static CotasUdpDaemonTestSuite
+    cotasUdpDaemonTestSuite; //!< Static variable for test initialization